@@ -41,6 +41,7 @@ int main(void) {
     FValue i_init, i_curr, i_next, s_init, s_curr, s_next, array, size, elem,
            cond;
     FBuilder b;
+    FCompileOptions opts;
     char err[FVerifyBufferSize] = {0};
     i32 (*sum)(void *, i32);
     int c_array[] = {1, 2, 3, 4, 5, 6};
@@ -86,8 +87,10 @@ int main(void) {
       fprintf(stderr, "%s\n", err);
       exit(1);
     }
+    /* Hot loop: use the aggressive pipeline (LICM, unrolling, vectorization) */
+    f_init_compile_options(&opts, 3);
     f_init_engine(E);
-    f_compile(E, M);
+    f_compile_ex(E, M, &opts);
     sum = f_get_fpointer(E, fn_sum, i32, (void *, i32));
     f_close_module(M);
 
@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Compile a function in background while running a slow path
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fahrenheit/fahrenheit.h>
+
+/* Interpreted version of the function */
+static i32 slow_square(i32 x) {
+    i32 i, r = 0;
+    for (i = 0; i < x; ++i)
+        r += x;
+    return r;
+}
+
+/* Called by the compiler thread */
+static void compiled(FEngine *e, int status, void *userdata) {
+    (void)e;
+    printf("%s compiled with status %d\n", (const char *)userdata, status);
+}
+
+int main(void) {
+    FModule module;
+    FModule *M = &module;
+    int fn_square, bb;
+    FValue v_x;
+    FBuilder b;
+    FEngine engine;
+    FEngine *E = &engine;
+    FCompileQueue queue;
+    FCompileJob *job;
+    char err[FVerifyBufferSize] = {0};
+    i32 (*square)(i32) = slow_square;
+    i32 n, sum = 0;
+
+    f_init_module(M);
+    fn_square = f_add_function(M, f_ftype(M, FInt32, 1, FInt32));
+    bb = f_add_bblock(M, fn_square);
+    b = f_builder(M, fn_square, bb);
+    v_x = f_getarg(b, 0);
+    f_ret(b, f_binop(b, FMul, v_x, v_x));
+
+    if(f_verify_module(M, err)) {
+      fprintf(stderr, "%s\n", err);
+      exit(1);
+    }
+
+    /* Start the compilation in background */
+    f_init_queue(&queue, 1);
+    f_init_engine(E);
+    job = f_compile_async(&queue, E, M, NULL, compiled, "square");
+
+    /* Keep running the slow path until the compiled function is ready */
+    for (n = 0; n < 1000000; ++n) {
+        if (square == slow_square && f_job_done(job)) {
+            if (f_job_wait(job) != 0) exit(1);
+            square = f_get_fpointer(E, fn_square, i32, (i32));
+        }
+        sum += square(n % 100);
+    }
+    printf("%d\n", sum);
+
+    /* Clean up */
+    f_job_wait(job);
+    f_job_release(job);
+    f_close_queue(&queue);
+    f_close_module(M);
+    f_close_engine(E);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Compare the compile time of the backends
+ * Build a module with many loop functions, compile it with LLVM (levels 0 and
+ * 2) and with the baseline x86-64 backend, then call every function.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <fahrenheit/fahrenheit.h>
+
+#define NFUNCTIONS 200
+#define NITERATIONS 100000
+
+/* Create the function: i32 f(i32 n) { s = k; for i < n: s = s * 3 + i ^ k } */
+static void add_function(FModule *M, int k) {
+    int fn, bb_init, bb_header, bb_loop, bb_exit;
+    FValue n, i_init, i_curr, i_next, s_init, s_curr, s_next, cond, tmp;
+    FBuilder b;
+
+    fn = f_add_function(M, f_ftype(M, FInt32, 1, FInt32));
+    bb_init = f_add_bblock(M, fn);
+    bb_header = f_add_bblock(M, fn);
+    bb_loop = f_add_bblock(M, fn);
+    bb_exit = f_add_bblock(M, fn);
+
+    b = f_builder(M, fn, bb_init);
+    n = f_getarg(b, 0);
+    i_init = f_consti(b, 0, FInt32);
+    s_init = f_consti(b, k, FInt32);
+    f_jmp(b, bb_header);
+
+    b = f_builder(M, fn, bb_header);
+    i_curr = f_phi(b, FInt32);
+    s_curr = f_phi(b, FInt32);
+    cond = f_intcmp(b, FIntSLt, i_curr, n);
+    f_jmpif(b, cond, bb_loop, bb_exit);
+
+    b = f_builder(M, fn, bb_loop);
+    tmp = f_binop(b, FMul, s_curr, f_consti(b, 3, FInt32));
+    tmp = f_binop(b, FAdd, tmp, i_curr);
+    s_next = f_binop(b, FXor, tmp, f_consti(b, k, FInt32));
+    i_next = f_binop(b, FAdd, i_curr, f_consti(b, 1, FInt32));
+    f_jmp(b, bb_header);
+
+    b = f_builder(M, fn, bb_exit);
+    f_ret(b, s_curr);
+
+    f_add_incoming(b, i_curr, bb_init, i_init);
+    f_add_incoming(b, i_curr, bb_loop, i_next);
+    f_add_incoming(b, s_curr, bb_init, s_init);
+    f_add_incoming(b, s_curr, bb_loop, s_next);
+}
+
+/* Compile the module with the backend and report the elapsed times */
+static void run(FModule *M, const char *name, enum FBackend backend,
+        int opt_level) {
+    FEngine engine;
+    FCompileOptions opts;
+    clock_t start, compiled, finished;
+    i32 result = 0;
+    int i;
+
+    f_init_engine(&engine);
+    engine.backend = backend;
+    f_init_compile_options(&opts, opt_level);
+    start = clock();
+    if (f_compile_ex(&engine, M, &opts)) {
+        fprintf(stderr, "%s: compilation failed\n", name);
+        exit(1);
+    }
+    compiled = clock();
+    for (i = 0; i < NFUNCTIONS; ++i)
+        result += f_get_fpointer(&engine, i, i32, (i32))(NITERATIONS);
+    finished = clock();
+    printf("%-8s compile %8.2f ms   run %8.2f ms   (result %d)\n", name,
+           (compiled - start) * 1000.0 / CLOCKS_PER_SEC,
+           (finished - compiled) * 1000.0 / CLOCKS_PER_SEC, result);
+    f_close_engine(&engine);
+}
+
+int main(void) {
+    FModule module;
+    FModule *M = &module;
+    char err[FVerifyBufferSize] = {0};
+    int i;
+
+    f_init_module(M);
+    for (i = 0; i < NFUNCTIONS; ++i)
+        add_function(M, i);
+    if (f_verify_module(M, err)) {
+        fprintf(stderr, "%s\n", err);
+        exit(1);
+    }
+
+    printf("%d functions, %d iterations each\n", NFUNCTIONS, NITERATIONS);
+    run(M, "llvm-O0", FBackendLLVM, 0);
+    run(M, "llvm-O2", FBackendLLVM, 2);
+    run(M, "x64", FBackendX64, 0);
+
+    f_close_module(M);
+    return 0;
+}
@@ -31,33 +31,146 @@
  * @brief Compile the IR into machine code
  *
  * @{
- * Use the LLVM toolchain under the hood.
+ * Use the LLVM toolchain under the hood by default. The baseline x86-64
+ * backend generates code directly from the IR, which is much faster to compile
+ * but produces slower code (see FBackend).
  * Notice that the IR module can be disposed after it is compiled.
+ * Different engines can be compiled concurrently by different threads, as
+ * long as each thread uses its own engine and module.
  */
 
+#include <stddef.h>
+
 struct FModule;
 
 /** Compiled function prototype */
 typedef void (*FJitFunc)(void);
 
-/** Store the compiled functions */
+/** Code generators */
+enum FBackend {
+  FBackendLLVM,   /* optimizing LLVM backend (default) */
+  FBackendX64,    /* single-pass x86-64 code generator (SysV ABI only) */
+  FBackendTiered  /* baseline code promoted to LLVM when hot (see tier.h) */
+};
+
+/** Store the compiled functions
+ * The backend can be changed after f_init_engine or f_close_engine, while
+ * the engine is empty. The baseline backend ignores the compile options and
+ * fails to compile modules that use vector types. */
 typedef struct FEngine {
   FJitFunc *funcs;
   int nfuncs;
+  enum FBackend backend;
   void *data;
 } FEngine;
 
-/** Initialize the engine */
+/** IR optimization passes that can be toggled individually */
+enum FPass {
+  FPassMem2Reg        = 1 << 0,
+  FPassInstCombine    = 1 << 1,
+  FPassGVN            = 1 << 2,
+  FPassLICM           = 1 << 3,
+  FPassLoopUnroll     = 1 << 4,
+  FPassLoopVectorize  = 1 << 5,
+  FPassSLPVectorize   = 1 << 6,
+  FPassInline         = 1 << 7    /* also inlines the bitcode (see bitcode.h) */
+};
+
+/** Compilation options
+ * Use f_init_compile_options to obtain the default options of a level and
+ * then change the fields as needed. */
+typedef struct FCompileOptions {
+  int opt_level;          /* code generation level (0 to 3) */
+  int passes;             /* IR passes executed before code generation */
+  int nthreads;           /* number of threads used to generate code */
+  const char *cache_dir;  /* directory of the object cache (NULL disables) */
+  int lazy;               /* compile each function on its first call */
+  const char *cpu;        /* target CPU name (NULL selects the host CPU) */
+  const char *features;   /* target features (NULL selects the host ones) */
+} FCompileOptions;
+
+/** Initialize the options with the default passes of the optimization level
+ * The level must be between 0 (no optimizations) and 3 (aggressive).
+ * f_compile uses level 2. Levels 2 and 3 generate machine code aggressively
+ * and differ in the IR passes: level 3 also unrolls and vectorizes loops.
+ * Code is generated by a single thread by default. When nthreads is bigger
+ * than 1, the module functions are split into independent partitions that are
+ * compiled in parallel and linked into the same engine.
+ * The object cache is disabled by default. When cache_dir is set, the object
+ * code is stored in that directory, keyed by the IR hash (see hash.h), and
+ * reused by later compilations, even by other processes. External functions
+ * are linked by name when the object is loaded, so their addresses can change
+ * between processes; constant pointers, however, are part of the key.
+ * Cached files that are corrupted or that were stored by another key are
+ * ignored and overwritten.
+ * When lazy is set, the functions are only lowered by the compilation and the
+ * engine receives stubs; the machine code of a function is generated when its
+ * stub is called for the first time. A function is only compiled once: threads
+ * that call it while it is being compiled wait for its code.
+ * If the host isn't supported by ORC, lazy is ignored.
+ * By default, the code is tuned for the host CPU and uses all the features it
+ * has (eg. AVX2, BMI and POPCNT). The cpu field takes an LLVM CPU name (eg.
+ * "haswell") and the features field takes a comma-separated list of LLVM
+ * attributes (eg. "+avx2,-avx512f"); an empty string selects the generic CPU
+ * or no extra features, which produces code that runs on any machine of the
+ * same architecture. Both are part of the cache keys. */
+void f_init_compile_options(FCompileOptions *opts, int opt_level);
+
+/** Statistics of the compiled function cache */
+typedef struct FCacheStats {
+  unsigned long hits;       /* functions obtained from the cache */
+  unsigned long misses;     /* functions that had to be compiled */
+  unsigned long evictions;  /* entries removed to respect the budget */
+  size_t entries;           /* number of functions in the cache */
+  size_t size;              /* code and data bytes held by the cache */
+  size_t budget;            /* maximum number of bytes */
+} FCacheStats;
+
+/** Set the byte budget of the process-wide compiled function cache
+ * The cache is disabled while the budget is 0, which is the default.
+ * When enabled, each module function is hashed together with the functions
+ * it calls and the compile options; functions that were already compiled by
+ * any engine are reused instead of compiled again. Functions in mutual
+ * recursion are never cached. A cached function keeps alive the code of the
+ * whole compilation it came from, so each compilation with cached functions
+ * counts its code and data sections once against the budget. Least recently
+ * used functions are evicted until the size fits the budget; the memory of a
+ * compilation is only released when all its functions are evicted (and no
+ * engine uses them). */
+void f_set_function_cache_budget(size_t budget);
+
+/** Remove all functions from the cache (the statistics are kept) */
+void f_clear_function_cache(void);
+
+/** Obtain the cache statistics */
+void f_get_function_cache_stats(FCacheStats *stats);
+
+/** Initialize the engine (it uses the LLVM backend) */
 void f_init_engine(FEngine *e);
 
-/** Close the engine */
+/** Close the engine (the selected backend is kept) */
 void f_close_engine(FEngine *e);
 
 /** Compile the module and store the compiled functions into the engine
- * The engine will not keep any references to the module.
+ * The engine will not keep any references to the module. The functions
+ * previously compiled into the engine are released.
  * Return a value different from 0 if there is an unexpected error. */
 int f_compile(FEngine *e, struct FModule *m);
 
+/** Compile the module using the given options
+ * Passing NULL options is the same as calling f_compile, which uses the
+ * default options of level 2. */
+int f_compile_ex(FEngine *e, struct FModule *m, const FCompileOptions *opts);
+
+/** Compile the functions added to the module since the last compilation
+ * The module must be the one previously compiled into the engine, and the
+ * functions that were already compiled must not be changed. The new functions
+ * are appended to the engine (e->funcs may be reallocated) and call the old
+ * ones directly; the options of the first compilation are used. If the
+ * engine is empty, this is the same as f_compile.
+ * Return a value different from 0 if there is an unexpected error. */
+int f_compile_incremental(FEngine *e, struct FModule *m);
+
 /** Obtain the function pointer given the type
  * The parameter args should be inside a parenteses (eg. (void), (int, int)). */
 #define f_get_fpointer(e, function, ret, args) \
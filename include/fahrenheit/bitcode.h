@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_bitcode_h
+#define fahrenheit_bitcode_h
+
+/** @file bitcode.h
+ *
+ * @defgroup Bitcode
+ * @brief Inline host functions into the compiled code
+ *
+ * @{
+ * Calls to external functions are opaque to the optimizer. When the LLVM
+ * bitcode of a host function is available (eg. built by clang with
+ * -O2 -c -emit-llvm along with the host program), the LLVM backend can link
+ * its body into the modules that call it, so small runtime helpers are
+ * inlined and specialized. The bitcode is registered once per process and is
+ * shared by all engines; the other backends ignore it.
+ * The bitcode functions are copied into the compiled code, so they must not
+ * keep state in static variables. Global variables with external linkage
+ * refer to the host ones, which must be exported by the executable (eg.
+ * -rdynamic). Functions compiled with -O0 are marked as optnone by clang and
+ * are never inlined.
+ */
+
+#include <stddef.h>
+
+#include <fahrenheit/ir.h>
+
+/** Register the bitcode of host functions
+ * The bitcode is copied. The bitcode a function is bound to is part of the
+ * cache keys of the modules that call it.
+ * Return a value different from 0 if the bitcode is invalid or if it defines
+ * a function that is already defined by registered bitcode; in that case
+ * nothing is registered. */
+int f_add_bitcode(const void *data, size_t size);
+
+/** Register the bitcode stored in a file (see f_add_bitcode)
+ * Return a value different from 0 if the file can't be read or the bitcode
+ * is invalid. */
+int f_add_bitcode_file(const char *path);
+
+/** Bind a host function to its definition in the registered bitcode
+ * External functions that point to ptr are replaced by the definition of the
+ * bitcode function with the given name, which must have the same semantics.
+ * Calls whose type differs from an earlier declaration of that name in the
+ * same module are compiled as plain external calls.
+ * The bitcode must be registered before the binding, and the binding only
+ * affects the compilations that start after it.
+ * Return a value different from 0 if no registered bitcode defines the
+ * function. */
+int f_bind_bitcode(FFunctionPtr ptr, const char *name);
+
+/**@}*/
+
+#endif
+
@@ -34,9 +34,14 @@
  */
 
 #include <fahrenheit/backend.h>
+#include <fahrenheit/bitcode.h>
+#include <fahrenheit/hash.h>
 #include <fahrenheit/instructions.h>
+#include <fahrenheit/interp.h>
 #include <fahrenheit/ir.h>
 #include <fahrenheit/printer.h>
+#include <fahrenheit/queue.h>
+#include <fahrenheit/tier.h>
 #include <fahrenheit/util.h>
 #include <fahrenheit/verify.h>
 #include <fahrenheit/version.h>
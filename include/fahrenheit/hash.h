@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_hash_h
+#define fahrenheit_hash_h
+
+/** @file hash.h
+ *
+ * @defgroup Hash
+ * @brief Hash the IR contents
+ *
+ * @{
+ * The hashes only depend on the IR contents, so they are stable across
+ * processes. External functions are hashed by type, not by address. Constant
+ * pointers are hashed by value.
+ */
+
+#include <fahrenheit/ir.h>
+
+/** Hash the type, the attributes and the body of a function
+ * Called functions are hashed by index. */
+ui64 f_hash_function(FModule *m, int function);
+
+/** Hash the type, the attributes and the body of a function
+ * Called functions are hashed by type, so the hash doesn't depend on the
+ * function indices. The caller should combine the hashes of the called
+ * functions to identify them. */
+ui64 f_hash_function_body(FModule *m, int function);
+
+/** Hash the function like f_hash_function_body, starting from the seed
+ * Hashes with different seeds can be compared together to tell apart
+ * functions whose hashes collide. */
+ui64 f_hash_function_body_seed(FModule *m, int function, ui64 seed);
+
+/** Hash the whole module */
+ui64 f_hash_module(FModule *m);
+
+/** Hash the whole module like f_hash_module, starting from the seed
+ * (see f_hash_function_body_seed) */
+ui64 f_hash_module_seed(FModule *m, ui64 seed);
+
+/** Combine a value into a hash */
+ui64 f_hash_combine(ui64 h, ui64 value);
+
+/** Initial value used to combine hashes */
+ui64 f_hash_init(void);
+
+/**@}*/
+
+#endif
+
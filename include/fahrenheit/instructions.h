@@ -37,11 +37,14 @@
 
 #include <fahrenheit/ir.h>
 
-/** Create a constant boolean */
+/** Create a constant boolean
+ * Constants are interned by the function: creating a constant with the same
+ * type and value again returns the same FValue. */
 FValue f_constb(FBuilder b, int val);
 
 /** Create a integer constant of given type
- * The type must be an integer. */
+ * The type must be an integer. The value is truncated to the type width (a
+ * bool is true if the value isn't 0). */
 FValue f_consti(FBuilder b, ui64 val, enum FType type);
 
 /** Create a float point constant of given type
@@ -58,7 +61,8 @@ FValue f_constp(FBuilder b, void *val);
 FValue f_getarg(FBuilder b, int n);
 
 /** Load a value of given type at the given address
- * The address must be a pointer. */
+ * The address must be a pointer. Vectors only need the alignment of their
+ * lanes. */
 FValue f_load(FBuilder b, FValue addr, enum FType type);
 
 /** Store the value at the address
@@ -75,16 +79,40 @@ FValue f_offset(FBuilder b, FValue addr, FValue offset, int negative);
 FValue f_cast(FBuilder b, enum FCastTag op, FValue val, enum FType type);
 
 /** Perform a binary operation over two operands
- * The operands must have exactaly the same type. */
+ * The operands must have exactaly the same type. Vector operands are
+ * computed lane by lane. Min and Max of float points return the operand that
+ * isn't NaN, if any. The rotation amount is taken modulo the width. */
 FValue f_binop(FBuilder b, enum FBinopTag op, FValue lhs, FValue rhs);
 
+/** Perform an arithmetic operation that reports overflow
+ * The operands must be integers with exactly the same type. The result is
+ * the wrapped value; use f_overflowed to obtain the overflow flag. */
+FValue f_checked(FBuilder b, enum FCheckedTag op, FValue lhs, FValue rhs);
+
+/** Obtain a boolean that tells if the checked operation overflowed
+ * The value must be the result of f_checked. Branching on the flag right
+ * after the operation compiles to a single jo (or jc) instruction. */
+FValue f_overflowed(FBuilder b, FValue checked);
+
+/** Perform a unary operation
+ * The result has the type of the operand. Sqrt, Floor and Ceil require float
+ * points; Popcount, Ctlz, Cttz and Bswap require integers (Bswap of 16 bits
+ * or more). Vector operands are computed lane by lane. */
+FValue f_unop(FBuilder b, enum FUnopTag op, FValue val);
+
+/** Perform a ternary operation
+ * The operands must be float points with exactly the same type. */
+FValue f_ternop(FBuilder b, enum FTernopTag op, FValue x, FValue y, FValue z);
+
 /** Compare two integer values and return a boolean
  * The operands must have exactaly the same type.
- * The Eq and Nq operations also can be used to compare pointers. */
+ * The Eq and Nq operations also can be used to compare pointers.
+ * Comparing vectors results in a vector of booleans. */
 FValue f_intcmp(FBuilder b, enum FIntCmpTag op, FValue lhs, FValue rhs);
 
 /** Compare two float pointe values and return a boolean
- * The operands must have exactaly the same type. */
+ * The operands must have exactaly the same type.
+ * Comparing vectors results in a vector of booleans. */
 FValue f_fpcmp(FBuilder b, enum FFpCmpTag op, FValue lhs, FValue rhs);
 
 /** Jump to the true branch if the condition holds, else jump to the false one
@@ -96,7 +124,8 @@ FValue f_jmp(FBuilder b, int dest);
 
 /** Return the true value if the condition holds, else return the false one
  * The values must have exactaly the same type and the condition must have be a
- * bolean. */
+ * bolean. If the values are vectors, the condition can also be a vector of
+ * booleans with the same number of lanes, which selects each lane. */
 FValue f_select(FBuilder b, FValue cond, FValue truev, FValue falsev);
 
 /** Return the given value
@@ -124,6 +153,100 @@ FValue f_phi(FBuilder b, enum FType type);
  * the same type of the phi. */
 void f_add_incoming(FBuilder b, FValue phi, int bb, FValue value);
 
+/** Create a vector with the value in all lanes
+ * The value must be a bool, an integer or a float point. */
+FValue f_splat(FBuilder b, FValue val, int lanes);
+
+/** Obtain a lane of the vector */
+FValue f_extract(FBuilder b, FValue vec, int lane);
+
+/** Obtain a copy of the vector with the lane replaced by the value
+ * The value must have the type of the vector lanes. */
+FValue f_insert(FBuilder b, FValue vec, FValue val, int lane);
+
+/** Create a vector with the lanes of two vectors of the same type
+ * The mask has one entry per resulting lane: the indices smaller than the
+ * number of lanes of lhs select a lane of lhs and the others select the lane
+ * (index - lanes) of rhs. The resulting vector has nlanes lanes.
+ * Don't take the ownership of the mask. */
+FValue f_shuffle(FBuilder b, FValue lhs, FValue rhs, int nlanes,
+    const int *mask);
+
+/** Combine the lanes of the vector with the binary operation
+ * Integer vectors accept Add, Mul, And, Or and Xor; float point vectors
+ * accept Add and Mul. The lanes are combined in pairs (like a tree), so
+ * float point results can differ from a sequential loop. */
+FValue f_reduce(FBuilder b, enum FBinopTag op, FValue vec);
+
+/** Copy size bytes from src to dst
+ * The addresses must be pointers and the size an integer. The memory areas
+ * must not overlap. The alignment (in bytes) is a power of two that both
+ * addresses respect, or 0 if it is unknown; it must be below 2^23. Volatile
+ * copies are never removed or merged by the optimizer. */
+FValue f_memcpy(FBuilder b, FValue dst, FValue src, FValue size, int align,
+    int isvolatile);
+
+/** Copy size bytes from src to dst, the memory areas may overlap
+ * The parameters are the same of f_memcpy. */
+FValue f_memmove(FBuilder b, FValue dst, FValue src, FValue size, int align,
+    int isvolatile);
+
+/** Fill size bytes at dst with the value
+ * The value must be an 8 bits integer. The other parameters are the same of
+ * f_memcpy. */
+FValue f_memset(FBuilder b, FValue dst, FValue val, FValue size, int align,
+    int isvolatile);
+
+/** Hint that the memory at the address will be accessed soon
+ * The write flag tells if the access is a write. The locality goes from 0
+ * (no temporal locality, don't keep it in the cache) to 3 (keep it in all
+ * cache levels). Prefetching never faults, even if the address is invalid. */
+FValue f_prefetch(FBuilder b, FValue addr, int write, int locality);
+
+/** Allocate size bytes in the stack frame and return their address
+ * The size must be positive and the instruction must be in the entry block,
+ * which lets the optimizer promote the memory to registers. The alignment is
+ * a power of two, or 0 for the alignment of the stack (16 bytes). The memory
+ * is released when the function returns. */
+FValue f_alloca(FBuilder b, int size, int align);
+
+/** Allocate a number of bytes known only at run time in the stack frame
+ * The size must be an integer; it can be placed in any block, but each
+ * execution allocates more memory, which is only released when the function
+ * returns (avoid it inside loops). The alignment is the same of f_alloca. */
+FValue f_alloca_dynamic(FBuilder b, FValue size, int align);
+
+/** Load a value atomically
+ * The type must be an integer (except bool) or a pointer, and the address
+ * must be aligned to the type size. The ordering must be Relaxed, Acquire or
+ * SeqCst. */
+FValue f_atomic_load(FBuilder b, FValue addr, enum FType type,
+    enum FOrdering order);
+
+/** Store a value atomically
+ * The restrictions are the same of f_atomic_load, except that the ordering
+ * must be Relaxed, Release or SeqCst. */
+FValue f_atomic_store(FBuilder b, FValue addr, FValue val,
+    enum FOrdering order);
+
+/** Atomically combine the value at the address with val
+ * The value must be an integer (except bool) and the address must be aligned
+ * to its size. Return the value that was in memory before the operation. */
+FValue f_atomic_rmw(FBuilder b, enum FAtomicTag op, FValue addr, FValue val,
+    enum FOrdering order);
+
+/** Atomically replace the value at the address by val if it is equal to cmp
+ * The values must have the same integer (except bool) or pointer type.
+ * Return the value that was in memory, so the exchange succeeded if it is
+ * equal to cmp. The ordering of a failed exchange is the strongest one
+ * allowed for a load that doesn't exceed the given ordering. */
+FValue f_cmpxchg(FBuilder b, FValue addr, FValue cmp, FValue val,
+    enum FOrdering order);
+
+/** Order the memory accesses around the fence
+ * The ordering must be Acquire, Release, AcqRel or SeqCst. */
+FValue f_fence(FBuilder b, enum FOrdering order);
+
 /**@}*/
 
 #endif
@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_interp_h
+#define fahrenheit_interp_h
+
+/** @file interp.h
+ *
+ * @defgroup Interpreter
+ * @brief Execute the IR without compiling it
+ *
+ * @{
+ * Each module function is translated into a register based bytecode on its
+ * first call, so the interpreter has no startup latency. It also counts the
+ * calls and the loop iterations of every function, which can be used to
+ * decide which functions deserve to be compiled.
+ * The module must be verified and the functions that were already called
+ * must not be changed. External functions are called natively; on x86-64
+ * (SysV ABI) they can receive up to 6 integer and 8 float point arguments,
+ * elsewhere only integer and pointer arguments are supported. Vector types
+ * aren't supported: translating a function that uses them (or an unsupported
+ * external call) aborts, so use f_interp_check before calling functions that
+ * may use them. Atomic instructions use the atomic builtins of the compiler.
+ */
+
+#include <fahrenheit/ir.h>
+
+/** Runtime value
+ * Integers (and booleans) are zero extended to 64 bits. */
+typedef union FInterpValue {
+  ui64 i;
+  float f;
+  double d;
+  void *p;
+} FInterpValue;
+
+/** Profiling data of a function */
+typedef struct FInterpProfile {
+  unsigned long calls;      /* number of times the function was called */
+  unsigned long backedges;  /* number of loop back edges taken */
+} FInterpProfile;
+
+/** Interpreter state */
+typedef struct FInterp {
+  struct FModule *module;
+  void *data;
+} FInterp;
+
+/** Initialize the interpreter of the module */
+void f_init_interp(FInterp *it, struct FModule *m);
+
+/** Release the translated functions */
+void f_close_interp(FInterp *it);
+
+/** Check if the function and the module functions it can call are supported
+ * Return a value different from 0 if one of them uses vector types or calls
+ * an external function with an unsupported signature. */
+int f_interp_check(FInterp *it, int function);
+
+/** Call the function with the given arguments
+ * The array must have one value for each argument of the function. */
+FInterpValue f_interp_callv(FInterp *it, int function,
+    const FInterpValue *args);
+
+/** Call the function with the given arguments
+ * Integers of up to 32 bits must be passed as int (or unsigned), 64 bits
+ * integers as ui64, float point values as double and pointers as void *. */
+FInterpValue f_interp_call(FInterp *it, int function, ...);
+
+/** Obtain the profiling data of the function */
+void f_interp_profile(FInterp *it, int function, FInterpProfile *profile);
+
+/** Reset the profiling data of all functions */
+void f_interp_reset_profile(FInterp *it);
+
+/**@}*/
+
+#endif
+
@@ -34,22 +34,48 @@
  * The module is the root structure of this representation.
  * A module can have several functions (including external ones).
  * A module function is formed by basic blocks and SSA instructions.
+ * The blocks, the instructions and the arrays they reference are allocated
+ * in the module arena, so they are released all at once.
  */
 
 #include <stdplus/stdplus.h>
 
 /* Declarations ***************************************************************/
 
-/** Basic types */
+/** Memory block of an arena */
+typedef struct FArenaChunk {
+  struct FArenaChunk *next;
+  size_t size;                  /* bytes available after the header */
+} FArenaChunk;
+
+/** Bump-pointer allocator that holds the IR storage
+ * The memory is only released all at once, by f_reset_arena (which keeps the
+ * chunks for reuse) or by f_close_arena. */
+typedef struct FArena {
+  FArenaChunk *chunks;          /* all chunks, in allocation order */
+  FArenaChunk *current;         /* chunk where the memory is allocated */
+  char *ptr;                    /* free space of the current chunk */
+  char *end;
+  size_t chunksize;             /* minimum size of the new chunks */
+} FArena;
+
+/** Basic types
+ * Vector types are built from the bool, integer and float point types with
+ * f_vec; FVecMask is the part of the type that holds the number of lanes. */
 enum FType {
   FBool, FInt8, FInt16, FInt32, FInt64,
-  FFloat, FDouble, FPointer, FVoid
+  FFloat, FDouble, FPointer, FVoid,
+  FVecMask = 0x7f0
 };
 
 /** Instruction types */
 enum FInstrTag {
   FKonst, FGetarg, FLoad, FStore, FOffset, FCast, FBinop,
-  FIntCmp, FFpCmp, FJmpIf, FJmp, FSelect, FRet, FCall, FPhi
+  FIntCmp, FFpCmp, FJmpIf, FJmp, FSelect, FRet, FCall, FPhi,
+  FSplat, FExtract, FInsert, FShuffle, FReduce,
+  FMemcpy, FMemmove, FMemset, FPrefetch,
+  FAtomicRmw, FCmpxchg, FFence, FUnop, FTernop, FChecked, FOverflowed,
+  FAlloca
 };
 
 /** Cast operations */
@@ -62,7 +88,33 @@ enum FCastTag {
 
 /** Binary operations */
 enum FBinopTag {
-  FAdd, FSub, FMul, FDiv, FRem, FShl, FShr, FAnd, FOr, FXor
+  FAdd, FSub, FMul, FDiv, FRem, FShl, FShr, FAnd, FOr, FXor,
+  FMin, FMax,           /* signed or float point */
+  FUMin, FUMax,         /* unsigned */
+  FRotl, FRotr,         /* rotate left and right */
+  FUDiv, FSRem,         /* the other signedness of Div and Rem */
+  FAShr                 /* arithmetic (signed) shift right */
+};
+
+/** Arithmetic operations that report overflow */
+enum FCheckedTag {
+  FCheckedSAdd, FCheckedUAdd,
+  FCheckedSSub, FCheckedUSub,
+  FCheckedSMul, FCheckedUMul
+};
+
+/** Unary operations */
+enum FUnopTag {
+  FSqrt, FFloor, FCeil, /* float point */
+  FAbs,                 /* integer (signed) or float point */
+  FPopcount,            /* number of bits set */
+  FCtlz, FCttz,         /* leading and trailing zeros (the width for 0) */
+  FBswap                /* reverse the bytes */
+};
+
+/** Ternary operations */
+enum FTernopTag {
+  FFma                  /* a * b + c with a single rounding */
 };
 
 /** Integer comparison operations */
@@ -78,10 +130,40 @@ enum FFpCmpTag {
   FFpUEq, FFpUNe, FFpULe, FFpULt, FFpUGe, FFpUGt    /* unordered */
 };
 
-/** A value is a reference to an instruction inside a basic block */
+/** Memory orderings of the atomic instructions (same as C11) */
+enum FOrdering {
+  FNotAtomic, FRelaxed, FAcquire, FRelease, FAcqRel, FSeqCst
+};
+
+/** Atomic read-modify-write operations */
+enum FAtomicTag {
+  FAtomicXchg, FAtomicAdd, FAtomicSub, FAtomicAnd, FAtomicOr, FAtomicXor,
+  FAtomicMin, FAtomicMax,     /* signed */
+  FAtomicUMin, FAtomicUMax    /* unsigned */
+};
+
+/** Function and parameter attributes
+ * The attributes are promises made to the optimizer; the behavior of the
+ * compiled code is undefined if they don't hold. */
+enum FAttr {
+  FAttrNoAlias      = 1 << 0,   /* param: only accessed through this pointer */
+  FAttrNonNull      = 1 << 1,   /* param: never null */
+  FAttrReadOnly     = 1 << 2,   /* doesn't write to memory */
+  FAttrReadNone     = 1 << 3,   /* doesn't access memory */
+  FAttrNoUnwind     = 1 << 4,   /* function: never throws an exception */
+  FAttrAlwaysInline = 1 << 5,   /* function: inline it whenever possible */
+  FAttrNoInline     = 1 << 6,   /* function: never inline it */
+  FAttrCold         = 1 << 7,   /* function: rarely called */
+  FAttrHot          = 1 << 8    /* function: frequently called */
+};
+
+/** A value is the index of an instruction in its function
+ * The indices are dense and given in creation order, so they can be used to
+ * index arrays with one entry per instruction. Constants are kept in a
+ * separate pool and receive the negative ids below -1 (see f_is_konst); each
+ * constant is stored once per function, so equal constants have equal ids. */
 typedef struct FValue {
-  int bblock;
-  int instr;
+  int id;
 } FValue;
 
 VEC_DECLARE(FValue);
@@ -95,17 +177,19 @@ typedef struct FPhiInc {
   FValue value;
 } FPhiInc;
 
-VEC_DECLARE(FPhiInc);
-
-/** SSA instructions */
+/** SSA instructions
+ * The instructions are packed in 24 bytes on 64-bit hosts: the type and the
+ * tag are stored in narrow fields, the operand lists of calls, phis and
+ * shuffles are allocated apart and constants are kept in their own pool. */
 typedef struct FInstr {
-  enum FType type;
-  enum FInstrTag tag;
+  unsigned short type;          /* enum FType */
+  unsigned char tag;            /* enum FInstrTag */
+  int next;                     /* next instruction of the block (-1 if last) */
   union {
     union { double f; ui64 i; void *p; } konst;
     struct { int n; } getarg;
-    struct { FValue addr; } load;
-    struct { FValue addr; FValue val; } store;
+    struct { FValue addr; enum FOrdering order; } load;
+    struct { FValue addr; FValue val; enum FOrdering order; } store;
     struct { FValue addr; FValue offset; int negative; } offset;
     struct { enum FCastTag op; FValue val; } cast;
     struct { enum FBinopTag op; FValue lhs; FValue rhs; } binop;
@@ -115,17 +199,48 @@ typedef struct FInstr {
     struct { int dest; } jmp;
     struct { FValue cond; FValue truev; FValue falsev; } select;
     struct { FValue val; } ret;
-    struct { int function; FValue* args; int nargs; } call;
-    struct { Vector(FPhiInc) inc; } phi;
+    struct { FValue* args; int function; int nargs; } call;
+    struct { FPhiInc *inc; int ninc; int capacity; } phi;
+    struct { FValue val; } splat;
+    struct { FValue vec; int lane; } extract;
+    struct { FValue vec; FValue val; int lane; } insert;
+    struct { FValue lhs; FValue rhs; int *mask; } shuffle;
+    struct { enum FBinopTag op; FValue vec; } reduce;
+    struct { FValue dst; FValue src; FValue size; signed int align : 24;
+      unsigned int isvolatile : 1; } copy;        /* FMemcpy and FMemmove */
+    struct { FValue dst; FValue val; FValue size; signed int align : 24;
+      unsigned int isvolatile : 1; } fill;        /* FMemset */
+    struct { FValue addr; int write; int locality; } prefetch;
+    struct { enum FAtomicTag op; FValue addr; FValue val;
+      enum FOrdering order; } atomic;
+    struct { FValue addr; FValue cmp; FValue val;
+      enum FOrdering order; } cmpxchg;
+    struct { enum FOrdering order; } fence;
+    struct { enum FUnopTag op; FValue val; } unop;
+    struct { enum FTernopTag op; FValue a; FValue b; FValue c; } ternop;
+    struct { enum FCheckedTag op; FValue lhs; FValue rhs; } checked;
+    struct { FValue checked; } overflowed;
+    struct { int size; FValue dynsize;
+      int align; } alloca;                        /* dynsize null if fixed */
   } u;
 } FInstr;
 
-VEC_DECLARE(FInstr);
-
-/** A basic block is an array of instructions */
-typedef Vector(FInstr) FBBlock;
-
-VEC_DECLARE(FBBlock);
+/** Use of a value by an operand of an instruction (see f_operand)
+ * The uses of each value are linked through next; iterate them with
+ * f_use_foreach. Constants and null values have no uses. */
+typedef struct FUse {
+  int user;                     /* instruction that has the operand */
+  int operand;                  /* index of the operand in the user */
+  int next;                     /* next use of the same value (-1 if last) */
+} FUse;
+
+/** A basic block is a list of instructions linked through FInstr.next
+ * Iterate it with f_bblock_foreach. */
+typedef struct FBBlock {
+  int first;                    /* -1 if the block is empty */
+  int last;
+  int ninstrs;
+} FBBlock;
 
 /** Function types */
 typedef struct FFunctionType {
@@ -135,32 +250,53 @@ typedef struct FFunctionType {
   int vararg;
 } FFunctionType;
 
-VEC_DECLARE(FFunctionType);
-
 /** Function tags */
 enum FFunctionTag {
   FExtFunc, FModFunc
 };
 
+/** Attributes of a function parameter */
+typedef struct FParamAttr {
+  int attrs;
+  int align;  /* minimum alignment of the pointer (0 if unknown) */
+} FParamAttr;
+
 /** Pointer to an external function */
 typedef void (*FFunctionPtr)(void);
 
-/** Function definition */
+/** Function definition
+ * The instructions of all basic blocks are stored in a single array, indexed
+ * by the value ids. The constants are stored in the konsts pool, which isn't
+ * part of any basic block; konstmap is the hash table that interns them by
+ * type and bits. The builder records the uses of each instruction in
+ * firstuse, which is indexed by the value ids and points into uses. */
 typedef struct FFunction {
   enum FFunctionTag tag;
   int type;
+  int attrs;
+  FParamAttr *params;           /* NULL if the parameters have no attributes */
   union {
     FFunctionPtr ptr;           /* FExtFunc */
-    Vector(FBBlock) bblocks;    /* FModFunc */
+    struct { FInstr *instrs; int ninstrs; int capinstrs;
+      FInstr *konsts; int nkonsts; int capkonsts;
+      int *konstmap; int capkonstmap;
+      int *firstuse; int capfirstuse;
+      FUse *uses; int nuses; int capuses;
+      FBBlock *bblocks; int nbblocks;
+      int capbblocks; } body;   /* FModFunc */
   } u;
 } FFunction;
 
-VEC_DECLARE(FFunction);
-
 /** Module is the root structure */
 typedef struct FModule {
-  Vector(FFunction) functions;
-  Vector(FFunctionType) ftypes;
+  FFunction *functions;
+  int nfunctions;
+  int capfunctions;
+  FFunctionType *ftypes;
+  int nftypes;
+  int capftypes;
+  FArena *arena;                /* storage of all the module data */
+  FArena ownarena;              /* used when no arena is given */
 } FModule;
 
 /** A builder is used to create new instructions */
@@ -172,12 +308,48 @@ typedef struct FBuilder {
 
 /* Functions ******************************************************************/
 
-/** Initialize the module structure */
+/** Initialize the arena
+ * New chunks have at least chunksize bytes; 0 selects the default size. */
+void f_init_arena(FArena *a, size_t chunksize);
+
+/** Release all chunks of the arena */
+void f_close_arena(FArena *a);
+
+/** Discard the arena contents, keeping the chunks for the next allocations */
+void f_reset_arena(FArena *a);
+
+/** Allocate memory in the arena (aligned for any type) */
+void *f_arena_alloc(FArena *a, size_t size);
+
+/** Resize memory allocated in the arena, like realloc
+ * The last allocation grows in place when the chunk has room; otherwise the
+ * contents are copied and the old memory is only reclaimed with the arena. */
+void *f_arena_grow(FArena *a, void *p, size_t oldsize, size_t newsize);
+
+/** Make room for one more element in an array allocated in the arena
+ * The capacity is doubled when the array is full. Return the array, which
+ * may have moved. */
+void *f_arena_reserve(FArena *a, void *data, int size, int *capacity,
+    size_t elemsize);
+
+/** Initialize the module structure, with its own arena */
 void f_init_module(FModule *m);
 
-/** Free all module data */
+/** Initialize the module structure, allocating the IR in the given arena
+ * The arena isn't released by f_close_module; it must outlive the module. */
+void f_init_module_arena(FModule *m, FArena *arena);
+
+/** Free all module data
+ * This is proportional to the number of arena chunks, not to the size of the
+ * IR. */
 void f_close_module(FModule *m);
 
+/** Remove all functions and types, so the module can be built again
+ * The arena is reset and its memory reused, which makes building the next
+ * module allocation free in the common case. If the arena was given by
+ * f_init_module_arena, it must not hold other live data. */
+void f_reset_module(FModule *m);
+
 /** Check if the type is an integer */
 #define f_is_int(t) ((t) >= FInt8 && (t) <= FInt64)
 
@@ -187,6 +359,19 @@ void f_close_module(FModule *m);
 /** Check if the type is numeric (int or float) */
 #define f_is_num(t) (f_is_int(t) || f_is_float(t))
 
+/** Obtain the vector type with the given number of lanes
+ * The number of lanes must be a power of two between 2 and 64. */
+#define f_vec(t, lanes) ((enum FType)((lanes) << 4 | (t)))
+
+/** Check if the type is a vector */
+#define f_is_vec(t) (((t) & FVecMask) != 0)
+
+/** Obtain the number of lanes of a type (1 for scalars) */
+#define f_lanes(t) (f_is_vec(t) ? (int)(t) >> 4 : 1)
+
+/** Obtain the type of the lanes of a vector (the type itself for scalars) */
+#define f_scalar(t) ((enum FType)((t) & ~FVecMask))
+
 /** Create a function type */
 int f_ftype(FModule *m, enum FType ret, int nargs, ...);
 
@@ -209,6 +394,26 @@ int f_add_function(FModule *m, int ftype);
 /** Add an external function to the module */
 int f_add_extfunction(FModule *m, int ftype, FFunctionPtr ptr);
 
+/** Copy a function of another module to the end of this module
+ * The copy calls the functions with the same indices as the original one.
+ * Return the index of the copy. */
+int f_copy_function(FModule *dst, FModule *src, int function);
+
+/** Add attributes to the function (see FAttr)
+ * Only ReadOnly, ReadNone, NoUnwind, AlwaysInline, NoInline, Cold and Hot are
+ * valid for functions. Attributes of external functions describe the host
+ * function and apply to every call. */
+void f_set_fattr(FModule *m, int function, int attrs);
+
+/** Add attributes to a parameter of the function (see FAttr)
+ * Only NoAlias, NonNull, ReadOnly and ReadNone are valid for parameters, and
+ * only for pointer parameters. */
+void f_set_argattr(FModule *m, int function, int arg, int attrs);
+
+/** Declare the minimum alignment of a pointer parameter
+ * The alignment is given in bytes and must be a power of two. */
+void f_set_argalign(FModule *m, int function, int arg, int align);
+
 /** Obtain a reference to a function given the index */
 FFunction *f_get_function(FModule *m, int function);
 
@@ -228,8 +433,8 @@ FBuilder f_builder(FModule *m, int function, int bblock);
 /** Change the block of the builder */
 void f_set_bblock(FBuilder *b, int bblock);
 
-/** Create a value */
-FValue f_value(int bblock, int instr);
+/** Create a value given the instruction index */
+FValue f_value(int id);
 
 /** Compare two values */
 int f_same(FValue a, FValue b);
@@ -237,9 +442,46 @@ int f_same(FValue a, FValue b);
 /** Verify is a value is null */
 int f_null(FValue v);
 
-/** Obtain the instruction given the value */
+/** Obtain the instruction given the value
+ * Constants are FKonst instructions of the function pool. */
 FInstr* f_instr(FModule *m, int function, FValue v);
 
+/** Obtain the nth value operand of the instruction
+ * The operands are numbered in the order of the FInstr fields; call
+ * arguments and phi incoming values are numbered in their order. Return NULL
+ * if the instruction has no such operand. Null operands (eg. the value of a
+ * void return) are counted, but never used. */
+FValue *f_operand(FInstr *i, int n);
+
+/** Replace all uses of the instruction old by value
+ * The use lists are updated as well; if value is a constant, the uses simply
+ * go away. Operands changed without this function aren't tracked by the use
+ * lists. */
+void f_replace_all_uses(FModule *m, int function, FValue old, FValue value);
+
+/** Check if the value is a constant of the function pool */
+#define f_is_konst(v) ((v).id < -1)
+
+/** Obtain the index of a constant in the function pool */
+#define f_konst_index(v) (-2 - (v).id)
+
+/** Obtain the value of the constant in the given index of the pool */
+#define f_konst_value(index) f_value(-2 - (index))
+
+/** Iterate the instructions of a basic block in order
+ * The variable id receives the index of each instruction, and the block must
+ * not change during the iteration. */
+#define f_bblock_foreach(f, bb, id) \
+  for ((id) = (f)->u.body.bblocks[bb].first; (id) >= 0; \
+       (id) = (f)->u.body.instrs[id].next)
+
+/** Iterate the uses of an instruction (see FUse)
+ * The variable u receives the index of each use in f->u.body.uses, the most
+ * recent first. The uses must not change during the iteration. */
+#define f_use_foreach(f, v, u) \
+  for ((u) = (f)->u.body.firstuse[(v).id]; (u) >= 0; \
+       (u) = (f)->u.body.uses[u].next)
+
 /**@}*/
 
 #endif
@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_queue_h
+#define fahrenheit_queue_h
+
+/** @file queue.h
+ *
+ * @defgroup Queue
+ * @brief Compile modules in background threads
+ *
+ * @{
+ * A queue owns a pool of compiler threads. The module passed to
+ * f_compile_async belongs to the compiler until the job is done, so it must
+ * not be changed or closed before that. The engine is only filled when the
+ * job finishes; meanwhile the caller can keep running its slow path and swap
+ * in the compiled functions once the callback fires.
+ */
+
+struct FEngine;
+struct FModule;
+struct FCompileOptions;
+
+/** Callback called by the compiler thread when a job finishes
+ * The status is the value that f_compile_ex would return. */
+typedef void (*FCompileCallback)(struct FEngine *e, int status,
+    void *userdata);
+
+/** Pool of compiler threads */
+typedef struct FCompileQueue {
+  void *data;
+} FCompileQueue;
+
+/** Handle of a compilation job */
+typedef struct FCompileJob FCompileJob;
+
+/** Initialize the queue and start the compiler threads
+ * If nthreads is not positive, use one thread per hardware core. */
+void f_init_queue(FCompileQueue *q, int nthreads);
+
+/** Wait for all pending jobs and stop the compiler threads */
+void f_close_queue(FCompileQueue *q);
+
+/** Compile the module in background
+ * The options are copied and can be NULL (see f_compile_ex).
+ * The callback can be NULL.
+ * The returned handle must be released with f_job_release. */
+FCompileJob *f_compile_async(FCompileQueue *q, struct FEngine *e,
+    struct FModule *m, const struct FCompileOptions *opts,
+    FCompileCallback callback, void *userdata);
+
+/** Return a value different from 0 if the job is finished
+ * The callback has already returned when the job is finished. */
+int f_job_done(FCompileJob *job);
+
+/** Block until the job finishes and return its status */
+int f_job_wait(FCompileJob *job);
+
+/** Release the job handle
+ * Releasing an unfinished job doesn't cancel it. */
+void f_job_release(FCompileJob *job);
+
+/**@}*/
+
+#endif
+
@@ -0,0 +1,113 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_tier_h
+#define fahrenheit_tier_h
+
+/** @file tier.h
+ *
+ * @defgroup Tiering
+ * @brief Start with cheap code and recompile the hot functions
+ *
+ * @{
+ * A tiered engine (FBackendTiered) first compiles the whole module with the
+ * baseline backend, injecting counters of calls and loop back edges into the
+ * code. Functions whose counters reach the thresholds are recompiled by LLVM
+ * with the engine compile options, and their entries in e->funcs are
+ * atomically replaced, so callers that read e->funcs[i] before each call
+ * (including the baseline code) pick up the optimized version; a call that
+ * is already running keeps executing the baseline code. Optimized
+ * functions call the others directly, so when a function is promoted the
+ * optimized functions that call it are recompiled with it. The hot functions
+ * found by a check are promoted together.
+ * The engine keeps a private copy of the module, so the module can still be
+ * disposed after the compilation. Tiered engines can't be compiled
+ * incrementally. If the baseline backend doesn't support the host or the
+ * module (see FBackendX64), the whole module is compiled with the
+ * optimizations right away.
+ */
+
+#include <fahrenheit/backend.h>
+
+struct FModule;
+
+/** Tiering options */
+typedef struct FTierOptions {
+  unsigned long call_threshold;   /* calls before a function is promoted */
+  unsigned long loop_threshold;   /* loop iterations before a promotion */
+  int background;                 /* check the counters in a thread */
+  int interval;                   /* milliseconds between background checks */
+} FTierOptions;
+
+/** Statistics of a tiered engine */
+typedef struct FTierStats {
+  unsigned long checks;           /* times the counters were checked */
+  unsigned long compilations;     /* optimized compilations */
+  unsigned long promotions;       /* functions promoted */
+  unsigned long failures;         /* functions that failed to compile */
+} FTierStats;
+
+/** Tier of a function */
+enum FTier {
+  FTierBaseline,                  /* instrumented baseline code */
+  FTierOptimized,                 /* code optimized by LLVM */
+  FTierFailed                     /* the optimized compilation failed */
+};
+
+/** Statistics of a function in a tiered engine
+ * External functions are reported as optimized. */
+typedef struct FTierFunctionStats {
+  unsigned long calls;            /* calls counted by the baseline code */
+  unsigned long loops;            /* back edges counted by the baseline code */
+  enum FTier tier;
+} FTierFunctionStats;
+
+/** Initialize the options with the default values
+ * Functions are promoted after 1000 calls or 10000 loop iterations; the
+ * counters are checked by a background thread every 10 milliseconds. */
+void f_init_tier_options(FTierOptions *opts);
+
+/** Compile the module into a tiered engine
+ * The compile options are used by the optimized tier and the tier options
+ * can be NULL (see f_init_tier_options). Calling f_compile_ex with a
+ * FBackendTiered engine is the same as passing NULL tier options.
+ * Return a value different from 0 if there is an unexpected error. */
+int f_compile_tiered(FEngine *e, struct FModule *m,
+    const FCompileOptions *opts, const FTierOptions *tier);
+
+/** Check the counters and promote the hot functions in the calling thread
+ * Return the number of promoted functions. */
+int f_tier_update(FEngine *e);
+
+/** Obtain the statistics of the tiered engine */
+void f_get_tier_stats(FEngine *e, FTierStats *stats);
+
+/** Obtain the statistics of a function of the tiered engine */
+void f_get_tier_function_stats(FEngine *e, int function,
+    FTierFunctionStats *stats);
+
+/**@}*/
+
+#endif
+
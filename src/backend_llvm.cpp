@@ -22,85 +22,462 @@
  * IN THE SOFTWARE.
  */
 
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wshadow"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/ReaderWriter.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
-#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Vectorize.h>
 #pragma GCC diagnostic pop
 
 extern "C" {
 #include <fahrenheit/backend.h>
+#include <fahrenheit/bitcode.h>
+#include <fahrenheit/hash.h>
 #include <fahrenheit/ir.h>
+
+#include "engine.h"
 }
 
 namespace {
 
-static llvm::LLVMContext TheContext;
+/* Machine code generated by a compilation
+ * Each compilation has its own context, so different engines can be compiled
+ * in parallel by different threads. The code is shared between the engine and
+ * the function cache, and it also keeps alive the cached code it calls. */
+struct LazyFunctions;
+struct CompiledCode {
+  llvm::LLVMContext context;
+  size_t size = 0;              /* bytes of the sections of the engine */
+  std::unordered_map<std::string, uint64_t> symbols;
+  std::unique_ptr<llvm::ExecutionEngine> ee;
+  std::vector<std::shared_ptr<CompiledCode>> deps;
+  std::unique_ptr<LazyFunctions> lazy;
+};
+
+/* ORC state of the functions that are compiled on the first call
+ * The lock serializes the compile callbacks because they use the code
+ * context, which isn't thread safe. The module of a function is released when
+ * it is compiled; threads that were waiting for it obtain its address. */
+struct LazyFunctions {
+  std::mutex mutex;
+  std::unique_ptr<llvm::orc::JITCompileCallbackManager> callbacks;
+  std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+  std::unordered_map<std::string, std::unique_ptr<llvm::Module>> modules;
+  std::unordered_map<std::string, uint64_t> compiled;
+};
 
-/* Engine exported */
+/* Engine exported
+ * The options are kept for the incremental compilations. */
 struct FEngineData {
-  std::unique_ptr<llvm::ExecutionEngine> ee;
+  std::shared_ptr<CompiledCode> code;
   std::vector<FJitFunc> functions;
+  FCompileOptions options;
+  std::string cache_dir;
+  std::string cpu;
+  std::string features;
+};
+
+/* Resolve the external functions using the code symbols instead of the
+ * process-wide symbol table (which isn't thread safe) */
+class MemoryManager : public llvm::SectionMemoryManager {
+public:
+  MemoryManager(CompiledCode &code_) : code(code_) {}
+
+  uint64_t getSymbolAddress(const std::string &name) override {
+    auto symbol = code.symbols.find(name);
+    if (symbol == code.symbols.end() && !name.empty() && name[0] == '_')
+      symbol = code.symbols.find(name.substr(1));
+    if (symbol != code.symbols.end())
+      return symbol->second;
+    return llvm::SectionMemoryManager::getSymbolAddress(name);
+  }
+
+  uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment,
+      unsigned id, llvm::StringRef name) override {
+    code.size += size;
+    return llvm::SectionMemoryManager::allocateCodeSection(size, alignment, id,
+      name);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t size, unsigned alignment,
+      unsigned id, llvm::StringRef name, bool readonly) override {
+    code.size += size;
+    return llvm::SectionMemoryManager::allocateDataSection(size, alignment, id,
+      name, readonly);
+  }
+
+private:
+  CompiledCode &code;
+};
+
+/* Key of a function in the function cache or of an object in the disk cache
+ * The check is an independent hash of the same contents. It is compared on
+ * lookup, so a collision of the hashes doesn't return other code. */
+struct CacheKey {
+  ui64 hash;
+  ui64 check;
+};
+
+/* Seed of the check hashes */
+const ui64 check_seed = 0x9e3779b97f4a7c15ull;
+
+/* Combine a value into both hashes of the key */
+CacheKey combine_key(CacheKey key, ui64 value) {
+  return CacheKey{f_hash_combine(key.hash, value),
+    f_hash_combine(key.check, value)};
+}
+
+/* Process-wide cache of compiled functions
+ * Each entry keeps alive the code of the whole compilation it came from, so
+ * the budget is charged with the size of each compilation once, while any of
+ * its functions is cached. The entries are evicted in LRU order until the
+ * size fits the budget. Evicting an entry doesn't release the code of the
+ * engines that use it. */
+class FunctionCache {
+public:
+  bool enabled() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget > 0;
+  }
+
+  /* Obtain a cached function and its code, return nullptr if not found */
+  FJitFunc lookup(CacheKey key, std::shared_ptr<CompiledCode> &code) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(key.hash);
+    if (entry == entries.end() || entry->second.check != key.check) {
+      misses++;
+      return nullptr;
+    }
+    hits++;
+    lru.splice(lru.begin(), lru, entry->second.lru);
+    code = entry->second.code;
+    return entry->second.function;
+  }
+
+  /* Add a function that was just compiled */
+  void insert(CacheKey key, FJitFunc function,
+      std::shared_ptr<CompiledCode> code) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (code->size > budget || entries.count(key.hash)) return;
+    auto &charge = charges[code.get()];
+    used += code->size - charge.size;
+    charge.size = code->size;
+    charge.entries++;
+    lru.push_front(key.hash);
+    entries[key.hash] = Entry{function, key.check, code, lru.begin()};
+    evict(budget);
+  }
+
+  void set_budget(size_t new_budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = new_budget;
+    evict(budget);
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    evict(0);
+  }
+
+  void stats(FCacheStats *s) {
+    std::lock_guard<std::mutex> lock(mutex);
+    s->hits = hits;
+    s->misses = misses;
+    s->evictions = evictions;
+    s->entries = entries.size();
+    s->size = used;
+    s->budget = budget;
+  }
+
+private:
+  struct Entry {
+    FJitFunc function;
+    ui64 check;
+    std::shared_ptr<CompiledCode> code;
+    std::list<ui64>::iterator lru;
+  };
+
+  /* Size charged for a compilation and the number of its cached functions
+   * The compilation may grow with incremental compilations, so the charge is
+   * updated by each insertion. */
+  struct Charge {
+    size_t size;
+    int entries;
+  };
+
+  /* Remove the least recently used entries until the size fits the limit
+   * The size of a compilation is only discounted with its last entry. */
+  void evict(size_t limit) {
+    while (!lru.empty() && (used > limit || limit == 0)) {
+      auto entry = entries.find(lru.back());
+      auto charge = charges.find(entry->second.code.get());
+      if (--charge->second.entries == 0) {
+        used -= charge->second.size;
+        charges.erase(charge);
+      }
+      entries.erase(entry);
+      lru.pop_back();
+      evictions++;
+    }
+  }
+
+  std::mutex mutex;
+  std::unordered_map<ui64, Entry> entries;
+  std::unordered_map<CompiledCode *, Charge> charges;
+  std::list<ui64> lru;
+  size_t budget = 0;
+  size_t used = 0;
+  unsigned long hits = 0;
+  unsigned long misses = 0;
+  unsigned long evictions = 0;
 };
 
-/* Compile state for a module */
+/* Obtain the function cache */
+FunctionCache &function_cache() {
+  static FunctionCache cache;
+  return cache;
+}
+
+/* Process-wide registry of host functions defined in bitcode
+ * The buffers are never released, so the compilations can use them after the
+ * lookup without holding the lock. */
+class BitcodeRegistry {
+public:
+  /* Register a buffer, return false if it isn't valid bitcode or if it
+   * defines a function that is already defined by another buffer */
+  bool add(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+    llvm::LLVMContext context;
+    auto module = llvm::parseBitcodeFile(buffer->getMemBufferRef(), context);
+    if (!module) return false;
+    std::vector<std::string> names;
+    for (auto &function : **module)
+      if (!function.isDeclaration() && !function.hasLocalLinkage())
+        names.push_back(function.getName().str());
+    ui64 hash = f_hash_init();
+    for (auto c : buffer->getBuffer())
+      hash = f_hash_combine(hash, c);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &name : names)
+      if (definitions.count(name)) return false;
+    for (auto &name : names)
+      definitions[name] = Definition{buffer.get(), hash};
+    buffers.push_back(std::move(buffer));
+    return true;
+  }
+
+  /* Bind a host function, return false if it isn't defined */
+  bool bind(FFunctionPtr ptr, const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto definition = definitions.find(name);
+    if (definition == definitions.end()) return false;
+    auto key = f_hash_combine(f_hash_init(), definition->second.hash);
+    for (auto c : name)
+      key = f_hash_combine(key, c);
+    bindings[ptr] = Binding{definition->second.buffer, name, key};
+    return true;
+  }
+
+  /* Obtain the bitcode and the name of a host function
+   * Return nullptr if the function isn't bound. */
+  const llvm::MemoryBuffer *find(FFunctionPtr ptr, std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto binding = bindings.find(ptr);
+    if (binding == bindings.end()) return nullptr;
+    name = binding->second.name;
+    return binding->second.buffer;
+  }
+
+  /* Obtain the hash of the bitcode and the name a host function is bound to
+   * Return 0 if the function isn't bound. */
+  ui64 binding_key(FFunctionPtr ptr) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto binding = bindings.find(ptr);
+    return binding != bindings.end() ? binding->second.key : 0;
+  }
+
+private:
+  struct Definition {
+    const llvm::MemoryBuffer *buffer;
+    ui64 hash;                  /* hash of the buffer contents */
+  };
+
+  struct Binding {
+    const llvm::MemoryBuffer *buffer;
+    std::string name;
+    ui64 key;                   /* see binding_key */
+  };
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+  std::unordered_map<std::string, Definition> definitions;
+  std::unordered_map<FFunctionPtr, Binding> bindings;
+};
+
+/* Obtain the bitcode registry */
+BitcodeRegistry &bitcode_registry() {
+  static BitcodeRegistry registry;
+  return registry;
+}
+
+/* Compile state for a module
+ * A module may contain only a partition of the IR functions. */
 struct ModuleState {
-  FEngineData &engine;
+  llvm::LLVMContext &context;
   FModule *irmodule;
   std::unique_ptr<llvm::Module> module;
   std::vector<llvm::Function *> functions;
+  std::vector<const llvm::MemoryBuffer *> bitcode;  /* linked after lowering */
 
-  ModuleState(FEngineData &engine_, FModule *irmodule_)
-    : engine(engine_)
+  ModuleState(llvm::LLVMContext &context_, FModule *irmodule_)
+    : context(context_)
     , irmodule(irmodule_)
-    , module(new llvm::Module("m", TheContext)) {}
+    , module(new llvm::Module("m", context_))
+    , functions(irmodule_->nfunctions, nullptr) {}
 };
 
 /* Compile state for a function */
 struct FunctionState {
   int function;
   std::vector<llvm::BasicBlock *> bblocks;
-  std::vector<std::vector<llvm::Value *>> values;
+  std::vector<llvm::Value *> values;
+  std::vector<llvm::Constant *> konsts;
+  int bblock;
 };
 
+/* Obtain the type of an instruction */
+enum FType get_type(FInstr *i) {
+  return static_cast<enum FType>(i->type);
+}
+
 /* Convert an fahrenheit type to a llvm type */
-llvm::Type *convert_type(enum FType type) {
+llvm::Type *convert_type(llvm::LLVMContext &context, enum FType type) {
+  if (f_is_vec(type))
+    return llvm::VectorType::get(convert_type(context, f_scalar(type)),
+      f_lanes(type));
   switch (type) {
     case FBool:
-      return llvm::IntegerType::get(TheContext, 1);
+      return llvm::IntegerType::get(context, 1);
     case FInt8:
-      return llvm::IntegerType::get(TheContext, 8);
+      return llvm::IntegerType::get(context, 8);
     case FInt16:
-      return llvm::IntegerType::get(TheContext, 16);
+      return llvm::IntegerType::get(context, 16);
     case FInt32:
-      return llvm::IntegerType::get(TheContext, 32);
+      return llvm::IntegerType::get(context, 32);
     case FInt64:
-      return llvm::IntegerType::get(TheContext, 64);
+      return llvm::IntegerType::get(context, 64);
     case FFloat:
-      return llvm::Type::getFloatTy(TheContext);
+      return llvm::Type::getFloatTy(context);
     case FDouble:
-      return llvm::Type::getDoubleTy(TheContext);
+      return llvm::Type::getDoubleTy(context);
     case FPointer:
       return llvm::PointerType::get(
-        llvm::IntegerType::get(TheContext, 8), 0);
+        llvm::IntegerType::get(context, 8), 0);
     case FVoid:
-      return llvm::Type::getVoidTy(TheContext);
+      return llvm::Type::getVoidTy(context);
+    default:
+      break;
   }
   return nullptr;
 }
 
+/* Obtain the alignment of a memory access
+ * Vectors are accessed with the alignment of their lanes, so they can be
+ * loaded from any position of an array. */
+unsigned access_alignment(enum FType type) {
+  switch (f_scalar(type)) {
+    case FInt16: return 2;
+    case FInt32: case FFloat: return 4;
+    case FInt64: case FDouble: return 8;
+    case FPointer: return sizeof(void *);
+    default: return 1;
+  }
+}
+
+/* Convert the memory ordering of an atomic instruction */
+llvm::AtomicOrdering convert_ordering(enum FOrdering order) {
+  switch (order) {
+    case FRelaxed: return llvm::AtomicOrdering::Monotonic;
+    case FAcquire: return llvm::AtomicOrdering::Acquire;
+    case FRelease: return llvm::AtomicOrdering::Release;
+    case FAcqRel: return llvm::AtomicOrdering::AcquireRelease;
+    case FSeqCst: return llvm::AtomicOrdering::SequentiallyConsistent;
+    default: return llvm::AtomicOrdering::NotAtomic;
+  }
+}
+
+/* Convert an atomic read-modify-write operation */
+llvm::AtomicRMWInst::BinOp convert_atomic(enum FAtomicTag op) {
+  switch (op) {
+    case FAtomicXchg: return llvm::AtomicRMWInst::Xchg;
+    case FAtomicAdd: return llvm::AtomicRMWInst::Add;
+    case FAtomicSub: return llvm::AtomicRMWInst::Sub;
+    case FAtomicAnd: return llvm::AtomicRMWInst::And;
+    case FAtomicOr: return llvm::AtomicRMWInst::Or;
+    case FAtomicXor: return llvm::AtomicRMWInst::Xor;
+    case FAtomicMin: return llvm::AtomicRMWInst::Min;
+    case FAtomicMax: return llvm::AtomicRMWInst::Max;
+    case FAtomicUMin: return llvm::AtomicRMWInst::UMin;
+    case FAtomicUMax: return llvm::AtomicRMWInst::UMax;
+  }
+  return llvm::AtomicRMWInst::BAD_BINOP;
+}
+
+/* Combine the lanes of a vector in pairs until a single one is left */
+llvm::Value *create_reduce(llvm::IRBuilder<> &b,
+    llvm::Instruction::BinaryOps op, llvm::Value *vec, int lanes) {
+  while (lanes > 1) {
+    std::vector<llvm::Constant *> lo, hi;
+    lanes /= 2;
+    for (int l = 0; l < lanes; ++l) {
+      lo.push_back(b.getInt32(l));
+      hi.push_back(b.getInt32(lanes + l));
+    }
+    auto undef = llvm::UndefValue::get(vec->getType());
+    auto lhs = b.CreateShuffleVector(vec, undef,
+      llvm::ConstantVector::get(lo));
+    auto rhs = b.CreateShuffleVector(vec, undef,
+      llvm::ConstantVector::get(hi));
+    vec = b.CreateBinOp(op, lhs, rhs);
+  }
+  return b.CreateExtractElement(vec, b.getInt32(0));
+}
+
 llvm::Instruction::BinaryOps convert_binop(enum FBinopTag op, enum FType type) {
   switch (op) {
     case FAdd:
@@ -129,39 +506,165 @@ llvm::Instruction::BinaryOps convert_binop(enum FBinopTag op, enum FType type) {
     case FAnd: return llvm::Instruction::And;
     case FOr:  return llvm::Instruction::Or;
     case FXor: return llvm::Instruction::Xor;
+    case FUDiv: return llvm::Instruction::UDiv;
+    case FSRem: return llvm::Instruction::SRem;
+    case FAShr: return llvm::Instruction::AShr;
+    default: break;
   }
   return llvm::Instruction::Add;
 }
 
-/* Declare a function */
-void declare_function(ModuleState &ms, int function) {
+/* Create a binary operation
+ * The operations without a LLVM instruction are built from comparisons,
+ * shifts and intrinsics; the backend recognizes them as single instructions
+ * (eg. rol, minsd and cmov). */
+llvm::Value *create_binop(ModuleState &ms, llvm::IRBuilder<> &b,
+    enum FBinopTag op, enum FType type, llvm::Value *lhs, llvm::Value *rhs) {
+  auto llvmtype = lhs->getType();
+  switch (op) {
+    case FMin:
+    case FMax:
+      if (f_is_float(f_scalar(type))) {
+        auto id = op == FMin ? llvm::Intrinsic::minnum :
+          llvm::Intrinsic::maxnum;
+        auto f = llvm::Intrinsic::getDeclaration(ms.module.get(), id,
+          {llvmtype});
+        return b.CreateCall(f, {lhs, rhs});
+      }
+      if (op == FMin)
+        return b.CreateSelect(b.CreateICmpSLE(lhs, rhs), lhs, rhs);
+      return b.CreateSelect(b.CreateICmpSGE(lhs, rhs), lhs, rhs);
+    case FUMin:
+      return b.CreateSelect(b.CreateICmpULE(lhs, rhs), lhs, rhs);
+    case FUMax:
+      return b.CreateSelect(b.CreateICmpUGE(lhs, rhs), lhs, rhs);
+    case FRotl:
+    case FRotr: {
+      /* x << (n & (w - 1)) | x >> (-n & (w - 1)), for rotl */
+      auto mask = llvm::ConstantInt::get(llvmtype,
+        llvmtype->getScalarSizeInBits() - 1);
+      auto n = b.CreateAnd(rhs, mask);
+      auto m = b.CreateAnd(b.CreateNeg(rhs), mask);
+      auto left = b.CreateShl(lhs, op == FRotl ? n : m);
+      auto right = b.CreateLShr(lhs, op == FRotl ? m : n);
+      return b.CreateOr(left, right);
+    }
+    default:
+      return b.CreateBinOp(convert_binop(op, f_scalar(type)), lhs, rhs);
+  }
+}
+
+/* Create a unary operation (mostly intrinsics) */
+llvm::Value *create_unop(ModuleState &ms, llvm::IRBuilder<> &b,
+    enum FUnopTag op, enum FType type, llvm::Value *val) {
+  auto llvmtype = val->getType();
+  auto id = llvm::Intrinsic::not_intrinsic;
+  switch (op) {
+    case FSqrt: id = llvm::Intrinsic::sqrt; break;
+    case FFloor: id = llvm::Intrinsic::floor; break;
+    case FCeil: id = llvm::Intrinsic::ceil; break;
+    case FPopcount: id = llvm::Intrinsic::ctpop; break;
+    case FBswap: id = llvm::Intrinsic::bswap; break;
+    case FAbs:
+      if (f_is_int(f_scalar(type))) {
+        auto zero = llvm::Constant::getNullValue(llvmtype);
+        return b.CreateSelect(b.CreateICmpSLT(val, zero), b.CreateNeg(val),
+          val);
+      }
+      id = llvm::Intrinsic::fabs;
+      break;
+    case FCtlz:
+    case FCttz: {
+      /* The result is defined for zero */
+      id = op == FCtlz ? llvm::Intrinsic::ctlz : llvm::Intrinsic::cttz;
+      auto f = llvm::Intrinsic::getDeclaration(ms.module.get(), id,
+        {llvmtype});
+      return b.CreateCall(f, {val, b.getFalse()});
+    }
+  }
+  auto f = llvm::Intrinsic::getDeclaration(ms.module.get(), id, {llvmtype});
+  return b.CreateCall(f, {val});
+}
+
+/* Obtain the symbol name of a function
+ * External functions are resolved by name through the engine symbols. */
+std::string function_name(int function) {
+  return "f" + std::to_string(function);
+}
+
+/* Add the llvm attributes that correspond to the ir ones */
+void add_attributes(llvm::Function *llvm_f, unsigned index, int attrs) {
+  static const std::pair<int, llvm::Attribute::AttrKind> kinds[] = {
+    {FAttrNoAlias,      llvm::Attribute::NoAlias},
+    {FAttrNonNull,      llvm::Attribute::NonNull},
+    {FAttrReadOnly,     llvm::Attribute::ReadOnly},
+    {FAttrReadNone,     llvm::Attribute::ReadNone},
+    {FAttrNoUnwind,     llvm::Attribute::NoUnwind},
+    {FAttrAlwaysInline, llvm::Attribute::AlwaysInline},
+    {FAttrNoInline,     llvm::Attribute::NoInline},
+    {FAttrCold,         llvm::Attribute::Cold},
+    {FAttrHot,          llvm::Attribute::InlineHint}
+  };
+  for (auto &kind : kinds)
+    if (attrs & kind.first)
+      llvm_f->addAttribute(index, kind.second);
+}
+
+/* Set the attributes of the function and of its parameters
+ * LLVM has no hot attribute, so hot functions are marked as inlining
+ * candidates instead. */
+void set_attributes(ModuleState &ms, int function, llvm::Function *llvm_f) {
   auto f = f_get_function(ms.irmodule, function);
+  auto ftype = f_get_ftype(ms.irmodule, f->type);
+  add_attributes(llvm_f, llvm::AttributeSet::FunctionIndex, f->attrs);
+  if (!f->params) return;
+  for (int i = 0; i < ftype->nargs; ++i) {
+    add_attributes(llvm_f, i + 1, f->params[i].attrs);
+    if (f->params[i].align)
+      llvm_f->addAttribute(i + 1, llvm::Attribute::getWithAlignment(
+        ms.context, f->params[i].align));
+  }
+}
+
+/* Obtain the llvm function, it is declared in the module on the first use
+ * External functions bound to bitcode are declared with the bitcode name, so
+ * their definitions replace the declarations when the bitcode is linked. If
+ * the module already declares that name with another type, the function is
+ * called as a plain external function instead. */
+llvm::Function *get_function(ModuleState &ms, int function) {
+  auto &llvm_f = ms.functions[function];
+  if (llvm_f) return llvm_f;
   auto ftype = f_get_ftype_by_function(ms.irmodule, function);
-  auto ret = convert_type(ftype->ret);
+  auto ret = convert_type(ms.context, ftype->ret);
   std::vector<llvm::Type*> args;
   for (int i = 0; i < ftype->nargs; ++i)
-    args.push_back(convert_type(ftype->args[i]));
+    args.push_back(convert_type(ms.context, ftype->args[i]));
   auto type = llvm::FunctionType::get(ret, args, ftype->vararg);
-  llvm::Function *llvm_f;
-  if (f->tag == FExtFunc) {
-    std::stringstream name;
-    name << "f" << f->u.ptr;
-    auto addr = reinterpret_cast<void*>(f->u.ptr);
-    llvm::sys::DynamicLibrary::AddSymbol(name.str(), addr);
-    llvm_f = ms.module->getFunction(name.str());
-    if (!llvm_f)
-      llvm_f = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
-        name.str(), ms.module.get());
-  } else {
-    llvm_f = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
-      "f" + std::to_string(function), ms.module.get());
+  auto f = f_get_function(ms.irmodule, function);
+  auto name = function_name(function);
+  auto bitcode = f->tag == FExtFunc ?
+    bitcode_registry().find(f->u.ptr, name) : nullptr;
+  if (bitcode) {
+    auto declared = ms.module->getFunction(name);
+    if (declared && declared->getFunctionType() == type)
+      return llvm_f = declared;
+    if (declared)
+      name = function_name(function);
+    else if (std::find(ms.bitcode.begin(), ms.bitcode.end(), bitcode) ==
+        ms.bitcode.end())
+      ms.bitcode.push_back(bitcode);
   }
-  ms.functions.push_back(llvm_f);
+  llvm_f = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+    name, ms.module.get());
+  set_attributes(ms, function, llvm_f);
+  return llvm_f;
 }
 
 /* Obtain a llvm value given the ir value */
 llvm::Value *get_value(FunctionState &fs, FValue irvalue) {
-  return fs.values[irvalue.bblock][irvalue.instr];
+  if (f_is_konst(irvalue))
+    return fs.konsts[f_konst_index(irvalue)];
+  return fs.values[irvalue.id];
 }
 
 /* Convert an integer comparison */
@@ -200,28 +703,30 @@ llvm::CmpInst::Predicate convert_fpcmp(enum FFpCmpTag op) {
   return llvm::CmpInst::FCMP_OEQ;
 }
 
+/* Lower a constant of the pool */
+llvm::Constant *compile_konst(ModuleState &ms, FInstr *i) {
+  auto type = get_type(i);
+  auto ktype = convert_type(ms.context, type);
+  if (type == FBool || f_is_int(type))
+    return llvm::ConstantInt::get(ktype, i->u.konst.i);
+  if (f_is_float(type))
+    return llvm::ConstantFP::get(ktype, i->u.konst.f);
+  auto intptrt = llvm::IntegerType::get(ms.context, 8 * sizeof(void *));
+  auto intptr = llvm::ConstantInt::get(intptrt, (uintptr_t)i->u.konst.p);
+  return llvm::ConstantExpr::getIntToPtr(intptr, ktype);
+}
+
 /* Compile a single instruction */
 void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
-  auto function = ms.functions[fs.function];
-  llvm::IRBuilder<> b(TheContext);
-  b.SetInsertPoint(fs.bblocks[irvalue.bblock]);
+  auto function = get_function(ms, fs.function);
+  llvm::IRBuilder<> b(ms.context);
+  b.SetInsertPoint(fs.bblocks[fs.bblock]);
   auto i = f_instr(ms.irmodule, fs.function, irvalue);
-  auto &v = fs.values[irvalue.bblock][irvalue.instr];
+  auto &v = fs.values[irvalue.id];
   switch (i->tag) {
-    case FKonst: {
-      auto ktype = convert_type(i->type);
-      if (i->type == FBool || f_is_int(i->type))
-        v = llvm::ConstantInt::get(ktype, i->u.konst.i);
-      else if (f_is_float(i->type))
-        v = llvm::ConstantFP::get(ktype, i->u.konst.f);
-      else {
-        auto intptrt = llvm::IntegerType::get(TheContext, 8 * sizeof(void *));
-        auto intptr = llvm::ConstantInt::get(intptrt,
-          (uintptr_t)i->u.konst.p);
-        v = b.CreateIntToPtr(intptr, convert_type(FPointer), "");
-      }
+    case FKonst:
+      /* Lowered by compile_function */
       break;
-    }
     case FGetarg: {
       int n = i->u.getarg.n;
       auto& args = function->getArgumentList();
@@ -230,10 +735,18 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
     }
     case FLoad: {
       auto raw_addr = get_value(fs, i->u.load.addr);
-      auto raw_addrtype = convert_type(i->type);
+      auto raw_addrtype = convert_type(ms.context, get_type(i));
       auto addrtype = llvm::PointerType::get(raw_addrtype, 0);
       auto addr = b.CreateBitCast(raw_addr, addrtype, "");
-      v = b.CreateLoad(addr);
+      if (f_is_vec(get_type(i))) {
+        v = b.CreateAlignedLoad(addr, access_alignment(get_type(i)));
+      } else if (i->u.load.order != FNotAtomic) {
+        auto load = b.CreateAlignedLoad(addr, access_alignment(get_type(i)));
+        load->setAtomic(convert_ordering(i->u.load.order));
+        v = load;
+      } else {
+        v = b.CreateLoad(addr);
+      }
       break;
     }
     case FStore: {
@@ -241,7 +754,18 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
       auto val = get_value(fs, i->u.store.val);
       auto addrtype = llvm::PointerType::get(val->getType(), 0);
       auto addr = b.CreateBitCast(raw_addr, addrtype, "");
-      v = b.CreateStore(val, addr);
+      auto valinstr = f_instr(ms.irmodule, fs.function, i->u.store.val);
+      auto valtype = get_type(valinstr);
+      if (f_is_vec(valtype)) {
+        v = b.CreateAlignedStore(val, addr, access_alignment(valtype));
+      } else if (i->u.store.order != FNotAtomic) {
+        auto store = b.CreateAlignedStore(val, addr,
+          access_alignment(valtype));
+        store->setAtomic(convert_ordering(i->u.store.order));
+        v = store;
+      } else {
+        v = b.CreateStore(val, addr);
+      }
       break;
     }
     case FOffset: {
@@ -254,7 +778,7 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
     }
     case FCast: {
       auto val = get_value(fs, i->u.cast.val);
-      auto t = convert_type(i->type);
+      auto t = convert_type(ms.context, get_type(i));
       auto op = i->u.cast.op;
       switch (op) {
         case FUIntCast:
@@ -282,8 +806,7 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
     case FBinop: {
       auto lhs = get_value(fs, i->u.binop.lhs);
       auto rhs = get_value(fs, i->u.binop.rhs);
-      auto op = convert_binop(i->u.binop.op, i->type);
-      v = b.CreateBinOp(op, lhs, rhs);
+      v = create_binop(ms, b, i->u.binop.op, get_type(i), lhs, rhs);
       break;
     }
     case FIntCmp: {
@@ -334,12 +857,141 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
       for(int a = 0; a < i->u.call.nargs; ++a) {
         args.push_back(get_value(fs, i->u.call.args[a]));
       }
-      v = b.CreateCall(ms.functions[i->u.call.function], args);
+      v = b.CreateCall(get_function(ms, i->u.call.function), args);
       break;
     }
     case FPhi: {
-      auto type = convert_type(i->type);
-      v = b.CreatePHI(type, vec_size(i->u.phi.inc));
+      auto type = convert_type(ms.context, get_type(i));
+      v = b.CreatePHI(type, i->u.phi.ninc);
+      break;
+    }
+    case FSplat: {
+      auto val = get_value(fs, i->u.splat.val);
+      v = b.CreateVectorSplat(f_lanes(get_type(i)), val);
+      break;
+    }
+    case FExtract: {
+      auto vec = get_value(fs, i->u.extract.vec);
+      v = b.CreateExtractElement(vec, b.getInt32(i->u.extract.lane));
+      break;
+    }
+    case FInsert: {
+      auto vec = get_value(fs, i->u.insert.vec);
+      auto val = get_value(fs, i->u.insert.val);
+      v = b.CreateInsertElement(vec, val, b.getInt32(i->u.insert.lane));
+      break;
+    }
+    case FShuffle: {
+      auto lhs = get_value(fs, i->u.shuffle.lhs);
+      auto rhs = get_value(fs, i->u.shuffle.rhs);
+      std::vector<llvm::Constant *> mask;
+      for (int l = 0; l < f_lanes(get_type(i)); ++l)
+        mask.push_back(b.getInt32(i->u.shuffle.mask[l]));
+      v = b.CreateShuffleVector(lhs, rhs, llvm::ConstantVector::get(mask));
+      break;
+    }
+    case FReduce: {
+      auto vec = get_value(fs, i->u.reduce.vec);
+      auto op = convert_binop(i->u.reduce.op, get_type(i));
+      auto type = get_type(f_instr(ms.irmodule, fs.function, i->u.reduce.vec));
+      v = create_reduce(b, op, vec, f_lanes(type));
+      break;
+    }
+    case FMemcpy:
+    case FMemmove: {
+      auto dst = get_value(fs, i->u.copy.dst);
+      auto src = get_value(fs, i->u.copy.src);
+      auto size = b.CreateZExt(get_value(fs, i->u.copy.size), b.getInt64Ty());
+      if (i->tag == FMemcpy)
+        v = b.CreateMemCpy(dst, src, size, i->u.copy.align,
+          i->u.copy.isvolatile);
+      else
+        v = b.CreateMemMove(dst, src, size, i->u.copy.align,
+          i->u.copy.isvolatile);
+      break;
+    }
+    case FMemset: {
+      auto dst = get_value(fs, i->u.fill.dst);
+      auto val = get_value(fs, i->u.fill.val);
+      auto size = b.CreateZExt(get_value(fs, i->u.fill.size), b.getInt64Ty());
+      v = b.CreateMemSet(dst, val, size, i->u.fill.align,
+        i->u.fill.isvolatile);
+      break;
+    }
+    case FPrefetch: {
+      auto prefetch = llvm::Intrinsic::getDeclaration(ms.module.get(),
+        llvm::Intrinsic::prefetch);
+      v = b.CreateCall(prefetch, {get_value(fs, i->u.prefetch.addr),
+        b.getInt32(i->u.prefetch.write), b.getInt32(i->u.prefetch.locality),
+        b.getInt32(1)});
+      break;
+    }
+    case FAlloca: {
+      /* Byte array, SROA splits it by the accesses */
+      auto size = f_null(i->u.alloca.dynsize) ?
+        b.getInt32(i->u.alloca.size) : get_value(fs, i->u.alloca.dynsize);
+      auto mem = b.CreateAlloca(b.getInt8Ty(), size);
+      mem->setAlignment(i->u.alloca.align ? i->u.alloca.align : 16);
+      v = mem;
+      break;
+    }
+    case FAtomicRmw: {
+      auto val = get_value(fs, i->u.atomic.val);
+      auto addrtype = llvm::PointerType::get(val->getType(), 0);
+      auto addr = b.CreateBitCast(get_value(fs, i->u.atomic.addr), addrtype);
+      v = b.CreateAtomicRMW(convert_atomic(i->u.atomic.op), addr, val,
+        convert_ordering(i->u.atomic.order));
+      break;
+    }
+    case FCmpxchg: {
+      auto cmp = get_value(fs, i->u.cmpxchg.cmp);
+      auto val = get_value(fs, i->u.cmpxchg.val);
+      auto addrtype = llvm::PointerType::get(val->getType(), 0);
+      auto addr = b.CreateBitCast(get_value(fs, i->u.cmpxchg.addr), addrtype);
+      auto order = convert_ordering(i->u.cmpxchg.order);
+      auto failure =
+        llvm::AtomicCmpXchgInst::getStrongestFailureOrdering(order);
+      auto pair = b.CreateAtomicCmpXchg(addr, cmp, val, order, failure);
+      v = b.CreateExtractValue(pair, 0);
+      break;
+    }
+    case FFence:
+      v = b.CreateFence(convert_ordering(i->u.fence.order));
+      break;
+    case FUnop:
+      v = create_unop(ms, b, i->u.unop.op, get_type(i),
+        get_value(fs, i->u.unop.val));
+      break;
+    case FTernop: {
+      /* Fma is the only ternary operation */
+      auto a = get_value(fs, i->u.ternop.a);
+      auto fma = llvm::Intrinsic::getDeclaration(ms.module.get(),
+        llvm::Intrinsic::fma, {a->getType()});
+      v = b.CreateCall(fma, {a, get_value(fs, i->u.ternop.b),
+        get_value(fs, i->u.ternop.c)});
+      break;
+    }
+    case FChecked: {
+      /* The overflow flag is extracted by FOverflowed */
+      static const llvm::Intrinsic::ID ids[] = {
+        llvm::Intrinsic::sadd_with_overflow,
+        llvm::Intrinsic::uadd_with_overflow,
+        llvm::Intrinsic::ssub_with_overflow,
+        llvm::Intrinsic::usub_with_overflow,
+        llvm::Intrinsic::smul_with_overflow,
+        llvm::Intrinsic::umul_with_overflow
+      };
+      auto lhs = get_value(fs, i->u.checked.lhs);
+      auto rhs = get_value(fs, i->u.checked.rhs);
+      auto f = llvm::Intrinsic::getDeclaration(ms.module.get(),
+        ids[i->u.checked.op], {lhs->getType()});
+      v = b.CreateExtractValue(b.CreateCall(f, {lhs, rhs}), 0);
+      break;
+    }
+    case FOverflowed: {
+      auto checked = get_value(fs, i->u.overflowed.checked);
+      auto result = llvm::cast<llvm::ExtractValueInst>(checked);
+      v = b.CreateExtractValue(result->getAggregateOperand(), 1);
       break;
     }
   }
@@ -348,20 +1000,16 @@ void compile_instruction(ModuleState &ms, FunctionState &fs, FValue irvalue) {
 /* Link the phi values in the function */
 void link_phi_values(ModuleState &ms, FunctionState &fs) {
   auto f = f_get_function(ms.irmodule, fs.function);
-  vec_for(f->u.bblocks, b, {
-    auto bblock = f_get_bblock(ms.irmodule, fs.function, b);
-    vec_for(*bblock, i, {
-      auto instr = f_instr(ms.irmodule, fs.function, f_value(b, i));
-      if (instr->tag == FPhi) {
-        auto v = static_cast<llvm::PHINode*>(fs.values[b][i]);
-        vec_foreach(instr->u.phi.inc, inc, {
-          auto inc_value = fs.values[inc->value.bblock][inc->value.instr];
-          auto inc_bb = fs.bblocks[inc->bb];
-          v->addIncoming(inc_value, inc_bb);
-        });
+  for (int i = 0; i < f->u.body.ninstrs; ++i) {
+    auto instr = &f->u.body.instrs[i];
+    if (instr->tag == FPhi) {
+      auto v = static_cast<llvm::PHINode*>(fs.values[i]);
+      for (int k = 0; k < instr->u.phi.ninc; ++k) {
+        auto inc = &instr->u.phi.inc[k];
+        v->addIncoming(get_value(fs, inc->value), fs.bblocks[inc->bb]);
       }
-    });
-  });
+    }
+  }
 }
 
 /* Compile a function */
@@ -370,80 +1018,786 @@ void compile_function(ModuleState &ms, int function) {
   auto f = f_get_function(ms.irmodule, function);
   if (f->tag != FModFunc) return;
   /* Create basic the blocks */
-  fs.bblocks.reserve(vec_size(f->u.bblocks));
-  vec_for(f->u.bblocks, bb, {
+  fs.bblocks.reserve(f->u.body.nbblocks);
+  for (int bb = 0; bb < f->u.body.nbblocks; ++bb)
     fs.bblocks.push_back(
-      llvm::BasicBlock::Create(TheContext, "", ms.functions[function]));
-  });
-  /* Compile the instructions */
-  fs.values.resize(fs.bblocks.size());
-  vec_for(f->u.bblocks, b, {
-    auto bblock = f_get_bblock(ms.irmodule, function, b);
-    fs.values[b].resize(vec_size(*bblock), nullptr);
-    vec_for(*bblock, i, {
-      compile_instruction(ms, fs, f_value(b, i));
-    });
-  });
+      llvm::BasicBlock::Create(ms.context, "", get_function(ms, function)));
+  /* Compile the constants and then the instructions */
+  fs.konsts.reserve(f->u.body.nkonsts);
+  for (int k = 0; k < f->u.body.nkonsts; ++k)
+    fs.konsts.push_back(compile_konst(ms, &f->u.body.konsts[k]));
+  fs.values.resize(f->u.body.ninstrs, nullptr);
+  for (fs.bblock = 0; fs.bblock < f->u.body.nbblocks; ++fs.bblock) {
+    int i;
+    f_bblock_foreach(f, fs.bblock, i)
+      compile_instruction(ms, fs, f_value(i));
+  }
   link_phi_values(ms, fs);
 }
 
+/* Convert the optimization level to the code generation level
+ * The default level (2) keeps the aggressive code generation that f_compile
+ * always used; levels 2 and 3 only differ in the IR passes. */
+llvm::CodeGenOpt::Level convert_opt_level(int opt_level) {
+  switch (opt_level) {
+    case 0:  return llvm::CodeGenOpt::None;
+    case 1:  return llvm::CodeGenOpt::Less;
+    default: return llvm::CodeGenOpt::Aggressive;
+  }
 }
 
-void f_init_engine(FEngine *e) {
-  e->data = nullptr;
-  e->nfuncs = 0;
-  e->funcs = nullptr;
+/* Run the IR passes selected in the options over the module
+ * The functions marked as always inline are inlined even without passes. */
+void optimize_module(llvm::Module &module, llvm::TargetMachine &tm,
+    const FCompileOptions &opts) {
+  int passes = opts.passes;
+  int loop_passes = FPassLICM | FPassLoopUnroll | FPassLoopVectorize;
+  llvm::legacy::PassManager pm;
+  pm.add(new llvm::TargetLibraryInfoWrapperPass(
+    llvm::Triple(module.getTargetTriple())));
+  pm.add(llvm::createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+  pm.add(llvm::createAlwaysInlinerPass());
+  /* SROA also splits the byte arrays of the allocas before promoting them */
+  if (passes & FPassMem2Reg)
+    pm.add(llvm::createSROAPass());
+  if (passes & FPassInstCombine) {
+    pm.add(llvm::createInstructionCombiningPass());
+    pm.add(llvm::createCFGSimplificationPass());
+  }
+  if (passes & FPassInline) {
+    pm.add(llvm::createFunctionInliningPass(opts.opt_level, 0));
+    pm.add(llvm::createGlobalDCEPass());
+  }
+  if (passes & loop_passes)
+    pm.add(llvm::createLoopRotatePass());
+  if (passes & FPassLICM)
+    pm.add(llvm::createLICMPass());
+  if (passes & FPassGVN)
+    pm.add(llvm::createGVNPass());
+  if (passes & (FPassLoopUnroll | FPassLoopVectorize))
+    pm.add(llvm::createIndVarSimplifyPass());
+  if (passes & FPassLoopVectorize)
+    pm.add(llvm::createLoopVectorizePass());
+  if (passes & FPassSLPVectorize)
+    pm.add(llvm::createSLPVectorizerPass());
+  if (passes & FPassLoopUnroll)
+    pm.add(llvm::createLoopUnrollPass());
+  if (passes & FPassInstCombine) {
+    pm.add(llvm::createInstructionCombiningPass());
+    pm.add(llvm::createCFGSimplificationPass());
+  }
+  pm.run(module);
 }
 
-void f_close_engine(FEngine *e) {
-  auto data = reinterpret_cast<FEngineData *>(e->data);
-  if (data) data->ee.reset(nullptr);
-  f_init_engine(e);
+/* Link the bitcode definitions of the bound host functions into the module
+ * Only the definitions that are used are linked, and they become internal to
+ * the module, so the optimizer is free to inline them and drop the bodies.
+ * The global variables of the bitcode are only declared; they are resolved
+ * to the host ones when the code is loaded.
+ * Return false if there is an error. */
+bool link_bitcode(ModuleState &ms) {
+  for (auto buffer : ms.bitcode) {
+    auto parsed = llvm::parseBitcodeFile(buffer->getMemBufferRef(), ms.context);
+    if (!parsed) {
+      fprintf(stderr, "%s\n", parsed.getError().message().c_str());
+      return false;
+    }
+    auto bitcode = std::move(*parsed);
+    bitcode->setDataLayout(ms.module->getDataLayout());
+    bitcode->setTargetTriple(ms.module->getTargetTriple());
+    std::vector<std::string> definitions;
+    for (auto &function : *bitcode)
+      if (!function.isDeclaration() && !function.hasLocalLinkage())
+        definitions.push_back(function.getName().str());
+    for (auto &global : bitcode->globals()) {
+      if (global.isDeclaration() || global.hasLocalLinkage()) continue;
+      global.setInitializer(nullptr);
+      global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      global.setComdat(nullptr);
+    }
+    if (llvm::Linker::linkModules(*ms.module, std::move(bitcode),
+        llvm::Linker::LinkOnlyNeeded))
+      return false;
+    for (auto &name : definitions) {
+      auto function = ms.module->getFunction(name);
+      if (!function || function->isDeclaration()) continue;
+      function->setLinkage(llvm::GlobalValue::InternalLinkage);
+      function->setComdat(nullptr);
+    }
+  }
+  return true;
 }
 
-int f_compile(FEngine *e, FModule *m) {
-  /* llvm initialization */
-  static bool init = true;
-  if (init) {
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
-    init = false;
+/* Lower the functions of the partition into a new LLVM module
+ * The functions outside the partition are only declared.
+ * Return nullptr if the generated module is invalid. */
+std::unique_ptr<llvm::Module> lower_partition(llvm::LLVMContext &context,
+    FModule *m, const std::vector<int> &partition) {
+  ModuleState ms(context, m);
+  for (auto function : partition)
+    compile_function(ms, function);
+  if (!link_bitcode(ms)) {
+    fprintf(stderr, "unable to link the bitcode of the host functions\n");
+    return nullptr;
   }
-  /* Generate IR */
-  std::unique_ptr<FEngineData> data(new FEngineData());
-  ModuleState ms(*data, m);
-  vec_for(m->functions, i, declare_function(ms, i));
-  vec_for(m->functions, i, compile_function(ms, i));
-  /* Verify */
   std::string error;
   llvm::raw_string_ostream error_os(error);
   if (llvm::verifyModule(*ms.module, &error_os)) {
-    fprintf(stderr, "%s\n", error.c_str());
+    fprintf(stderr, "%s\n", error_os.str().c_str());
     ms.module->dump();
-    return 1;
+    return nullptr;
+  }
+  return std::move(ms.module);
+}
+
+/* Hash a string into the key */
+ui64 hash_string(ui64 h, const std::string &str) {
+  for (auto c : str)
+    h = f_hash_combine(h, c);
+  return h;
+}
+
+/* Combine a string into both hashes of the key */
+CacheKey combine_string(CacheKey key, const std::string &str) {
+  return CacheKey{hash_string(key.hash, str), hash_string(key.check, str)};
+}
+
+/* Hash the module with both seeds */
+CacheKey module_key(FModule *m) {
+  return CacheKey{f_hash_module(m), f_hash_module_seed(m, check_seed)};
+}
+
+/* Combine the bitcode each external function of the module is bound to
+ * The IR hash only covers the types of the external functions, but the
+ * bodies of the bound ones are inlined into the object code. */
+CacheKey combine_bindings(CacheKey key, FModule *m) {
+  for (int i = 0; i < m->nfunctions; ++i) {
+    auto f = f_get_function(m, i);
+    if (f->tag == FExtFunc)
+      key = combine_key(key, bitcode_registry().binding_key(f->u.ptr));
+  }
+  return key;
+}
+
+/* Compute the cache key of a partition
+ * Besides the IR, the object code depends on the options, the target and the
+ * bitcode of the bound functions. */
+CacheKey partition_key(FModule *m, CacheKey module_hash,
+    const std::vector<int> &partition, const FCompileOptions &opts) {
+  auto key = CacheKey{f_hash_init(), check_seed};
+  key = combine_key(key, module_hash.hash);
+  key = combine_key(key, module_hash.check);
+  key = combine_bindings(key, m);
+  key = combine_key(key, partition.size());
+  for (auto function : partition)
+    key = combine_key(key, function);
+  key = combine_key(key, opts.opt_level);
+  key = combine_key(key, opts.passes);
+  key = combine_string(key, opts.cpu);
+  key = combine_string(key, opts.features);
+  key = combine_string(key, LLVM_VERSION_STRING);
+  return combine_string(key, llvm::sys::getProcessTriple());
+}
+
+/* Header of the cached object files */
+struct ObjectHeader {
+  ui64 check;                   /* check hash of the key */
+  ui64 size;                    /* bytes of the object after the header */
+};
+
+/* Obtain the cached object path given the key */
+std::string cache_path(const std::string &dir, CacheKey key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.o", (unsigned long long)key.hash);
+  return dir + "/" + name;
+}
+
+/* Load an object from the cache, return nullptr if it isn't there
+ * Files whose header doesn't match the key and the size, or whose object
+ * can't be parsed, are treated as missing, so the object is generated again
+ * and the file is overwritten. */
+std::unique_ptr<llvm::MemoryBuffer> load_object(const std::string &dir,
+    CacheKey key) {
+  auto buffer = llvm::MemoryBuffer::getFile(cache_path(dir, key));
+  if (!buffer) return nullptr;
+  auto contents = (*buffer)->getBuffer();
+  ObjectHeader header;
+  if (contents.size() < sizeof(header)) return nullptr;
+  memcpy(&header, contents.data(), sizeof(header));
+  contents = contents.drop_front(sizeof(header));
+  if (header.check != key.check || header.size != contents.size())
+    return nullptr;
+  auto object = llvm::MemoryBuffer::getMemBufferCopy(contents);
+  auto file = llvm::object::ObjectFile::createObjectFile(
+    object->getMemBufferRef());
+  if (!file) {
+    llvm::consumeError(file.takeError());
+    return nullptr;
+  }
+  return object;
+}
+
+/* Store an object in the cache
+ * The object is written to a temporary file and then renamed, so concurrent
+ * processes never see a partial object. If the write fails, the temporary
+ * file is removed and the object just isn't cached. */
+void store_object(const std::string &dir, CacheKey key,
+    const llvm::MemoryBuffer &object) {
+  int fd;
+  llvm::SmallString<128> tmp;
+  llvm::sys::fs::create_directories(dir);
+  if (llvm::sys::fs::createUniqueFile(dir + "/%%%%%%%%.tmp", fd, tmp))
+    return;
+  ObjectHeader header{key.check, object.getBufferSize()};
+  bool failed;
+  {
+    llvm::raw_fd_ostream os(fd, true);
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os << object.getBuffer();
+    os.close();
+    failed = os.has_error();
+    os.clear_error();
+  }
+  if (failed || llvm::sys::fs::rename(tmp, cache_path(dir, key)))
+    llvm::sys::fs::remove(tmp);
+}
+
+/* Split the feature string of the options into target attributes */
+std::vector<std::string> split_features(const char *features) {
+  llvm::SmallVector<llvm::StringRef, 32> attrs;
+  llvm::StringRef(features).split(attrs, ',', -1, false);
+  std::vector<std::string> result;
+  for (auto attr : attrs)
+    result.push_back(attr.trim().str());
+  return result;
+}
+
+/* Optimize the module and generate its object code
+ * The cpu and features of the options must be already resolved.
+ * Return nullptr if there is an error. */
+std::unique_ptr<llvm::MemoryBuffer> emit_module(llvm::Module &module,
+    const FCompileOptions &opts) {
+  std::string error;
+  std::unique_ptr<llvm::TargetMachine> tm(llvm::EngineBuilder()
+    .setErrorStr(&error)
+    .setOptLevel(convert_opt_level(opts.opt_level))
+    .setMCPU(opts.cpu)
+    .setMAttrs(split_features(opts.features))
+    .selectTarget());
+  if (!tm) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return nullptr;
+  }
+  module.setDataLayout(tm->createDataLayout());
+  module.setTargetTriple(tm->getTargetTriple().str());
+  optimize_module(module, *tm, opts);
+  llvm::SmallVector<char, 0> buffer;
+  llvm::raw_svector_ostream os(buffer);
+  llvm::legacy::PassManager pm;
+  if (tm->addPassesToEmitFile(pm, os, llvm::TargetMachine::CGFT_ObjectFile)) {
+    fprintf(stderr, "unable to emit object code for the target\n");
+    return nullptr;
   }
-  /* Compile */
-  data->ee.reset(llvm::EngineBuilder(std::move(ms.module))
+  pm.run(module);
+  return llvm::MemoryBuffer::getMemBufferCopy(
+    llvm::StringRef(buffer.data(), buffer.size()));
+}
+
+/* Generate the object code of a partition
+ * This function is thread safe because it uses its own LLVM context.
+ * Return nullptr if there is an error. */
+std::unique_ptr<llvm::MemoryBuffer> emit_partition(FModule *m,
+    const std::vector<int> &partition, const FCompileOptions &opts,
+    CacheKey key) {
+  if (opts.cache_dir) {
+    auto cached = load_object(opts.cache_dir, key);
+    if (cached) return cached;
+  }
+  llvm::LLVMContext context;
+  auto module = lower_partition(context, m, partition);
+  if (!module) return nullptr;
+  auto object = emit_module(*module, opts);
+  if (object && opts.cache_dir)
+    store_object(opts.cache_dir, key, *object);
+  return object;
+}
+
+/* Count the number of instructions of a function */
+size_t count_instructions(FModule *m, int function) {
+  return f_get_function(m, function)->u.body.ninstrs;
+}
+
+/* Split the functions in up to npartitions partitions
+ * Each function goes to the partition with less instructions so far. */
+std::vector<std::vector<int>> partition_module(FModule *m,
+    const std::vector<int> &functions, int npartitions) {
+  std::vector<std::vector<int>> partitions(std::max(npartitions, 1));
+  std::vector<size_t> sizes(partitions.size(), 0);
+  for (auto function : functions) {
+    auto smallest = std::min_element(sizes.begin(), sizes.end());
+    partitions[smallest - sizes.begin()].push_back(function);
+    *smallest += count_instructions(m, function);
+  }
+  partitions.erase(std::remove_if(partitions.begin(), partitions.end(),
+    [](const std::vector<int> &p) { return p.empty(); }), partitions.end());
+  return partitions;
+}
+
+/* Compute the keys of the module functions for the function cache
+ * The key of a function covers its body and everything it can call: external
+ * functions by address and attributes, and module functions by key. Functions
+ * in mutual recursion (and their callers) can't be keyed this way, so their
+ * key is 0 and they aren't cached. */
+class FunctionKeys {
+public:
+  FunctionKeys(FModule *m_, const FCompileOptions &opts)
+    : m(m_)
+    , state(m_->nfunctions, Unvisited)
+    , in_cycle(m_->nfunctions, false)
+    , keys(m_->nfunctions, CacheKey{0, 0}) {
+    options = CacheKey{f_hash_init(), check_seed};
+    options = combine_key(options, opts.opt_level);
+    options = combine_key(options, opts.passes);
+    options = combine_string(options, opts.cpu);
+    options = combine_string(options, opts.features);
+    for (int i = 0; i < m->nfunctions; ++i)
+      if (state[i] == Unvisited && f_get_function(m, i)->tag == FModFunc)
+        visit(i);
+  }
+
+  /* Obtain the key of a function (its hash is 0 if it isn't cacheable) */
+  CacheKey operator[](int function) const {
+    return keys[function];
+  }
+
+private:
+  enum State { Unvisited, Visiting, Visited };
+
+  /* Combine the body of a function, hashed with both seeds */
+  CacheKey combine_body(CacheKey key, int function) {
+    return CacheKey{
+      f_hash_combine(key.hash, f_hash_function_body(m, function)),
+      f_hash_combine(key.check,
+        f_hash_function_body_seed(m, function, check_seed))};
+  }
+
+  void visit(int function) {
+    auto f = f_get_function(m, function);
+    auto key = combine_body(options, function);
+    bool cacheable = true;
+    state[function] = Visiting;
+    stack.push_back(function);
+    for (int i = 0; i < f->u.body.ninstrs; ++i) {
+      auto instr = &f->u.body.instrs[i];
+      if (instr->tag == FCall)
+        key = combine_callee(key, function, instr->u.call.function,
+          cacheable);
+    }
+    stack.pop_back();
+    state[function] = Visited;
+    if (cacheable && !in_cycle[function]) {
+      keys[function] = key;
+      if (!key.hash) keys[function].hash = 1;
+    }
+  }
+
+  CacheKey combine_callee(CacheKey key, int caller, int callee,
+      bool &cacheable) {
+    auto f = f_get_function(m, callee);
+    if (f->tag == FExtFunc) {
+      key = combine_key(key, reinterpret_cast<uint64_t>(f->u.ptr));
+      key = combine_key(key, bitcode_registry().binding_key(f->u.ptr));
+      return combine_body(key, callee);
+    }
+    if (callee == caller)
+      return combine_key(key, 0);
+    if (state[callee] == Visiting) {
+      auto start = std::find(stack.begin(), stack.end(), callee);
+      for (auto it = start; it != stack.end(); ++it)
+        in_cycle[*it] = true;
+      cacheable = false;
+      return key;
+    }
+    if (state[callee] == Unvisited)
+      visit(callee);
+    if (!keys[callee].hash)
+      cacheable = false;
+    key = combine_key(key, keys[callee].hash);
+    return combine_key(key, keys[callee].check);
+  }
+
+  FModule *m;
+  CacheKey options;
+  std::vector<State> state;
+  std::vector<bool> in_cycle;
+  std::vector<int> stack;
+  std::vector<CacheKey> keys;
+};
+
+/* Create the execution engine that links the code objects
+ * Return false if there is an error. */
+bool create_engine(CompiledCode &code) {
+  if (code.ee) return true;
+  std::string error;
+  std::unique_ptr<llvm::Module> empty(new llvm::Module("m", code.context));
+  code.ee.reset(llvm::EngineBuilder(std::move(empty))
     .setErrorStr(&error)
-    .setOptLevel(llvm::CodeGenOpt::Aggressive)
+    .setMCJITMemoryManager(
+      std::unique_ptr<llvm::RTDyldMemoryManager>(new MemoryManager(code)))
     .setEngineKind(llvm::EngineKind::JIT)
     .create());
-  if (!data->ee) {
+  if (!code.ee) {
     fprintf(stderr, "%s\n", error.c_str());
-    return 1;
+    return false;
+  }
+  return true;
+}
+
+/* Add an object to the execution engine (it must be finalized later)
+ * Return false if there is an error. */
+bool add_object(CompiledCode &code,
+    std::unique_ptr<llvm::MemoryBuffer> object) {
+  auto file = llvm::object::ObjectFile::createObjectFile(
+    object->getMemBufferRef());
+  if (!file) {
+    llvm::logAllUnhandledErrors(file.takeError(), llvm::errs(), "");
+    return false;
   }
-  data->ee->finalizeObject();
-  /* Get functions */
-  data->functions.resize(ms.functions.size());
-  vec_for(m->functions, i, {
-    auto f = data->ee->getPointerToFunction(ms.functions[i]);
-    data->functions[i] = reinterpret_cast<FJitFunc>(f);
+  using OwningObject = llvm::object::OwningBinary<llvm::object::ObjectFile>;
+  code.ee->addObjectFile(OwningObject(std::move(*file), std::move(object)));
+  return true;
+}
+
+/* Generate the code of the given module functions and link it
+ * The other functions must be already registered in the code symbols. If the
+ * code was already linked, the new objects are added to the same engine.
+ * Return false if there is an error. */
+bool link_functions(CompiledCode &code, FModule *m,
+    const std::vector<int> &functions, const FCompileOptions &opts) {
+  /* Generate the object code of each partition, in parallel if requested */
+  auto partitions = partition_module(m, functions, opts.nthreads);
+  std::vector<CacheKey> keys;
+  if (opts.cache_dir) {
+    auto module_hash = module_key(m);
+    for (auto &partition : partitions)
+      keys.push_back(partition_key(m, module_hash, partition, opts));
+  } else {
+    keys.resize(partitions.size(), CacheKey{0, 0});
+  }
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(partitions.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < partitions.size(); ++i)
+    threads.emplace_back([&, i] {
+      objects[i] = emit_partition(m, partitions[i], opts, keys[i]);
+    });
+  if (!partitions.empty())
+    objects[0] = emit_partition(m, partitions[0], opts, keys[0]);
+  for (auto &thread : threads)
+    thread.join();
+  for (auto &object : objects)
+    if (!object) return false;
+  /* Link the objects */
+  if (!create_engine(code))
+    return false;
+  for (auto &object : objects)
+    if (!add_object(code, std::move(object)))
+      return false;
+  code.ee->finalizeObject();
+  return true;
+}
+
+/* Abort when a lazy function can't be compiled
+ * There is no way to report the error to the caller of the function. */
+void lazy_compile_error() {
+  fprintf(stderr, "unable to compile the function on its first call\n");
+  abort();
+}
+
+/* Initialize the ORC stubs and compile callbacks of the code
+ * Return false if ORC doesn't support the host. */
+bool init_lazy(CompiledCode &code) {
+  if (code.lazy) return true;
+  llvm::Triple triple(llvm::sys::getProcessTriple());
+  auto error_handler = reinterpret_cast<uintptr_t>(lazy_compile_error);
+  std::unique_ptr<LazyFunctions> lazy(new LazyFunctions());
+  lazy->callbacks = llvm::orc::createLocalCompileCallbackManager(triple,
+    error_handler);
+  auto stubs_builder = llvm::orc::createLocalIndirectStubsManagerBuilder(
+    triple);
+  if (!lazy->callbacks || !stubs_builder)
+    return false;
+  lazy->stubs = stubs_builder();
+  code.lazy = std::move(lazy);
+  return true;
+}
+
+/* Generate the code of a lazy function and point its stub to it
+ * Called by the ORC compile callback on the first call of the function. Other
+ * threads may have called the stub before it was updated; they wait for the
+ * lock and obtain the address that was already compiled.
+ * Return the function address. */
+uint64_t compile_lazy_function(CompiledCode &code, const std::string &name,
+    const FCompileOptions &opts, CacheKey key) {
+  auto lazy = code.lazy.get();
+  std::lock_guard<std::mutex> lock(lazy->mutex);
+  auto &addr = lazy->compiled[name];
+  if (addr) return addr;
+  std::unique_ptr<llvm::MemoryBuffer> object;
+  if (opts.cache_dir)
+    object = load_object(opts.cache_dir, key);
+  if (!object) {
+    object = emit_module(*lazy->modules[name], opts);
+    if (object && opts.cache_dir)
+      store_object(opts.cache_dir, key, *object);
+  }
+  lazy->modules.erase(name);
+  if (!object || !add_object(code, std::move(object)))
+    lazy_compile_error();
+  code.ee->finalizeObject();
+  addr = code.ee->getFunctionAddress(name);
+  auto error = lazy->stubs->updatePointer(name, addr);
+  if (!addr || error) {
+    llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "");
+    lazy_compile_error();
+  }
+  return addr;
+}
+
+/* Lower the given module functions and compile them on their first call
+ * Each function gets its own LLVM module and an ORC stub that calls the
+ * compile callback until the function is compiled. The stub addresses are
+ * registered in the code symbols, so the other functions call the stubs.
+ * Return false if there is an error. */
+bool add_lazy_functions(CompiledCode &code, FModule *m,
+    const std::vector<int> &functions, const FCompileOptions &opts) {
+  if (!create_engine(code))
+    return false;
+  auto module_hash = opts.cache_dir ? module_key(m) : CacheKey{0, 0};
+  std::string cache_dir = opts.cache_dir ? opts.cache_dir : "";
+  std::string cpu = opts.cpu;
+  std::string features = opts.features;
+  std::lock_guard<std::mutex> lock(code.lazy->mutex);
+  for (auto function : functions) {
+    std::vector<int> partition{function};
+    auto module = lower_partition(code.context, m, partition);
+    if (!module)
+      return false;
+    auto key = opts.cache_dir ?
+      partition_key(m, module_hash, partition, opts) : CacheKey{0, 0};
+    auto name = function_name(function);
+    code.lazy->modules[name] = std::move(module);
+    auto callback = code.lazy->callbacks->getCompileCallback();
+    auto options = opts;
+    callback.setCompileAction([&code, name, options, cache_dir, cpu,
+        features, key]() {
+      auto o = options;
+      o.cache_dir = cache_dir.empty() ? nullptr : cache_dir.c_str();
+      o.cpu = cpu.c_str();
+      o.features = features.c_str();
+      return compile_lazy_function(code, name, o, key);
+    });
+    auto error = code.lazy->stubs->createStub(name, callback.getAddress(),
+      llvm::JITSymbolFlags::Exported);
+    if (error) {
+      llvm::logAllUnhandledErrors(std::move(error), llvm::errs(), "");
+      return false;
+    }
+    auto stub = code.lazy->stubs->findStub(name, false);
+    code.symbols[name] = stub.getAddress();
+  }
+  return true;
+}
+
+/* Obtain the name of the host CPU (eg. "skylake") */
+const std::string &host_cpu() {
+  static const std::string cpu = llvm::sys::getHostCPUName().str();
+  return cpu;
+}
+
+/* Obtain the features of the host CPU (eg. "+avx2,+popcnt,-avx512f")
+ * The string is empty if the features can't be detected. */
+const std::string &host_features() {
+  static const std::string features = [] {
+    llvm::StringMap<bool> map;
+    std::string str;
+    if (llvm::sys::getHostCPUFeatures(map)) {
+      for (auto &feature : map) {
+        if (!str.empty()) str += ",";
+        str += (feature.second ? "+" : "-") + feature.first().str();
+      }
+    }
+    return str;
+  }();
+  return features;
+}
+
+/* Initialize the llvm native target once per process */
+void llvm_initialize() {
+  static std::once_flag init;
+  std::call_once(init, [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
   });
-  /* Return */
+}
+
+/* Compile the module functions that aren't in the engine yet
+ * The previous functions are called through their addresses. The engine
+ * functions only change if the compilation succeeds; otherwise the symbols
+ * and the dependencies added to the code are removed, but the objects that
+ * were already linked stay in the execution engine until it is closed.
+ * Return a value different from 0 if there is an error. */
+int compile_new_functions(FEngineData &data, FModule *m) {
+  llvm_initialize();
+  auto &code = *data.code;
+  auto &opts = data.options;
+  auto &cache = function_cache();
+  std::unique_ptr<FunctionKeys> keys;
+  if (cache.enabled())
+    keys.reset(new FunctionKeys(m, opts));
+  /* Resolve the external functions and the cached ones
+   * The cache may return functions of this same code, which must not be a
+   * dependency of itself. */
+  int first = data.functions.size();
+  auto ndeps = code.deps.size();
+  auto rollback = [&]() {
+    for (int i = first; i < m->nfunctions; ++i)
+      code.symbols.erase(function_name(i));
+    code.deps.resize(ndeps);
+    return 1;
+  };
+  std::vector<FJitFunc> functions(m->nfunctions - first, nullptr);
+  std::vector<int> todo;
+  for (int i = first; i < m->nfunctions; ++i) {
+    auto f = f_get_function(m, i);
+    auto &function = functions[i - first];
+    if (f->tag == FExtFunc) {
+      function = f->u.ptr;
+    } else {
+      std::shared_ptr<CompiledCode> cached;
+      if (keys && (*keys)[i].hash)
+        function = cache.lookup((*keys)[i], cached);
+      if (!cached)
+        todo.push_back(i);
+      else if (cached != data.code && std::find(code.deps.begin(),
+          code.deps.end(), cached) == code.deps.end())
+        code.deps.push_back(cached);
+    }
+    if (function)
+      code.symbols[function_name(i)] = reinterpret_cast<uint64_t>(function);
+  }
+  /* Compile the remaining functions */
+  if (opts.lazy && init_lazy(code)) {
+    if (!add_lazy_functions(code, m, todo, opts))
+      return rollback();
+    for (auto i : todo) {
+      auto stub = code.symbols[function_name(i)];
+      functions[i - first] = reinterpret_cast<FJitFunc>(stub);
+    }
+    todo.clear();
+  } else if (!todo.empty() &&
+      !link_functions(code, m, todo, opts)) {
+    return rollback();
+  }
+  for (auto i : todo) {
+    auto name = function_name(i);
+    auto addr = code.ee->getFunctionAddress(name);
+    functions[i - first] = reinterpret_cast<FJitFunc>(addr);
+    code.symbols[name] = addr;
+    if (keys && (*keys)[i].hash)
+      cache.insert((*keys)[i], functions[i - first], data.code);
+  }
+  data.functions.insert(data.functions.end(), functions.begin(),
+    functions.end());
+  return 0;
+}
+
+}
+
+void f_init_compile_options(FCompileOptions *opts, int opt_level) {
+  opts->opt_level = opt_level;
+  switch (opt_level) {
+    case 0:
+      opts->passes = 0;
+      break;
+    case 1:
+      opts->passes = FPassMem2Reg | FPassInstCombine;
+      break;
+    case 2:
+      opts->passes = FPassMem2Reg | FPassInstCombine | FPassInline |
+        FPassGVN | FPassLICM | FPassSLPVectorize;
+      break;
+    default:
+      opts->passes = FPassMem2Reg | FPassInstCombine | FPassInline |
+        FPassGVN | FPassLICM | FPassLoopUnroll | FPassLoopVectorize |
+        FPassSLPVectorize;
+      break;
+  }
+  opts->nthreads = 1;
+  opts->cache_dir = nullptr;
+  opts->lazy = 0;
+  opts->cpu = nullptr;
+  opts->features = nullptr;
+}
+
+void f_set_function_cache_budget(size_t budget) {
+  function_cache().set_budget(budget);
+}
+
+void f_clear_function_cache(void) {
+  function_cache().clear();
+}
+
+void f_get_function_cache_stats(FCacheStats *stats) {
+  function_cache().stats(stats);
+}
+
+int f_add_bitcode(const void *data, size_t size) {
+  auto buffer = llvm::MemoryBuffer::getMemBufferCopy(
+    llvm::StringRef(reinterpret_cast<const char *>(data), size));
+  return !bitcode_registry().add(std::move(buffer));
+}
+
+int f_add_bitcode_file(const char *path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) return 1;
+  return !bitcode_registry().add(std::move(*buffer));
+}
+
+int f_bind_bitcode(FFunctionPtr ptr, const char *name) {
+  return !bitcode_registry().bind(ptr, name);
+}
+
+void f_llvm_close_engine(void *data) {
+  delete reinterpret_cast<FEngineData *>(data);
+}
+
+int f_llvm_compile(FEngine *e, FModule *m, const FCompileOptions *opts) {
+  std::unique_ptr<FEngineData> data(new FEngineData());
+  data->code = std::make_shared<CompiledCode>();
+  data->options = *opts;
+  if (opts->cache_dir) {
+    data->cache_dir = opts->cache_dir;
+    data->options.cache_dir = data->cache_dir.c_str();
+  }
+  data->cpu = opts->cpu ? opts->cpu : host_cpu();
+  data->features = opts->features ? opts->features : host_features();
+  data->options.cpu = data->cpu.c_str();
+  data->options.features = data->features.c_str();
+  if (compile_new_functions(*data, m))
+    return 1;
   e->funcs = data->functions.data();
   e->nfuncs = data->functions.size();
   e->data = data.release();
   return 0;
 }
 
+int f_llvm_compile_incremental(FEngine *e, FModule *m) {
+  auto data = reinterpret_cast<FEngineData *>(e->data);
+  if (compile_new_functions(*data, m))
+    return 1;
+  e->funcs = data->functions.data();
+  e->nfuncs = data->functions.size();
+  return 0;
+}
+
@@ -0,0 +1,1318 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* mmap's MAP_ANONYMOUS isn't part of POSIX.1-2001 */
+#define _DEFAULT_SOURCE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fahrenheit/backend.h>
+#include <fahrenheit/ir.h>
+
+#include "cfg.h"
+#include "engine.h"
+#include "eval.h"
+
+#if F_X64_SUPPORTED
+
+#include <sys/mman.h>
+
+/* Single-pass x86-64 code generator
+ * The instructions load their operands into scratch registers (rax, rcx,
+ * rdx, xmm0, xmm1) and store the result back. Integer and pointer values that
+ * are only used in their own block live in the callee-saved registers (rbx,
+ * r12 to r15), which are assigned by a linear scan over each block (see
+ * allocate_registers); the other values live in stack slots of the frame.
+ * Integer values are kept zero extended. Phi values have a second slot that
+ * is written by the predecessors and copied by the phi instruction, so all
+ * phis of a block read the old values. */
+
+/* Registers */
+enum {
+  RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+  R8 = 8, R9 = 9, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+/* Argument registers of the SysV ABI */
+static const int int_args[] = {RDI, RSI, RDX, RCX, R8, R9};
+#define NINTARGS 6
+#define NFLOATARGS 8
+
+/* Registers that hold values, saved by the prologue of the functions that
+ * use them */
+static const int value_regs[] = {RBX, R12, R13, R14, R15};
+#define NVALUEREGS 5
+
+/* Machine code buffer */
+typedef struct Buffer {
+  ui8 *data;
+  size_t size;
+  size_t capacity;
+} Buffer;
+
+/* Position of a rel32 operand that must be patched */
+typedef struct Fixup {
+  size_t pos;
+  int target;
+} Fixup;
+
+VEC_DECLARE(Fixup);
+
+/* Executable memory of an incremental compilation */
+typedef struct Chunk {
+  void *mem;
+  size_t size;
+} Chunk;
+
+VEC_DECLARE(Chunk);
+
+/* Engine exported */
+typedef struct X64Engine {
+  Vector(Chunk) chunks;
+  FJitFunc *funcs;
+  int nfuncs;
+  ui64 *counters;           /* see f_x64_compile_instrumented */
+  FJitFunc *table;
+} X64Engine;
+
+/* Compile state of a chunk */
+typedef struct X64State {
+  FModule *m;
+  FJitFunc *funcs;          /* functions compiled by previous chunks */
+  int first;                /* first function of the chunk */
+  Buffer code;
+  size_t *fstart;           /* offset of each function of the chunk */
+  Vector(Fixup) calls;      /* calls to functions of the chunk */
+  ui64 *counters;           /* calls and back edges of each function */
+  FJitFunc *table;          /* table used to call the module functions */
+  int function;             /* function being compiled */
+  int bblock;               /* block being compiled */
+  int nvalues;              /* number of values of the function */
+  int nkonsts;              /* number of constants of the function */
+  int *reg;                 /* register of each value (-1 if in its slot) */
+  int saved;                /* value registers used by the function */
+  size_t *bbstart;          /* offset of each block */
+  int *backedge;            /* back edge flags of the block successors */
+  Vector(Fixup) jumps;      /* jumps to blocks */
+} X64State;
+
+/* Emit a byte */
+static void emit(Buffer *b, int byte) {
+  if (b->size == b->capacity) {
+    size_t capacity = b->capacity ? 2 * b->capacity : 1024;
+    b->data = mem_alloc(b->data, b->capacity, capacity);
+    b->capacity = capacity;
+  }
+  b->data[b->size++] = (ui8)byte;
+}
+
+/* Emit n bytes */
+static void emitn(Buffer *b, int n, ...) {
+  int i;
+  va_list bytes;
+  va_start(bytes, n);
+  for (i = 0; i < n; ++i)
+    emit(b, va_arg(bytes, int));
+  va_end(bytes);
+}
+
+/* Emit a 32 bits little endian integer */
+static void emit32(Buffer *b, ui32 value) {
+  int i;
+  for (i = 0; i < 4; ++i)
+    emit(b, (value >> (8 * i)) & 0xff);
+}
+
+/* Emit a 64 bits little endian integer */
+static void emit64(Buffer *b, ui64 value) {
+  emit32(b, (ui32)value);
+  emit32(b, (ui32)(value >> 32));
+}
+
+/* Overwrite a 32 bits integer */
+static void patch32(Buffer *b, size_t pos, ui32 value) {
+  int i;
+  for (i = 0; i < 4; ++i)
+    b->data[pos + i] = (value >> (8 * i)) & 0xff;
+}
+
+/* Patch the rel32 operand at pos so it points to target */
+static void patch_rel32(Buffer *b, size_t pos, size_t target) {
+  patch32(b, pos, (ui32)(target - (pos + 4)));
+}
+
+/* Emit the ModRM and the displacement of [rbp + disp] */
+static void emit_frame(Buffer *b, int reg, int disp) {
+  emit(b, 0x85 | ((reg & 7) << 3));
+  emit32(b, (ui32)disp);
+}
+
+/* mov reg, [rbp + disp] */
+static void load_int(Buffer *b, int reg, int disp) {
+  emitn(b, 2, 0x48 | (reg >= 8 ? 4 : 0), 0x8b);
+  emit_frame(b, reg, disp);
+}
+
+/* mov [rbp + disp], reg */
+static void store_int(Buffer *b, int reg, int disp) {
+  emitn(b, 2, 0x48 | (reg >= 8 ? 4 : 0), 0x89);
+  emit_frame(b, reg, disp);
+}
+
+/* mov dst, src */
+static void move_int(Buffer *b, int dst, int src) {
+  if (dst != src)
+    emitn(b, 3, 0x48 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0), 0x89,
+      0xc0 | (src & 7) << 3 | (dst & 7));
+}
+
+/* movss/movsd xmm, [rbp + disp] */
+static void load_float(Buffer *b, enum FType type, int xmm, int disp) {
+  emitn(b, 3, type == FFloat ? 0xf3 : 0xf2, 0x0f, 0x10);
+  emit_frame(b, xmm, disp);
+}
+
+/* movss/movsd [rbp + disp], xmm */
+static void store_float(Buffer *b, enum FType type, int xmm, int disp) {
+  emitn(b, 3, type == FFloat ? 0xf3 : 0xf2, 0x0f, 0x11);
+  emit_frame(b, xmm, disp);
+}
+
+/* Zero extend the register (rax, rcx or rdx) given the value type */
+static void zero_extend(Buffer *b, int r, enum FType type) {
+  switch (type) {
+    case FBool:
+      emitn(b, 3, 0x83, 0xe0 | r, 0x01);
+      break;
+    case FInt8:
+      emitn(b, 3, 0x0f, 0xb6, 0xc0 | r << 3 | r);
+      break;
+    case FInt16:
+      emitn(b, 3, 0x0f, 0xb7, 0xc0 | r << 3 | r);
+      break;
+    case FInt32:
+      emitn(b, 2, 0x89, 0xc0 | r << 3 | r);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Sign extend the register (rax, rcx or rdx) given the value type */
+static void sign_extend(Buffer *b, int r, enum FType type) {
+  switch (type) {
+    case FBool:
+      zero_extend(b, r, FBool);
+      emitn(b, 3, 0x48, 0xf7, 0xd8 | r);
+      break;
+    case FInt8:
+      emitn(b, 4, 0x48, 0x0f, 0xbe, 0xc0 | r << 3 | r);
+      break;
+    case FInt16:
+      emitn(b, 4, 0x48, 0x0f, 0xbf, 0xc0 | r << 3 | r);
+      break;
+    case FInt32:
+      emitn(b, 3, 0x48, 0x63, 0xc0 | r << 3 | r);
+      break;
+    default:
+      break;
+  }
+}
+
+/* Truncate a constant to the type width */
+static ui64 truncate_int(ui64 value, enum FType type) {
+  switch (type) {
+    case FBool:  return value != 0;
+    case FInt8:  return value & 0xff;
+    case FInt16: return value & 0xffff;
+    case FInt32: return value & 0xffffffff;
+    default:     return value;
+  }
+}
+
+/* Obtain the frame displacement of a slot */
+static int slot(int index) {
+  return -8 * (index + 1);
+}
+
+/* Obtain the slot of a value */
+static int value_slot(X64State *s, FValue v) {
+  if (f_is_konst(v))
+    return slot(f_konst_index(v));
+  return slot(s->nkonsts + v.id);
+}
+
+/* Obtain the slot written by the predecessors of a phi */
+static int phi_slot(X64State *s, FValue v) {
+  return slot(s->nkonsts + s->nvalues + v.id);
+}
+
+/* Obtain the slot of an argument */
+static int arg_slot(X64State *s, int n) {
+  return slot(s->nkonsts + 2 * s->nvalues + n);
+}
+
+/* Obtain the slot that saves the value register n */
+static int saved_slot(X64State *s, int n) {
+  FFunction *f = f_get_function(s->m, s->function);
+  return arg_slot(s, f_get_ftype(s->m, f->type)->nargs + n);
+}
+
+/* Obtain the type of a value */
+static enum FType value_type(X64State *s, FValue v) {
+  return f_instr(s->m, s->function, v)->type;
+}
+
+/* Load a value into an integer register */
+static void load_value(X64State *s, int reg, FValue v) {
+  if (!f_is_konst(v) && s->reg[v.id] >= 0)
+    move_int(&s->code, reg, s->reg[v.id]);
+  else
+    load_int(&s->code, reg, value_slot(s, v));
+}
+
+/* Store an integer register into a value */
+static void store_value(X64State *s, int reg, FValue v) {
+  if (s->reg[v.id] >= 0)
+    move_int(&s->code, s->reg[v.id], reg);
+  else
+    store_int(&s->code, reg, value_slot(s, v));
+}
+
+/* Check if values of the type can be kept in the value registers */
+static int allocatable(enum FType type) {
+  return type != FVoid && !f_is_float(type) && !f_is_vec(type);
+}
+
+/* Record a use of the value by the block at the given position
+ * Values used by other blocks are marked with -2 (see allocate_registers). */
+static void record_use(int *block, int *last, FValue v, int bb, int pos) {
+  if (f_null(v) || f_is_konst(v) || last[v.id] == -2)
+    return;
+  if (block[v.id] != bb)
+    last[v.id] = -2;
+  else if (pos > last[v.id])
+    last[v.id] = pos;
+}
+
+/* Assign the value registers
+ * The instructions are numbered in the block order. A value that is only used
+ * by its block holds a register from its definition to its last use, which
+ * can be reused by the value defined by that last use. Incoming values of the
+ * phis are used by the terminator of the predecessor, and the overflowed
+ * instructions also use the operands of the checked one. */
+static void allocate_registers(X64State *s) {
+  FFunction *f = f_get_function(s->m, s->function);
+  int nblocks = f->u.body.nbblocks;
+  int *pos = mem_newarray(int, s->nvalues);
+  int *block = mem_newarray(int, s->nvalues);
+  int *last = mem_newarray(int, s->nvalues);
+  int *end = mem_newarray(int, nblocks);
+  int owner[NVALUEREGS];
+  int bb, i, k, p = 0;
+  for (i = 0; i < s->nvalues; ++i) {
+    block[i] = -1;
+    last[i] = -1;
+    s->reg[i] = -1;
+  }
+  for (bb = 0; bb < nblocks; ++bb) {
+    f_bblock_foreach(f, bb, i) {
+      pos[i] = p++;
+      block[i] = bb;
+    }
+    end[bb] = p - 1;
+  }
+  for (bb = 0; bb < nblocks; ++bb) {
+    f_bblock_foreach(f, bb, i) {
+      FInstr *instr = &f->u.body.instrs[i];
+      FValue *operand;
+      if (instr->tag == FPhi) {
+        for (k = 0; k < instr->u.phi.ninc; ++k) {
+          FPhiInc *inc = &instr->u.phi.inc[k];
+          record_use(block, last, inc->value, inc->bb, end[inc->bb]);
+        }
+        continue;
+      }
+      for (k = 0; (operand = f_operand(instr, k)) != NULL; ++k)
+        record_use(block, last, *operand, bb, pos[i]);
+      if (instr->tag == FOverflowed) {
+        FInstr *checked = f_instr(s->m, s->function,
+          instr->u.overflowed.checked);
+        record_use(block, last, checked->u.checked.lhs, bb, pos[i]);
+        record_use(block, last, checked->u.checked.rhs, bb, pos[i]);
+      }
+    }
+  }
+  s->saved = 0;
+  for (bb = 0; bb < nblocks; ++bb) {
+    for (k = 0; k < NVALUEREGS; ++k)
+      owner[k] = -1;
+    f_bblock_foreach(f, bb, i) {
+      for (k = 0; k < NVALUEREGS; ++k)
+        if (owner[k] >= 0 && last[owner[k]] <= pos[i])
+          owner[k] = -1;
+      if (last[i] == -2 || !allocatable(f->u.body.instrs[i].type))
+        continue;
+      for (k = 0; k < NVALUEREGS && owner[k] >= 0; ++k)
+        continue;
+      if (k < NVALUEREGS) {
+        owner[k] = i;
+        s->reg[i] = value_regs[k];
+        s->saved |= 1 << k;
+      }
+    }
+  }
+  mem_deletearray(pos, s->nvalues);
+  mem_deletearray(block, s->nvalues);
+  mem_deletearray(last, s->nvalues);
+  mem_deletearray(end, nblocks);
+}
+
+/* Increment a counter: mov r11, imm64; inc qword [r11] */
+static void emit_counter(Buffer *b, ui64 *counter) {
+  emitn(b, 2, 0x49, 0xbb);
+  emit64(b, (ui64)(size_t)counter);
+  emitn(b, 3, 0x49, 0xff, 0x03);
+}
+
+/* Emit a jump to the successor n of the current block
+ * Loop back edges (see f_find_backedges) are counted. */
+static void emit_jump(X64State *s, int bblock, int n) {
+  Fixup fixup;
+  if (s->counters && (s->backedge[s->bblock] & (1 << n)))
+    emit_counter(&s->code, &s->counters[2 * s->function + 1]);
+  emit(&s->code, 0xe9);
+  fixup.pos = s->code.size;
+  fixup.target = bblock;
+  vec_push(s->jumps, fixup);
+  emit32(&s->code, 0);
+}
+
+/* Copy the incoming values of the phis in the edge from -> to */
+static void emit_phi_moves(X64State *s, int from, int to) {
+  FFunction *f = f_get_function(s->m, s->function);
+  int i, k;
+  f_bblock_foreach(f, to, i) {
+    FInstr *phi = &f->u.body.instrs[i];
+    if (phi->tag == FPhi) {
+      for (k = 0; k < phi->u.phi.ninc; ++k) {
+        FPhiInc *inc = &phi->u.phi.inc[k];
+        if (inc->bb == from) {
+          load_value(s, RAX, inc->value);
+          store_int(&s->code, RAX, phi_slot(s, f_value(i)));
+        }
+      }
+    }
+  }
+}
+
+/* Compile a cast, the result is left in rax or xmm0 */
+static void compile_cast(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  enum FType from = value_type(s, i->u.cast.val);
+  enum FType to = i->type;
+  int prefix;
+  size_t pos, done;
+  switch (i->u.cast.op) {
+    case FUIntCast:
+    case FSIntCast:
+      load_value(s, RAX, i->u.cast.val);
+      if (i->u.cast.op == FSIntCast)
+        sign_extend(b, RAX, from);
+      zero_extend(b, RAX, to);
+      break;
+    case FFloatCast:
+      load_float(b, from, 0, value_slot(s, i->u.cast.val));
+      if (from != to)
+        emitn(b, 4, from == FFloat ? 0xf3 : 0xf2, 0x0f, 0x5a, 0xc0);
+      break;
+    case FFloatToUInt:
+    case FFloatToSInt:
+      load_float(b, from, 0, value_slot(s, i->u.cast.val));
+      if (i->u.cast.op == FFloatToSInt || to != FInt64) {
+        /* cvttss2si/cvttsd2si rax, xmm0 */
+        emitn(b, 5, from == FFloat ? 0xf3 : 0xf2, 0x48, 0x0f, 0x2c, 0xc0);
+      } else {
+        /* Values above 2^63 are converted after subtracting 2^63 */
+        if (from == FFloat)
+          emitn(b, 4, 0xf3, 0x0f, 0x5a, 0xc0);
+        emitn(b, 2, 0x48, 0xb8);
+        emit64(b, (ui64)0x43e00000 << 32);
+        emitn(b, 5, 0x66, 0x48, 0x0f, 0x6e, 0xc8);
+        emitn(b, 4, 0x66, 0x0f, 0x2e, 0xc1);
+        emitn(b, 2, 0x73, 0);
+        pos = b->size;
+        emitn(b, 5, 0xf2, 0x48, 0x0f, 0x2c, 0xc0);
+        emitn(b, 2, 0xeb, 0);
+        done = b->size;
+        b->data[pos - 1] = (ui8)(b->size - pos);
+        emitn(b, 4, 0xf2, 0x0f, 0x5c, 0xc1);
+        emitn(b, 5, 0xf2, 0x48, 0x0f, 0x2c, 0xc0);
+        emitn(b, 5, 0x48, 0x0f, 0xba, 0xf8, 0x3f);
+        b->data[done - 1] = (ui8)(b->size - done);
+      }
+      zero_extend(b, RAX, to);
+      break;
+    case FUIntToFloat:
+    case FSIntToFloat:
+      prefix = to == FFloat ? 0xf3 : 0xf2;
+      load_value(s, RAX, i->u.cast.val);
+      if (i->u.cast.op == FSIntToFloat)
+        sign_extend(b, RAX, from);
+      if (i->u.cast.op == FSIntToFloat || from != FInt64) {
+        /* cvtsi2ss/cvtsi2sd xmm0, rax */
+        emitn(b, 5, prefix, 0x48, 0x0f, 0x2a, 0xc0);
+      } else {
+        /* Values above 2^63 are halved (keeping the rounding bit) */
+        emitn(b, 3, 0x48, 0x85, 0xc0);
+        emitn(b, 2, 0x78, 0);
+        pos = b->size;
+        emitn(b, 5, prefix, 0x48, 0x0f, 0x2a, 0xc0);
+        emitn(b, 2, 0xeb, 0);
+        done = b->size;
+        b->data[pos - 1] = (ui8)(b->size - pos);
+        emitn(b, 3, 0x48, 0x89, 0xc1);
+        emitn(b, 3, 0x48, 0xd1, 0xe9);
+        emitn(b, 3, 0x83, 0xe0, 0x01);
+        emitn(b, 3, 0x48, 0x09, 0xc1);
+        emitn(b, 5, prefix, 0x48, 0x0f, 0x2a, 0xc1);
+        emitn(b, 4, prefix, 0x0f, 0x58, 0xc0);
+        b->data[done - 1] = (ui8)(b->size - done);
+      }
+      break;
+  }
+}
+
+/* Call an evaluation function (see eval.h), the result is left in rax and
+ * xmm0 */
+static void compile_eval(X64State *s, ui64 func, int op, enum FType type,
+    int nargs, const FValue *args) {
+  Buffer *b = &s->code;
+  int a;
+  /* mov edi, op; mov esi, type */
+  emit(b, 0xbf);
+  emit32(b, (ui32)op);
+  emit(b, 0xbe);
+  emit32(b, (ui32)type);
+  for (a = 0; a < nargs; ++a)
+    load_value(s, int_args[2 + a], args[a]);
+  emitn(b, 2, 0x49, 0xbb);
+  emit64(b, func);
+  emitn(b, 3, 0x41, 0xff, 0xd3);
+  /* movq xmm0, rax */
+  emitn(b, 5, 0x66, 0x48, 0x0f, 0x6e, 0xc0);
+}
+
+/* Compile a binary operation, the result is left in rax or xmm0 */
+static void compile_binop(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  enum FType type = i->type;
+  if (i->u.binop.op >= FMin && i->u.binop.op <= FRotr) {
+    FValue args[2];
+    args[0] = i->u.binop.lhs;
+    args[1] = i->u.binop.rhs;
+    compile_eval(s, (ui64)(size_t)f_eval_binop, i->u.binop.op, type, 2,
+      args);
+    return;
+  }
+  if (f_is_float(type)) {
+    int op = 0x58;
+    switch (i->u.binop.op) {
+      case FSub: op = 0x5c; break;
+      case FMul: op = 0x59; break;
+      case FDiv: op = 0x5e; break;
+      default: break;
+    }
+    load_float(b, type, 0, value_slot(s, i->u.binop.lhs));
+    load_float(b, type, 1, value_slot(s, i->u.binop.rhs));
+    emitn(b, 4, type == FFloat ? 0xf3 : 0xf2, 0x0f, op, 0xc1);
+    return;
+  }
+  load_value(s, RAX, i->u.binop.lhs);
+  load_value(s, RCX, i->u.binop.rhs);
+  switch (i->u.binop.op) {
+    case FAdd: emitn(b, 3, 0x48, 0x01, 0xc8); break;
+    case FSub: emitn(b, 3, 0x48, 0x29, 0xc8); break;
+    case FMul: emitn(b, 4, 0x48, 0x0f, 0xaf, 0xc1); break;
+    case FDiv:
+      sign_extend(b, RAX, type);
+      sign_extend(b, RCX, type);
+      emitn(b, 2, 0x48, 0x99);
+      emitn(b, 3, 0x48, 0xf7, 0xf9);
+      break;
+    case FRem:
+      emitn(b, 2, 0x31, 0xd2);
+      emitn(b, 3, 0x48, 0xf7, 0xf1);
+      emitn(b, 3, 0x48, 0x89, 0xd0);
+      break;
+    case FUDiv:
+      emitn(b, 2, 0x31, 0xd2);
+      emitn(b, 3, 0x48, 0xf7, 0xf1);
+      break;
+    case FSRem:
+      sign_extend(b, RAX, type);
+      sign_extend(b, RCX, type);
+      emitn(b, 2, 0x48, 0x99);
+      emitn(b, 3, 0x48, 0xf7, 0xf9);
+      emitn(b, 3, 0x48, 0x89, 0xd0);
+      break;
+    case FShl: emitn(b, 3, 0x48, 0xd3, 0xe0); break;
+    case FShr: emitn(b, 3, 0x48, 0xd3, 0xe8); break;
+    case FAShr:
+      sign_extend(b, RAX, type);
+      emitn(b, 3, 0x48, 0xd3, 0xf8);
+      break;
+    case FAnd: emitn(b, 3, 0x48, 0x21, 0xc8); break;
+    case FOr:  emitn(b, 3, 0x48, 0x09, 0xc8); break;
+    case FXor: emitn(b, 3, 0x48, 0x31, 0xc8); break;
+    default: break;
+  }
+  zero_extend(b, RAX, type);
+}
+
+/* Compile a checked operation, the wrapped result is left in rax */
+static void compile_checked(X64State *s, FInstr *i) {
+  static const enum FBinopTag ops[] = {FAdd, FAdd, FSub, FSub, FMul, FMul};
+  FInstr binop;
+  binop.type = i->type;
+  binop.tag = FBinop;
+  binop.u.binop.op = ops[i->u.checked.op];
+  binop.u.binop.lhs = i->u.checked.lhs;
+  binop.u.binop.rhs = i->u.checked.rhs;
+  compile_binop(s, &binop);
+}
+
+/* Compile an integer comparison, the result is left in rax */
+static void compile_intcmp(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  enum FType type = value_type(s, i->u.intcmp.lhs);
+  int cc = 0x94;
+  load_value(s, RAX, i->u.intcmp.lhs);
+  load_value(s, RCX, i->u.intcmp.rhs);
+  switch (i->u.intcmp.op) {
+    case FIntEq:  cc = 0x94; break;
+    case FIntNe:  cc = 0x95; break;
+    case FIntSLe: cc = 0x9e; break;
+    case FIntSLt: cc = 0x9c; break;
+    case FIntSGe: cc = 0x9d; break;
+    case FIntSGt: cc = 0x9f; break;
+    case FIntULe: cc = 0x96; break;
+    case FIntULt: cc = 0x92; break;
+    case FIntUGe: cc = 0x93; break;
+    case FIntUGt: cc = 0x97; break;
+  }
+  if (cc == 0x9c || cc == 0x9d || cc == 0x9e || cc == 0x9f) {
+    sign_extend(b, RAX, type);
+    sign_extend(b, RCX, type);
+  }
+  emitn(b, 3, 0x48, 0x39, 0xc8);
+  emitn(b, 3, 0x0f, cc, 0xc0);
+  zero_extend(b, RAX, FInt8);
+}
+
+/* Compile a float point comparison, the result is left in rax
+ * After ucomiss/ucomisd, an unordered result sets ZF, PF and CF. The less
+ * than comparisons swap the operands so they can use the above conditions. */
+static void compile_fpcmp(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  enum FType type = value_type(s, i->u.fpcmp.lhs);
+  int swap = 0, cc = 0x94, extra = 0, combine = 0;
+  load_float(b, type, 0, value_slot(s, i->u.fpcmp.lhs));
+  load_float(b, type, 1, value_slot(s, i->u.fpcmp.rhs));
+  switch (i->u.fpcmp.op) {
+    case FFpOEq: cc = 0x94; extra = 0x9b; combine = 0x20; break;
+    case FFpONe: cc = 0x95; break;
+    case FFpOLe: cc = 0x93; swap = 1; break;
+    case FFpOLt: cc = 0x97; swap = 1; break;
+    case FFpOGe: cc = 0x93; break;
+    case FFpOGt: cc = 0x97; break;
+    case FFpUEq: cc = 0x94; break;
+    case FFpUNe: cc = 0x95; extra = 0x9a; combine = 0x08; break;
+    case FFpULe: cc = 0x96; break;
+    case FFpULt: cc = 0x92; break;
+    case FFpUGe: cc = 0x96; swap = 1; break;
+    case FFpUGt: cc = 0x92; swap = 1; break;
+  }
+  if (type == FDouble)
+    emit(b, 0x66);
+  emitn(b, 3, 0x0f, 0x2e, swap ? 0xc8 : 0xc1);
+  emitn(b, 3, 0x0f, cc, 0xc0);
+  if (extra) {
+    emitn(b, 3, 0x0f, extra, 0xc1);
+    emitn(b, 2, combine, 0xc8);
+  }
+  zero_extend(b, RAX, FInt8);
+}
+
+/* Compile a call, the result is stored in the value slot */
+static void compile_call(X64State *s, FValue v, FInstr *i) {
+  Buffer *b = &s->code;
+  int callee = i->u.call.function;
+  FFunction *f = f_get_function(s->m, callee);
+  FFunctionType *ftype = f_get_ftype(s->m, f->type);
+  int a, nint = 0, nfloat = 0, nstack = 0, area;
+  /* Reserve the stack arguments area (keeping the stack aligned) */
+  for (a = 0; a < i->u.call.nargs; ++a) {
+    if (f_is_float(value_type(s, i->u.call.args[a]))) {
+      if (nfloat < NFLOATARGS) nfloat++;
+      else nstack++;
+    } else {
+      if (nint < NINTARGS) nint++;
+      else nstack++;
+    }
+  }
+  area = (8 * nstack + 15) & ~15;
+  if (area) {
+    emitn(b, 3, 0x48, 0x81, 0xec);
+    emit32(b, area);
+  }
+  /* Move the arguments, rax is only used for the stack ones */
+  nint = nfloat = nstack = 0;
+  for (a = 0; a < i->u.call.nargs; ++a) {
+    FValue arg = i->u.call.args[a];
+    enum FType type = value_type(s, arg);
+    if (f_is_float(type) && nfloat < NFLOATARGS) {
+      load_float(b, type, nfloat++, value_slot(s, arg));
+    } else if (!f_is_float(type) && nint < NINTARGS) {
+      load_value(s, int_args[nint++], arg);
+    } else {
+      load_value(s, RAX, arg);
+      emitn(b, 4, 0x48, 0x89, 0x84, 0x24);
+      emit32(b, 8 * nstack++);
+    }
+  }
+  if (ftype->vararg) {
+    emit(b, 0xb8);
+    emit32(b, nfloat);
+  }
+  /* Call the function */
+  if (f->tag == FModFunc && s->table) {
+    /* mov r11, &table[callee]; call [r11] */
+    emitn(b, 2, 0x49, 0xbb);
+    emit64(b, (ui64)(size_t)&s->table[callee]);
+    emitn(b, 3, 0x41, 0xff, 0x13);
+  } else if (f->tag == FModFunc && callee >= s->first) {
+    Fixup fixup;
+    emit(b, 0xe8);
+    fixup.pos = b->size;
+    fixup.target = callee;
+    vec_push(s->calls, fixup);
+    emit32(b, 0);
+  } else {
+    FJitFunc ptr = f->tag == FExtFunc ? f->u.ptr : s->funcs[callee];
+    emitn(b, 2, 0x49, 0xbb);
+    emit64(b, (ui64)(size_t)ptr);
+    emitn(b, 3, 0x41, 0xff, 0xd3);
+  }
+  if (area) {
+    emitn(b, 3, 0x48, 0x81, 0xc4);
+    emit32(b, area);
+  }
+  /* Store the result */
+  if (f_is_float(ftype->ret)) {
+    store_float(b, ftype->ret, 0, value_slot(s, v));
+  } else if (ftype->ret != FVoid) {
+    zero_extend(b, RAX, ftype->ret);
+    store_value(s, RAX, v);
+  }
+}
+
+/* Compile a memcpy, memmove or memset as a call to the libc function */
+static void compile_memcall(X64State *s, FValue dst, FValue src, FValue size,
+    ui64 ptr) {
+  Buffer *b = &s->code;
+  load_value(s, RDI, dst);
+  load_value(s, RSI, src);
+  load_value(s, RDX, size);
+  emitn(b, 2, 0x49, 0xbb);
+  emit64(b, ptr);
+  emitn(b, 3, 0x41, 0xff, 0xd3);
+}
+
+/* Compile a prefetch: prefetchw or prefetch{nta,t2,t1,t0} [rax] */
+static void compile_prefetch(X64State *s, FInstr *i) {
+  static const int hints[] = {0x00, 0x18, 0x10, 0x08};
+  Buffer *b = &s->code;
+  load_value(s, RAX, i->u.prefetch.addr);
+  if (i->u.prefetch.write)
+    emitn(b, 3, 0x0f, 0x0d, 0x08);
+  else
+    emitn(b, 3, 0x0f, 0x18, hints[i->u.prefetch.locality]);
+}
+
+/* Compile an alloca by moving rsp down, the address is left in rax
+ * Sizes are rounded up to 16 bytes to keep the stack aligned for calls; the
+ * frame is released by the leave of the epilogue. */
+static void compile_alloca(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  if (f_null(i->u.alloca.dynsize)) {
+    /* sub rsp, size */
+    emitn(b, 3, 0x48, 0x81, 0xec);
+    emit32(b, (ui32)((i->u.alloca.size + 15) & ~15));
+  } else {
+    /* add rax, 15; and rax, -16; sub rsp, rax */
+    load_value(s, RAX, i->u.alloca.dynsize);
+    emitn(b, 4, 0x48, 0x83, 0xc0, 0x0f);
+    emitn(b, 4, 0x48, 0x83, 0xe0, 0xf0);
+    emitn(b, 3, 0x48, 0x29, 0xc4);
+  }
+  if (i->u.alloca.align > 16) {
+    /* and rsp, -align */
+    emitn(b, 3, 0x48, 0x81, 0xe4);
+    emit32(b, (ui32)-i->u.alloca.align);
+  }
+  /* mov rax, rsp */
+  emitn(b, 3, 0x48, 0x89, 0xe0);
+}
+
+/* Emit a locked instruction over [rcx] with the operand size of the type
+ * The 8 bits forms use the opcode - 1; the REX prefix selects sil over dh. */
+static void emit_locked(Buffer *b, enum FType type, int twobyte, int opcode,
+    int modrm) {
+  emit(b, 0xf0);
+  if (type == FInt16)
+    emit(b, 0x66);
+  if (type == FInt64 || type == FPointer)
+    emit(b, 0x48);
+  else if (type == FInt8)
+    emit(b, 0x40);
+  if (twobyte)
+    emit(b, 0x0f);
+  emitn(b, 2, type == FInt8 ? opcode - 1 : opcode, modrm);
+}
+
+/* Compile an atomic operation, the old value is left in rax
+ * The operations without a x86 instruction use a cmpxchg loop. */
+static void compile_atomic(X64State *s, FInstr *i) {
+  Buffer *b = &s->code;
+  enum FType type = i->type;
+  enum FAtomicTag op = i->u.atomic.op;
+  size_t loop;
+  load_value(s, RCX, i->u.atomic.addr);
+  load_value(s, RAX, i->u.atomic.val);
+  switch (op) {
+    case FAtomicXchg:
+      /* xchg [rcx], rax */
+      emit_locked(b, type, 0, 0x87, 0x01);
+      return;
+    case FAtomicSub:
+      /* neg rax */
+      emitn(b, 3, 0x48, 0xf7, 0xd8);
+      /* fall through */
+    case FAtomicAdd:
+      /* lock xadd [rcx], rax */
+      emit_locked(b, type, 1, 0xc1, 0x01);
+      return;
+    default:
+      break;
+  }
+  /* mov rdx, rax; movzx rax, [rcx] */
+  emitn(b, 3, 0x48, 0x89, 0xc2);
+  switch (type) {
+    case FInt8: emitn(b, 3, 0x0f, 0xb6, 0x01); break;
+    case FInt16: emitn(b, 3, 0x0f, 0xb7, 0x01); break;
+    case FInt32: emitn(b, 2, 0x8b, 0x01); break;
+    default: emitn(b, 3, 0x48, 0x8b, 0x01); break;
+  }
+  if (op == FAtomicMin || op == FAtomicMax)
+    sign_extend(b, RDX, type);
+  loop = b->size;
+  if (op == FAtomicMin || op == FAtomicMax)
+    sign_extend(b, RAX, type);
+  /* mov rsi, rax; rsi = op(rsi, rdx) */
+  emitn(b, 3, 0x48, 0x89, 0xc6);
+  switch (op) {
+    case FAtomicAnd: emitn(b, 3, 0x48, 0x21, 0xd6); break;
+    case FAtomicOr: emitn(b, 3, 0x48, 0x09, 0xd6); break;
+    case FAtomicXor: emitn(b, 3, 0x48, 0x31, 0xd6); break;
+    default: {
+      int cc = 0;
+      switch (op) {
+        case FAtomicMin: cc = 0x4f; break;  /* cmovg */
+        case FAtomicMax: cc = 0x4c; break;  /* cmovl */
+        case FAtomicUMin: cc = 0x47; break; /* cmova */
+        default: cc = 0x42; break;          /* cmovb */
+      }
+      /* cmp rsi, rdx; cmovcc rsi, rdx */
+      emitn(b, 7, 0x48, 0x39, 0xd6, 0x48, 0x0f, cc, 0xf2);
+      break;
+    }
+  }
+  /* lock cmpxchg [rcx], rsi; jne loop */
+  emit_locked(b, type, 1, 0xb1, 0x31);
+  emitn(b, 2, 0x75, (int)(loop - (b->size + 2)) & 0xff);
+}
+
+/* Store a constant of the pool in its slot */
+static void compile_konst(X64State *s, int index) {
+  Buffer *b = &s->code;
+  FInstr *i = &f_get_function(s->m, s->function)->u.body.konsts[index];
+  ui64 bits = 0;
+  if (i->type == FFloat) {
+    float f = (float)i->u.konst.f;
+    ui32 fbits;
+    memcpy(&fbits, &f, sizeof(fbits));
+    bits = fbits;
+  } else if (i->type == FDouble) {
+    memcpy(&bits, &i->u.konst.f, sizeof(bits));
+  } else if (i->type == FPointer) {
+    bits = (ui64)(size_t)i->u.konst.p;
+  } else {
+    bits = truncate_int(i->u.konst.i, i->type);
+  }
+  emitn(b, 2, 0x48, 0xb8);
+  emit64(b, bits);
+  store_int(b, RAX, value_slot(s, f_konst_value(index)));
+}
+
+/* Compile a single instruction */
+static void compile_instruction(X64State *s, FValue v) {
+  Buffer *b = &s->code;
+  FInstr *i = f_instr(s->m, s->function, v);
+  int k;
+  switch (i->tag) {
+    case FKonst:
+      /* Stored in the prologue by compile_konst */
+      break;
+    case FGetarg:
+      load_int(b, RAX, arg_slot(s, i->u.getarg.n));
+      zero_extend(b, RAX, i->type);
+      store_value(s, RAX, v);
+      break;
+    case FLoad:
+      load_value(s, RAX, i->u.load.addr);
+      switch (i->type) {
+        case FBool:
+        case FInt8:
+          emitn(b, 3, 0x0f, 0xb6, 0x00);
+          zero_extend(b, RAX, i->type);
+          break;
+        case FInt16:
+          emitn(b, 3, 0x0f, 0xb7, 0x00);
+          break;
+        case FInt32:
+        case FFloat:
+          emitn(b, 2, 0x8b, 0x00);
+          break;
+        default:
+          emitn(b, 3, 0x48, 0x8b, 0x00);
+          break;
+      }
+      store_value(s, RAX, v);
+      break;
+    case FStore:
+      load_value(s, RAX, i->u.store.addr);
+      load_value(s, RCX, i->u.store.val);
+      switch (value_type(s, i->u.store.val)) {
+        case FBool:
+        case FInt8:
+          emitn(b, 2, 0x88, 0x08);
+          break;
+        case FInt16:
+          emitn(b, 3, 0x66, 0x89, 0x08);
+          break;
+        case FInt32:
+        case FFloat:
+          emitn(b, 2, 0x89, 0x08);
+          break;
+        default:
+          emitn(b, 3, 0x48, 0x89, 0x08);
+          break;
+      }
+      /* Loads and stores are already ordered, except store -> load */
+      if (i->u.store.order == FSeqCst)
+        emitn(b, 3, 0x0f, 0xae, 0xf0);
+      break;
+    case FMemcpy:
+      compile_memcall(s, i->u.copy.dst, i->u.copy.src, i->u.copy.size,
+        (ui64)(size_t)memcpy);
+      break;
+    case FMemmove:
+      compile_memcall(s, i->u.copy.dst, i->u.copy.src, i->u.copy.size,
+        (ui64)(size_t)memmove);
+      break;
+    case FMemset:
+      compile_memcall(s, i->u.fill.dst, i->u.fill.val, i->u.fill.size,
+        (ui64)(size_t)memset);
+      break;
+    case FPrefetch:
+      compile_prefetch(s, i);
+      break;
+    case FAtomicRmw:
+      compile_atomic(s, i);
+      zero_extend(b, RAX, i->type);
+      store_value(s, RAX, v);
+      break;
+    case FCmpxchg:
+      /* lock cmpxchg [rcx], rdx */
+      load_value(s, RCX, i->u.cmpxchg.addr);
+      load_value(s, RAX, i->u.cmpxchg.cmp);
+      load_value(s, RDX, i->u.cmpxchg.val);
+      emit_locked(b, i->type, 1, 0xb1, 0x11);
+      zero_extend(b, RAX, i->type);
+      store_value(s, RAX, v);
+      break;
+    case FFence:
+      /* mfence */
+      if (i->u.fence.order == FSeqCst)
+        emitn(b, 3, 0x0f, 0xae, 0xf0);
+      break;
+    case FUnop:
+      compile_eval(s, (ui64)(size_t)f_eval_unop, i->u.unop.op, i->type, 1,
+        &i->u.unop.val);
+      store_value(s, RAX, v);
+      break;
+    case FTernop: {
+      FValue args[3];
+      args[0] = i->u.ternop.a;
+      args[1] = i->u.ternop.b;
+      args[2] = i->u.ternop.c;
+      compile_eval(s, (ui64)(size_t)f_eval_ternop, i->u.ternop.op, i->type,
+        3, args);
+      store_value(s, RAX, v);
+      break;
+    }
+    case FAlloca:
+      compile_alloca(s, i);
+      store_value(s, RAX, v);
+      break;
+    case FChecked:
+      compile_checked(s, i);
+      store_value(s, RAX, v);
+      break;
+    case FOverflowed: {
+      FInstr *checked = f_instr(s->m, s->function,
+        i->u.overflowed.checked);
+      FValue args[2];
+      args[0] = checked->u.checked.lhs;
+      args[1] = checked->u.checked.rhs;
+      compile_eval(s, (ui64)(size_t)f_eval_overflow, checked->u.checked.op,
+        checked->type, 2, args);
+      store_value(s, RAX, v);
+      break;
+    }
+    case FOffset:
+      load_value(s, RAX, i->u.offset.addr);
+      load_value(s, RCX, i->u.offset.offset);
+      sign_extend(b, RCX, value_type(s, i->u.offset.offset));
+      if (i->u.offset.negative)
+        emitn(b, 3, 0x48, 0xf7, 0xd9);
+      emitn(b, 3, 0x48, 0x01, 0xc8);
+      store_value(s, RAX, v);
+      break;
+    case FCast:
+      compile_cast(s, i);
+      if (f_is_float(i->type))
+        store_float(b, i->type, 0, value_slot(s, v));
+      else
+        store_value(s, RAX, v);
+      break;
+    case FBinop:
+      compile_binop(s, i);
+      if (f_is_float(i->type))
+        store_float(b, i->type, 0, value_slot(s, v));
+      else
+        store_value(s, RAX, v);
+      break;
+    case FIntCmp:
+      compile_intcmp(s, i);
+      store_value(s, RAX, v);
+      break;
+    case FFpCmp:
+      compile_fpcmp(s, i);
+      store_value(s, RAX, v);
+      break;
+    case FJmpIf: {
+      size_t pos;
+      load_value(s, RAX, i->u.jmpif.cond);
+      emitn(b, 4, 0x85, 0xc0, 0x0f, 0x84);
+      pos = b->size;
+      emit32(b, 0);
+      emit_phi_moves(s, s->bblock, i->u.jmpif.truebr);
+      emit_jump(s, i->u.jmpif.truebr, 0);
+      patch_rel32(b, pos, b->size);
+      emit_phi_moves(s, s->bblock, i->u.jmpif.falsebr);
+      emit_jump(s, i->u.jmpif.falsebr, 1);
+      break;
+    }
+    case FJmp:
+      emit_phi_moves(s, s->bblock, i->u.jmp.dest);
+      emit_jump(s, i->u.jmp.dest, 0);
+      break;
+    case FSelect:
+      load_value(s, RAX, i->u.select.cond);
+      load_value(s, RCX, i->u.select.truev);
+      load_value(s, RDX, i->u.select.falsev);
+      emitn(b, 2, 0x85, 0xc0);
+      emitn(b, 4, 0x48, 0x0f, 0x44, 0xca);
+      store_value(s, RCX, v);
+      break;
+    case FRet:
+      if (!f_null(i->u.ret.val)) {
+        enum FType type = value_type(s, i->u.ret.val);
+        if (f_is_float(type))
+          load_float(b, type, 0, value_slot(s, i->u.ret.val));
+        else
+          load_value(s, RAX, i->u.ret.val);
+      }
+      for (k = 0; k < NVALUEREGS; ++k)
+        if (s->saved & (1 << k))
+          load_int(b, value_regs[k], saved_slot(s, k));
+      emitn(b, 2, 0xc9, 0xc3);
+      break;
+    case FCall:
+      compile_call(s, v, i);
+      break;
+    case FPhi:
+      load_int(b, RAX, phi_slot(s, v));
+      store_value(s, RAX, v);
+      break;
+    case FSplat:
+    case FExtract:
+    case FInsert:
+    case FShuffle:
+    case FReduce:
+      /* Rejected by supported */
+      break;
+  }
+}
+
+/* Compile a function */
+static void compile_function(X64State *s, int function) {
+  Buffer *b = &s->code;
+  FFunction *f = f_get_function(s->m, function);
+  FFunctionType *ftype = f_get_ftype(s->m, f->type);
+  int nblocks = f->u.body.nbblocks;
+  int bb, i, nint = 0, nfloat = 0, nstack = 0, frame;
+  /* Assign the slots */
+  s->function = function;
+  s->bbstart = mem_newarray(size_t, nblocks);
+  s->backedge = mem_newarray(int, nblocks);
+  f_find_backedges(s->m, function, s->backedge);
+  s->nvalues = f->u.body.ninstrs;
+  s->nkonsts = f->u.body.nkonsts;
+  s->reg = mem_newarray(int, s->nvalues);
+  allocate_registers(s);
+  frame = 8 * (s->nkonsts + 2 * s->nvalues + ftype->nargs + NVALUEREGS);
+  frame = (frame + 15) & ~15;
+  /* Prologue: create the frame, save the value registers and store the
+   * arguments and the constants in their slots */
+  emitn(b, 4, 0x55, 0x48, 0x89, 0xe5);
+  emitn(b, 3, 0x48, 0x81, 0xec);
+  emit32(b, frame);
+  for (i = 0; i < NVALUEREGS; ++i)
+    if (s->saved & (1 << i))
+      store_int(b, value_regs[i], saved_slot(s, i));
+  if (s->counters)
+    emit_counter(b, &s->counters[2 * function]);
+  for (i = 0; i < ftype->nargs; ++i) {
+    if (f_is_float(ftype->args[i]) && nfloat < NFLOATARGS) {
+      store_float(b, FDouble, nfloat++, arg_slot(s, i));
+    } else if (!f_is_float(ftype->args[i]) && nint < NINTARGS) {
+      store_int(b, int_args[nint++], arg_slot(s, i));
+    } else {
+      load_int(b, RAX, 16 + 8 * nstack++);
+      store_int(b, RAX, arg_slot(s, i));
+    }
+  }
+  for (i = 0; i < s->nkonsts; ++i)
+    compile_konst(s, i);
+  /* Compile the blocks */
+  for (bb = 0; bb < nblocks; ++bb) {
+    s->bbstart[bb] = b->size;
+    s->bblock = bb;
+    f_bblock_foreach(f, bb, i)
+      compile_instruction(s, f_value(i));
+  }
+  vec_foreach(s->jumps, jump, {
+    patch_rel32(b, jump->pos, s->bbstart[jump->target]);
+  });
+  vec_close(s->jumps);
+  vec_init(s->jumps);
+  mem_deletearray(s->bbstart, nblocks);
+  mem_deletearray(s->backedge, nblocks);
+  mem_deletearray(s->reg, s->nvalues);
+}
+
+/* Check if the backend can compile the function
+ * Vector types aren't supported. */
+static int supported(FModule *m, int function) {
+  FFunction *f = f_get_function(m, function);
+  FFunctionType *ftype = f_get_ftype(m, f->type);
+  int a, i;
+  if (f_is_vec(ftype->ret))
+    return 0;
+  for (a = 0; a < ftype->nargs; ++a)
+    if (f_is_vec(ftype->args[a]))
+      return 0;
+  if (f->tag == FModFunc) {
+    for (i = 0; i < f->u.body.ninstrs; ++i)
+      if (f_is_vec(f->u.body.instrs[i].type))
+        return 0;
+    for (i = 0; i < f->u.body.nkonsts; ++i)
+      if (f_is_vec(f->u.body.konsts[i].type))
+        return 0;
+  }
+  return 1;
+}
+
+/* Compile the functions that aren't in the engine yet into a new chunk
+ * Return a value different from 0 if there is an error. */
+static int compile_chunk(X64Engine *data, FModule *m) {
+  X64State s;
+  Chunk chunk;
+  int nfuncs = m->nfunctions;
+  int nnew = nfuncs - data->nfuncs;
+  int i;
+  if (nnew <= 0)
+    return 0;
+  for (i = data->nfuncs; i < nfuncs; ++i) {
+    if (!supported(m, i)) {
+      fprintf(stderr, "the baseline backend doesn't support vector types "
+        "(function %d)\n", i + 1);
+      return 1;
+    }
+  }
+  s.m = m;
+  s.counters = data->counters;
+  s.table = data->table;
+  s.funcs = data->funcs;
+  s.first = data->nfuncs;
+  s.code.data = NULL;
+  s.code.size = 0;
+  s.code.capacity = 0;
+  s.fstart = mem_newarray(size_t, nnew);
+  vec_init(s.calls);
+  vec_init(s.jumps);
+  for (i = s.first; i < nfuncs; ++i) {
+    if (f_get_function(m, i)->tag == FModFunc) {
+      while (s.code.size % 16)
+        emit(&s.code, 0xcc);
+      s.fstart[i - s.first] = s.code.size;
+      compile_function(&s, i);
+    }
+  }
+  vec_foreach(s.calls, call, {
+    patch_rel32(&s.code, call->pos, s.fstart[call->target - s.first]);
+  });
+  vec_close(s.calls);
+  /* Copy the code to executable memory */
+  chunk.mem = NULL;
+  chunk.size = s.code.size;
+  if (chunk.size) {
+    chunk.mem = mmap(NULL, chunk.size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk.mem == MAP_FAILED) {
+      fprintf(stderr, "unable to allocate executable memory\n");
+      mem_deletearray(s.fstart, nnew);
+      mem_alloc(s.code.data, s.code.capacity, 0);
+      return 1;
+    }
+    memcpy(chunk.mem, s.code.data, chunk.size);
+    mprotect(chunk.mem, chunk.size, PROT_READ | PROT_EXEC);
+    vec_push(data->chunks, chunk);
+  }
+  mem_alloc(s.code.data, s.code.capacity, 0);
+  /* Register the functions */
+  data->funcs = mem_alloc(data->funcs, data->nfuncs * sizeof(FJitFunc),
+    nfuncs * sizeof(FJitFunc));
+  for (i = s.first; i < nfuncs; ++i) {
+    FFunction *f = f_get_function(m, i);
+    if (f->tag == FExtFunc) {
+      data->funcs[i] = f->u.ptr;
+    } else {
+      void *addr = (ui8 *)chunk.mem + s.fstart[i - s.first];
+      memcpy(&data->funcs[i], &addr, sizeof(addr));
+    }
+  }
+  data->nfuncs = nfuncs;
+  mem_deletearray(s.fstart, nnew);
+  return 0;
+}
+
+int f_x64_compile(FEngine *e, FModule *m) {
+  return f_x64_compile_instrumented(e, m, NULL, NULL);
+}
+
+int f_x64_compile_instrumented(FEngine *e, FModule *m, ui64 *counters,
+    FJitFunc *table) {
+  X64Engine *data = mem_newarray(X64Engine, 1);
+  vec_init(data->chunks);
+  data->funcs = NULL;
+  data->nfuncs = 0;
+  data->counters = counters;
+  data->table = table;
+  e->data = data;
+  if (f_x64_compile_incremental(e, m)) {
+    f_x64_close_engine(data);
+    e->data = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+int f_x64_compile_incremental(FEngine *e, FModule *m) {
+  X64Engine *data = e->data;
+  if (compile_chunk(data, m))
+    return 1;
+  e->funcs = data->funcs;
+  e->nfuncs = data->nfuncs;
+  return 0;
+}
+
+void f_x64_close_engine(void *engine_data) {
+  X64Engine *data = engine_data;
+  vec_foreach(data->chunks, chunk, munmap(chunk->mem, chunk->size));
+  vec_close(data->chunks);
+  mem_deletearray(data->funcs, data->nfuncs);
+  mem_deletearray(data, 1);
+}
+
+#else
+
+int f_x64_compile(FEngine *e, FModule *m) {
+  (void)e;
+  (void)m;
+  fprintf(stderr, "the baseline backend requires x86-64 with the SysV ABI\n");
+  return 1;
+}
+
+int f_x64_compile_instrumented(FEngine *e, FModule *m, ui64 *counters,
+    FJitFunc *table) {
+  (void)counters;
+  (void)table;
+  return f_x64_compile(e, m);
+}
+
+int f_x64_compile_incremental(FEngine *e, FModule *m) {
+  return f_x64_compile(e, m);
+}
+
+void f_x64_close_engine(void *data) {
+  (void)data;
+}
+
+#endif
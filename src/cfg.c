@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "cfg.h"
+
+void f_find_backedges(FModule *m, int function, int *backedge) {
+  int nblocks = f_get_function(m, function)->u.body.nbblocks;
+  int *stack = mem_newarray(int, nblocks);
+  int *next = mem_newarray(int, nblocks);
+  char *state = mem_newarray(char, nblocks);   /* 0 new, 1 open, 2 done */
+  int top = 0, bb;
+  for (bb = 0; bb < nblocks; ++bb) {
+    next[bb] = 0;
+    state[bb] = 0;
+    backedge[bb] = 0;
+  }
+  stack[top++] = 0;
+  state[0] = 1;
+  while (top > 0) {
+    FBBlock *bblock;
+    FInstr *last;
+    int succ[2], nsucc = 0;
+    bb = stack[top - 1];
+    bblock = f_get_bblock(m, function, bb);
+    last = f_instr(m, function, f_value(bblock->last));
+    if (last->tag == FJmp) {
+      succ[nsucc++] = last->u.jmp.dest;
+    } else if (last->tag == FJmpIf) {
+      succ[nsucc++] = last->u.jmpif.truebr;
+      succ[nsucc++] = last->u.jmpif.falsebr;
+    }
+    if (next[bb] == nsucc) {
+      state[bb] = 2;
+      top--;
+    } else {
+      int n = next[bb]++;
+      int s = succ[n];
+      if (state[s] == 1)
+        backedge[bb] |= 1 << n;
+      else if (state[s] == 0) {
+        state[s] = 1;
+        stack[top++] = s;
+      }
+    }
+  }
+  mem_deletearray(stack, nblocks);
+  mem_deletearray(next, nblocks);
+  mem_deletearray(state, nblocks);
+}
@@ -0,0 +1,116 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <fahrenheit/backend.h>
+#include <fahrenheit/tier.h>
+
+#include "engine.h"
+
+void f_init_engine(FEngine *e) {
+  e->funcs = NULL;
+  e->nfuncs = 0;
+  e->backend = FBackendLLVM;
+  e->data = NULL;
+}
+
+void f_close_engine(FEngine *e) {
+  if (e->data) {
+    switch (e->backend) {
+      case FBackendX64:
+        f_x64_close_engine(e->data);
+        break;
+      case FBackendTiered:
+        f_tier_close_engine(e->data);
+        break;
+      default:
+        f_llvm_close_engine(e->data);
+        break;
+    }
+  }
+  e->funcs = NULL;
+  e->nfuncs = 0;
+  e->data = NULL;
+}
+
+/* Compile the module into a new engine of the given backend
+ * The previous contents of the engine are only released if the compilation
+ * succeeds. */
+static int compile(FEngine *e, struct FModule *m, enum FBackend backend,
+    const FCompileOptions *opts, const FTierOptions *tier) {
+  FEngine compiled;
+  FCompileOptions default_opts;
+  int status;
+  if (!opts) {
+    f_init_compile_options(&default_opts, 2);
+    opts = &default_opts;
+  }
+  f_init_engine(&compiled);
+  compiled.backend = backend;
+  switch (backend) {
+    case FBackendX64:
+      status = f_x64_compile(&compiled, m);
+      break;
+    case FBackendTiered:
+      status = f_tier_compile(&compiled, m, opts, tier);
+      break;
+    default:
+      status = f_llvm_compile(&compiled, m, opts);
+      break;
+  }
+  if (status)
+    return status;
+  f_close_engine(e);
+  *e = compiled;
+  return 0;
+}
+
+int f_compile(FEngine *e, struct FModule *m) {
+  return f_compile_ex(e, m, NULL);
+}
+
+int f_compile_ex(FEngine *e, struct FModule *m, const FCompileOptions *opts) {
+  return compile(e, m, e->backend, opts, NULL);
+}
+
+int f_compile_tiered(FEngine *e, struct FModule *m,
+    const FCompileOptions *opts, const FTierOptions *tier) {
+  return compile(e, m, FBackendTiered, opts, tier);
+}
+
+int f_compile_incremental(FEngine *e, struct FModule *m) {
+  if (!e->data)
+    return f_compile(e, m);
+  switch (e->backend) {
+    case FBackendX64:
+      return f_x64_compile_incremental(e, m);
+    case FBackendTiered:
+      fprintf(stderr, "tiered engines can't be compiled incrementally\n");
+      return 1;
+    default:
+      return f_llvm_compile_incremental(e, m);
+  }
+}
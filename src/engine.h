@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_engine_h
+#define fahrenheit_engine_h
+
+/* Interface between the engine API (backend.h) and the code generators
+ * The compile functions receive an empty engine and fill it. The incremental
+ * compile functions receive an engine that was filled by the same backend. */
+
+#include <fahrenheit/backend.h>
+#include <fahrenheit/ir.h>
+#include <fahrenheit/tier.h>
+
+/* LLVM backend */
+int f_llvm_compile(FEngine *e, struct FModule *m, const FCompileOptions *opts);
+int f_llvm_compile_incremental(FEngine *e, struct FModule *m);
+void f_llvm_close_engine(void *data);
+
+/* Baseline x86-64 backend */
+#if defined(__x86_64__) && !defined(_WIN32)
+#define F_X64_SUPPORTED 1
+#else
+#define F_X64_SUPPORTED 0
+#endif
+
+int f_x64_compile(FEngine *e, struct FModule *m);
+int f_x64_compile_incremental(FEngine *e, struct FModule *m);
+void f_x64_close_engine(void *data);
+
+/* Compile with the instrumentation used by the tiering manager
+ * The counters receive two entries per function: the number of calls and the
+ * number of loop back edges. If the table isn't NULL, the module functions
+ * call each other through it. Both arrays must outlive the engine. */
+int f_x64_compile_instrumented(FEngine *e, struct FModule *m, ui64 *counters,
+    FJitFunc *table);
+
+/* Tiering manager */
+int f_tier_compile(FEngine *e, struct FModule *m, const FCompileOptions *opts,
+    const FTierOptions *tier);
+void f_tier_close_engine(void *data);
+
+#endif
+
@@ -0,0 +1,184 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "eval.h"
+
+/* Obtain the width in bits of an integer type */
+static int width(enum FType type) {
+  switch (type) {
+    case FInt8: return 8;
+    case FInt16: return 16;
+    case FInt32: return 32;
+    default: return 64;
+  }
+}
+
+/* Truncate the bits to the type width */
+static ui64 truncate_int(ui64 value, enum FType type) {
+  int w = width(type);
+  return w == 64 ? value : value & (((ui64)1 << w) - 1);
+}
+
+/* Obtain the sign bit of an integer type */
+static ui64 sign_bit(enum FType type) {
+  return (ui64)1 << (width(type) - 1);
+}
+
+/* Convert the bits of a float point to a double */
+static double to_double(ui64 bits, enum FType type) {
+  if (type == FFloat) {
+    ui32 fbits = (ui32)bits;
+    float f;
+    memcpy(&f, &fbits, sizeof(f));
+    return f;
+  } else {
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+  }
+}
+
+/* Convert a double to the bits of a float point */
+static ui64 from_double(double d, enum FType type) {
+  if (type == FFloat) {
+    float f = (float)d;
+    ui32 fbits;
+    memcpy(&fbits, &f, sizeof(fbits));
+    return fbits;
+  } else {
+    ui64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+  }
+}
+
+ui64 f_eval_unop(int op, int type, ui64 val) {
+  enum FType t = (enum FType)type;
+  int w = width(t), n = 0;
+  if (f_is_float(t)) {
+    double x = to_double(val, t);
+    switch (op) {
+      case FSqrt: x = sqrt(x); break;
+      case FFloor: x = floor(x); break;
+      case FCeil: x = ceil(x); break;
+      default: x = fabs(x); break;
+    }
+    return from_double(x, t);
+  }
+  val = truncate_int(val, t);
+  switch (op) {
+    case FAbs:
+      return val & sign_bit(t) ? truncate_int(~val + 1, t) : val;
+    case FPopcount:
+      for (; val; val &= val - 1) n++;
+      return n;
+    case FCtlz:
+      for (n = w; val; val >>= 1) n--;
+      return n;
+    case FCttz:
+      if (val == 0) return w;
+      for (; !(val & 1); val >>= 1) n++;
+      return n;
+    default: {
+      ui64 r = 0;
+      for (n = 0; n < w; n += 8)
+        r = r << 8 | ((val >> n) & 0xff);
+      return r;
+    }
+  }
+}
+
+ui64 f_eval_binop(int op, int type, ui64 lhs, ui64 rhs) {
+  enum FType t = (enum FType)type;
+  int w = width(t), n;
+  ui64 sb;
+  if (f_is_float(t)) {
+    double x = to_double(lhs, t), y = to_double(rhs, t);
+    /* Return the operand that isn't NaN */
+    if (x != x) return rhs;
+    if (y != y) return lhs;
+    if (op == FMin) return x <= y ? lhs : rhs;
+    return x >= y ? lhs : rhs;
+  }
+  lhs = truncate_int(lhs, t);
+  rhs = truncate_int(rhs, t);
+  /* Flipping the sign bits makes the unsigned comparison signed */
+  sb = op == FMin || op == FMax ? sign_bit(t) : 0;
+  switch (op) {
+    case FMin: return (lhs ^ sb) <= (rhs ^ sb) ? lhs : rhs;
+    case FMax: return (lhs ^ sb) >= (rhs ^ sb) ? lhs : rhs;
+    case FUMin: return lhs <= rhs ? lhs : rhs;
+    case FUMax: return lhs >= rhs ? lhs : rhs;
+    default:
+      n = (int)(rhs % w);
+      if (op == FRotr) n = (w - n) % w;
+      if (n == 0) return lhs;
+      return truncate_int(lhs << n | lhs >> (w - n), t);
+  }
+}
+
+ui64 f_eval_ternop(int op, int type, ui64 a, ui64 b, ui64 c) {
+  enum FType t = (enum FType)type;
+  (void)op;
+  if (t == FFloat)
+    return from_double(fmaf((float)to_double(a, t), (float)to_double(b, t),
+      (float)to_double(c, t)), t);
+  return from_double(fma(to_double(a, t), to_double(b, t), to_double(c, t)), t);
+}
+
+/* Check if the product of the magnitudes is bigger than the limit */
+static int mul_overflow(ui64 lhs, ui64 rhs, ui64 limit) {
+  return rhs != 0 && lhs > limit / rhs;
+}
+
+ui64 f_eval_overflow(int op, int type, ui64 lhs, ui64 rhs) {
+  enum FType t = (enum FType)type;
+  ui64 sb = sign_bit(t), mask = sb | (sb - 1), r;
+  lhs &= mask;
+  rhs &= mask;
+  switch (op) {
+    case FCheckedSAdd:
+      r = (lhs + rhs) & mask;
+      return ((lhs ^ r) & (rhs ^ r) & sb) != 0;
+    case FCheckedUAdd:
+      return ((lhs + rhs) & mask) < lhs;
+    case FCheckedSSub:
+      r = (lhs - rhs) & mask;
+      return ((lhs ^ rhs) & (lhs ^ r) & sb) != 0;
+    case FCheckedUSub:
+      return lhs < rhs;
+    case FCheckedSMul: {
+      /* The negative results can reach the sign bit */
+      ui64 limit = (lhs ^ rhs) & sb ? sb : sb - 1;
+      if (lhs & sb) lhs = (~lhs + 1) & mask;
+      if (rhs & sb) rhs = (~rhs + 1) & mask;
+      return mul_overflow(lhs, rhs, limit);
+    }
+    default:
+      return mul_overflow(lhs, rhs, mask);
+  }
+}
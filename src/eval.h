@@ -0,0 +1,49 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef fahrenheit_eval_h
+#define fahrenheit_eval_h
+
+/* Operations that the baseline backend and the interpreter evaluate in C
+ * The operands and the results are raw bits: integers are zero extended and
+ * floats use the lower 32 bits. The type must be a scalar. The baseline
+ * backend calls these functions from the generated code, so their signatures
+ * must only use integers. */
+
+#include <fahrenheit/ir.h>
+
+/* Evaluate a unary operation */
+ui64 f_eval_unop(int op, int type, ui64 val);
+
+/* Evaluate one of the binary operations that aren't native (Min to Rotr) */
+ui64 f_eval_binop(int op, int type, ui64 lhs, ui64 rhs);
+
+/* Evaluate a ternary operation */
+ui64 f_eval_ternop(int op, int type, ui64 a, ui64 b, ui64 c);
+
+/* Check if a checked operation overflows (returns 0 or 1) */
+ui64 f_eval_overflow(int op, int type, ui64 lhs, ui64 rhs);
+
+#endif
+
@@ -0,0 +1,282 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <fahrenheit/hash.h>
+
+/* FNV-1a 64 bits parameters */
+#define FNV_OFFSET (((ui64)0xcbf29ce4 << 32) | 0x84222325)
+#define FNV_PRIME (((ui64)0x100 << 32) | 0x000001b3)
+
+ui64 f_hash_init(void) {
+  return FNV_OFFSET;
+}
+
+ui64 f_hash_combine(ui64 h, ui64 value) {
+  int i;
+  for (i = 0; i < 8; ++i) {
+    h ^= value & 0xff;
+    h *= FNV_PRIME;
+    value >>= 8;
+  }
+  return h;
+}
+
+static ui64 hash_value(ui64 h, FValue v) {
+  return f_hash_combine(h, v.id);
+}
+
+static ui64 hash_ftype(ui64 h, FFunctionType *ftype) {
+  int i;
+  h = f_hash_combine(h, ftype->ret);
+  h = f_hash_combine(h, ftype->nargs);
+  for (i = 0; i < ftype->nargs; ++i)
+    h = f_hash_combine(h, ftype->args[i]);
+  return f_hash_combine(h, ftype->vararg);
+}
+
+static ui64 hash_attrs(ui64 h, FFunction *f, int nargs) {
+  int i;
+  h = f_hash_combine(h, f->attrs);
+  if (f->params) {
+    for (i = 0; i < nargs; ++i) {
+      h = f_hash_combine(h, f->params[i].attrs);
+      h = f_hash_combine(h, f->params[i].align);
+    }
+  }
+  return h;
+}
+
+static ui64 hash_instr(FModule *m, ui64 h, FInstr *i, int callee_ids) {
+  h = f_hash_combine(h, i->tag);
+  h = f_hash_combine(h, i->type);
+  switch (i->tag) {
+    case FKonst:
+      if (i->type == FPointer)
+        h = f_hash_combine(h, (ui64)(size_t)i->u.konst.p);
+      else
+        h = f_hash_combine(h, i->u.konst.i);
+      break;
+    case FGetarg:
+      h = f_hash_combine(h, i->u.getarg.n);
+      break;
+    case FLoad:
+      h = hash_value(h, i->u.load.addr);
+      h = f_hash_combine(h, i->u.load.order);
+      break;
+    case FStore:
+      h = hash_value(h, i->u.store.addr);
+      h = hash_value(h, i->u.store.val);
+      h = f_hash_combine(h, i->u.store.order);
+      break;
+    case FOffset:
+      h = hash_value(h, i->u.offset.addr);
+      h = hash_value(h, i->u.offset.offset);
+      h = f_hash_combine(h, i->u.offset.negative);
+      break;
+    case FCast:
+      h = f_hash_combine(h, i->u.cast.op);
+      h = hash_value(h, i->u.cast.val);
+      break;
+    case FBinop:
+      h = f_hash_combine(h, i->u.binop.op);
+      h = hash_value(h, i->u.binop.lhs);
+      h = hash_value(h, i->u.binop.rhs);
+      break;
+    case FIntCmp:
+      h = f_hash_combine(h, i->u.intcmp.op);
+      h = hash_value(h, i->u.intcmp.lhs);
+      h = hash_value(h, i->u.intcmp.rhs);
+      break;
+    case FFpCmp:
+      h = f_hash_combine(h, i->u.fpcmp.op);
+      h = hash_value(h, i->u.fpcmp.lhs);
+      h = hash_value(h, i->u.fpcmp.rhs);
+      break;
+    case FJmpIf:
+      h = hash_value(h, i->u.jmpif.cond);
+      h = f_hash_combine(h, i->u.jmpif.truebr);
+      h = f_hash_combine(h, i->u.jmpif.falsebr);
+      break;
+    case FJmp:
+      h = f_hash_combine(h, i->u.jmp.dest);
+      break;
+    case FSelect:
+      h = hash_value(h, i->u.select.cond);
+      h = hash_value(h, i->u.select.truev);
+      h = hash_value(h, i->u.select.falsev);
+      break;
+    case FRet:
+      h = hash_value(h, i->u.ret.val);
+      break;
+    case FCall: {
+      int a;
+      if (callee_ids)
+        h = f_hash_combine(h, i->u.call.function);
+      else
+        h = hash_ftype(h, f_get_ftype_by_function(m, i->u.call.function));
+      h = f_hash_combine(h, i->u.call.nargs);
+      for (a = 0; a < i->u.call.nargs; ++a)
+        h = hash_value(h, i->u.call.args[a]);
+      break;
+    }
+    case FPhi: {
+      int k;
+      h = f_hash_combine(h, i->u.phi.ninc);
+      for (k = 0; k < i->u.phi.ninc; ++k) {
+        h = f_hash_combine(h, i->u.phi.inc[k].bb);
+        h = hash_value(h, i->u.phi.inc[k].value);
+      }
+      break;
+    }
+    case FSplat:
+      h = hash_value(h, i->u.splat.val);
+      break;
+    case FExtract:
+      h = hash_value(h, i->u.extract.vec);
+      h = f_hash_combine(h, i->u.extract.lane);
+      break;
+    case FInsert:
+      h = hash_value(h, i->u.insert.vec);
+      h = hash_value(h, i->u.insert.val);
+      h = f_hash_combine(h, i->u.insert.lane);
+      break;
+    case FShuffle: {
+      int l;
+      h = hash_value(h, i->u.shuffle.lhs);
+      h = hash_value(h, i->u.shuffle.rhs);
+      for (l = 0; i->u.shuffle.mask && l < f_lanes(i->type); ++l)
+        h = f_hash_combine(h, i->u.shuffle.mask[l]);
+      break;
+    }
+    case FReduce:
+      h = f_hash_combine(h, i->u.reduce.op);
+      h = hash_value(h, i->u.reduce.vec);
+      break;
+    case FMemcpy:
+    case FMemmove:
+      h = hash_value(h, i->u.copy.dst);
+      h = hash_value(h, i->u.copy.src);
+      h = hash_value(h, i->u.copy.size);
+      h = f_hash_combine(h, i->u.copy.align);
+      h = f_hash_combine(h, i->u.copy.isvolatile);
+      break;
+    case FMemset:
+      h = hash_value(h, i->u.fill.dst);
+      h = hash_value(h, i->u.fill.val);
+      h = hash_value(h, i->u.fill.size);
+      h = f_hash_combine(h, i->u.fill.align);
+      h = f_hash_combine(h, i->u.fill.isvolatile);
+      break;
+    case FPrefetch:
+      h = hash_value(h, i->u.prefetch.addr);
+      h = f_hash_combine(h, i->u.prefetch.write);
+      h = f_hash_combine(h, i->u.prefetch.locality);
+      break;
+    case FAtomicRmw:
+      h = f_hash_combine(h, i->u.atomic.op);
+      h = hash_value(h, i->u.atomic.addr);
+      h = hash_value(h, i->u.atomic.val);
+      h = f_hash_combine(h, i->u.atomic.order);
+      break;
+    case FCmpxchg:
+      h = hash_value(h, i->u.cmpxchg.addr);
+      h = hash_value(h, i->u.cmpxchg.cmp);
+      h = hash_value(h, i->u.cmpxchg.val);
+      h = f_hash_combine(h, i->u.cmpxchg.order);
+      break;
+    case FFence:
+      h = f_hash_combine(h, i->u.fence.order);
+      break;
+    case FUnop:
+      h = f_hash_combine(h, i->u.unop.op);
+      h = hash_value(h, i->u.unop.val);
+      break;
+    case FChecked:
+      h = f_hash_combine(h, i->u.checked.op);
+      h = hash_value(h, i->u.checked.lhs);
+      h = hash_value(h, i->u.checked.rhs);
+      break;
+    case FOverflowed:
+      h = hash_value(h, i->u.overflowed.checked);
+      break;
+    case FAlloca:
+      h = f_hash_combine(h, i->u.alloca.size);
+      h = hash_value(h, i->u.alloca.dynsize);
+      h = f_hash_combine(h, i->u.alloca.align);
+      break;
+    case FTernop:
+      h = f_hash_combine(h, i->u.ternop.op);
+      h = hash_value(h, i->u.ternop.a);
+      h = hash_value(h, i->u.ternop.b);
+      h = hash_value(h, i->u.ternop.c);
+      break;
+  }
+  return h;
+}
+
+static ui64 hash_function(FModule *m, int function, int callee_ids, ui64 h) {
+  FFunction *f = f_get_function(m, function);
+  h = f_hash_combine(h, f->tag);
+  h = hash_ftype(h, f_get_ftype(m, f->type));
+  h = hash_attrs(h, f, f_get_ftype(m, f->type)->nargs);
+  if (f->tag == FModFunc) {
+    int b, i;
+    h = f_hash_combine(h, f->u.body.nkonsts);
+    for (i = 0; i < f->u.body.nkonsts; ++i)
+      h = hash_instr(m, h, &f->u.body.konsts[i], callee_ids);
+    h = f_hash_combine(h, f->u.body.nbblocks);
+    for (b = 0; b < f->u.body.nbblocks; ++b) {
+      h = f_hash_combine(h, f->u.body.bblocks[b].ninstrs);
+      f_bblock_foreach(f, b, i) {
+        h = f_hash_combine(h, i);
+        h = hash_instr(m, h, &f->u.body.instrs[i], callee_ids);
+      }
+    }
+  }
+  return h;
+}
+
+ui64 f_hash_function(FModule *m, int function) {
+  return hash_function(m, function, 1, f_hash_init());
+}
+
+ui64 f_hash_function_body(FModule *m, int function) {
+  return hash_function(m, function, 0, f_hash_init());
+}
+
+ui64 f_hash_function_body_seed(FModule *m, int function, ui64 seed) {
+  return hash_function(m, function, 0, seed);
+}
+
+ui64 f_hash_module(FModule *m) {
+  return f_hash_module_seed(m, f_hash_init());
+}
+
+ui64 f_hash_module_seed(FModule *m, ui64 seed) {
+  ui64 h = f_hash_combine(seed, m->nfunctions);
+  int i;
+  for (i = 0; i < m->nfunctions; ++i)
+    h = f_hash_combine(h, hash_function(m, i, 1, seed));
+  return h;
+}
@@ -24,46 +24,167 @@
 
 #include <stdarg.h>
 
+#include <fahrenheit/hash.h>
 #include <fahrenheit/instructions.h>
 
-/* Add a instruction to the current block */
+/* Add a instruction to the function and link it at the end of the current
+ * block */
 static FInstr *addinstr(FBuilder b, enum FType type, enum FInstrTag tag) {
+  FFunction *f = f_get_function(b.module, b.function);
   FBBlock *bb = f_get_bblock_by_builder(b);
-  FInstr i;
-  i.type = type;
-  i.tag = tag;
-  vec_push(*bb, i);
-  return vec_getref(*bb, vec_size(*bb) - 1);
+  int id = f->u.body.ninstrs;
+  FInstr *i;
+  f->u.body.instrs = f_arena_reserve(b.module->arena, f->u.body.instrs, id,
+    &f->u.body.capinstrs, sizeof(FInstr));
+  f->u.body.firstuse = f_arena_reserve(b.module->arena, f->u.body.firstuse,
+    id, &f->u.body.capfirstuse, sizeof(int));
+  f->u.body.firstuse[id] = -1;
+  f->u.body.ninstrs++;
+  if (bb->last >= 0)
+    f->u.body.instrs[bb->last].next = id;
+  else
+    bb->first = id;
+  bb->last = id;
+  bb->ninstrs++;
+  i = &f->u.body.instrs[id];
+  i->type = type;
+  i->tag = tag;
+  i->next = -1;
+  return i;
+}
+
+/* Record that the operand of the user refers to the value
+ * Constants and null values aren't tracked. */
+static void adduse(FBuilder b, FValue value, int user, int operand) {
+  FFunction *f = f_get_function(b.module, b.function);
+  FUse *use;
+  if (value.id < 0)
+    return;
+  f->u.body.uses = f_arena_reserve(b.module->arena, f->u.body.uses,
+    f->u.body.nuses, &f->u.body.capuses, sizeof(FUse));
+  use = &f->u.body.uses[f->u.body.nuses];
+  use->user = user;
+  use->operand = operand;
+  use->next = f->u.body.firstuse[value.id];
+  f->u.body.firstuse[value.id] = f->u.body.nuses++;
 }
 
-/* Obtain the last value add by the builder */
+/* Obtain the last value add by the builder and record the uses of its
+ * operands, which are set by then */
 static FValue lastvalue(FBuilder b) {
   FBBlock *bb = f_get_bblock_by_builder(b);
-  return f_value(b.bblock, vec_size(*bb) - 1);
+  FInstr *i = f_instr(b.module, b.function, f_value(bb->last));
+  FValue *op;
+  int n;
+  for (n = 0; (op = f_operand(i, n)) != NULL; ++n)
+    adduse(b, *op, bb->last, n);
+  return f_value(bb->last);
+}
+
+/* Initialize a constant with all bits of the value cleared */
+static void initkonst(FInstr *konst, enum FType type) {
+  konst->type = type;
+  konst->tag = FKonst;
+  konst->next = -1;
+  konst->u.konst.i = 0;
+}
+
+/* Hash the type and the bits of a constant */
+static ui64 hashkonst(FInstr *konst) {
+  ui64 h = f_hash_combine(f_hash_init(), konst->type);
+  return f_hash_combine(h, konst->u.konst.i);
+}
+
+/* Find the slot of the constant in the intern table of the function
+ * The slot is either empty or holds a constant with the same type and bits.
+ * Float point constants are compared by bits, so 0.0 and -0.0 differ. */
+static int findkonst(FFunction *f, FInstr *konst) {
+  int mask = f->u.body.capkonstmap - 1;
+  int slot = (int)(hashkonst(konst) & mask);
+  for (;;) {
+    int k = f->u.body.konstmap[slot];
+    if (k < 0 || (f->u.body.konsts[k].type == konst->type &&
+        f->u.body.konsts[k].u.konst.i == konst->u.konst.i))
+      return slot;
+    slot = (slot + 1) & mask;
+  }
+}
+
+/* Double the intern table of the function (it is kept half empty) */
+static void growkonstmap(FModule *m, FFunction *f) {
+  int cap = f->u.body.capkonstmap ? 2 * f->u.body.capkonstmap : 16;
+  int i;
+  f->u.body.konstmap = f_arena_alloc(m->arena, cap * sizeof(int));
+  f->u.body.capkonstmap = cap;
+  for (i = 0; i < cap; ++i)
+    f->u.body.konstmap[i] = -1;
+  for (i = 0; i < f->u.body.nkonsts; ++i)
+    f->u.body.konstmap[findkonst(f, &f->u.body.konsts[i])] = i;
+}
+
+/* Obtain the constant from the pool of the function
+ * The constant is added to the pool if it isn't there yet. */
+static FValue internkonst(FBuilder b, FInstr *konst) {
+  FFunction *f = f_get_function(b.module, b.function);
+  int slot;
+  if (2 * (f->u.body.nkonsts + 1) > f->u.body.capkonstmap)
+    growkonstmap(b.module, f);
+  slot = findkonst(f, konst);
+  if (f->u.body.konstmap[slot] < 0) {
+    f->u.body.konsts = f_arena_reserve(b.module->arena, f->u.body.konsts,
+      f->u.body.nkonsts, &f->u.body.capkonsts, sizeof(FInstr));
+    f->u.body.konsts[f->u.body.nkonsts] = *konst;
+    f->u.body.konstmap[slot] = f->u.body.nkonsts++;
+  }
+  return f_konst_value(f->u.body.konstmap[slot]);
+}
+
+/* Obtain the type of a value (void if it is null) */
+static enum FType valuetype(FBuilder b, FValue v) {
+  if (f_null(v))
+    return FVoid;
+  return f_instr(b.module, b.function, v)->type;
 }
 
 FValue f_constb(FBuilder b, int val) {
-  FInstr *i = addinstr(b, FBool, FKonst);
-  i->u.konst.i = !!val;
-  return lastvalue(b);
+  FInstr konst;
+  initkonst(&konst, FBool);
+  konst.u.konst.i = !!val;
+  return internkonst(b, &konst);
+}
+
+/* Truncate an integer constant to the type width
+ * Constants that only differ in the truncated bits are the same value, so
+ * they must be interned (and hashed) as one. */
+static ui64 truncatekonst(ui64 val, enum FType type) {
+  switch (type) {
+    case FBool: return val != 0;
+    case FInt8: return val & 0xff;
+    case FInt16: return val & 0xffff;
+    case FInt32: return val & 0xffffffff;
+    default: return val;
+  }
 }
 
 FValue f_consti(FBuilder b, ui64 val, enum FType type) {
-  FInstr *i = addinstr(b, type, FKonst);
-  i->u.konst.i = val;
-  return lastvalue(b);
+  FInstr konst;
+  initkonst(&konst, type);
+  konst.u.konst.i = truncatekonst(val, type);
+  return internkonst(b, &konst);
 }
 
 FValue f_constf(FBuilder b, double val, enum FType type) {
-  FInstr *i = addinstr(b, type, FKonst);
-  i->u.konst.f = val;
-  return lastvalue(b);
+  FInstr konst;
+  initkonst(&konst, type);
+  konst.u.konst.f = val;
+  return internkonst(b, &konst);
 }
 
 FValue f_constp(FBuilder b, void *val) {
-  FInstr *i = addinstr(b, FPointer, FKonst);
-  i->u.konst.p = val;
-  return lastvalue(b);
+  FInstr konst;
+  initkonst(&konst, FPointer);
+  konst.u.konst.p = val;
+  return internkonst(b, &konst);
 }
 
 FValue f_getarg(FBuilder b, int n) {
@@ -77,6 +198,7 @@ FValue f_getarg(FBuilder b, int n) {
 FValue f_load(FBuilder b, FValue addr, enum FType type) {
   FInstr *i = addinstr(b, type, FLoad);
   i->u.load.addr = addr;
+  i->u.load.order = FNotAtomic;
   return lastvalue(b);
 }
 
@@ -84,6 +206,7 @@ FValue f_store(FBuilder b, FValue addr, FValue val) {
   FInstr *i = addinstr(b, FVoid, FStore);
   i->u.store.addr = addr;
   i->u.store.val = val;
+  i->u.store.order = FNotAtomic;
   return lastvalue(b);
 }
 
@@ -116,8 +239,48 @@ FValue f_binop(FBuilder b, enum FBinopTag op, FValue lhs, FValue rhs) {
   return lastvalue(b);
 }
 
+FValue f_checked(FBuilder b, enum FCheckedTag op, FValue lhs, FValue rhs) {
+  FInstr *i = addinstr(b, valuetype(b, lhs), FChecked);
+  i->u.checked.op = op;
+  i->u.checked.lhs = lhs;
+  i->u.checked.rhs = rhs;
+  return lastvalue(b);
+}
+
+FValue f_overflowed(FBuilder b, FValue checked) {
+  FInstr *i = addinstr(b, FBool, FOverflowed);
+  i->u.overflowed.checked = checked;
+  return lastvalue(b);
+}
+
+FValue f_unop(FBuilder b, enum FUnopTag op, FValue val) {
+  FInstr *i = addinstr(b, valuetype(b, val), FUnop);
+  i->u.unop.op = op;
+  i->u.unop.val = val;
+  return lastvalue(b);
+}
+
+FValue f_ternop(FBuilder b, enum FTernopTag op, FValue x, FValue y, FValue z) {
+  FInstr *i = addinstr(b, valuetype(b, x), FTernop);
+  i->u.ternop.op = op;
+  i->u.ternop.a = x;
+  i->u.ternop.b = y;
+  i->u.ternop.c = z;
+  return lastvalue(b);
+}
+
+/* Obtain the type of a comparison given its lhs */
+static enum FType cmptype(FBuilder b, FValue lhs) {
+  if (!f_null(lhs)) {
+    FInstr *lhsi = f_instr(b.module, b.function, lhs);
+    if (f_is_vec(lhsi->type))
+      return f_vec(FBool, f_lanes(lhsi->type));
+  }
+  return FBool;
+}
+
 FValue f_intcmp(FBuilder b, enum FIntCmpTag op, FValue lhs, FValue rhs) {
-  FInstr *i = addinstr(b, FBool, FIntCmp);
+  FInstr *i = addinstr(b, cmptype(b, lhs), FIntCmp);
   i->u.intcmp.op = op;
   i->u.intcmp.lhs = lhs;
   i->u.intcmp.rhs = rhs;
@@ -125,7 +288,7 @@ FValue f_intcmp(FBuilder b, enum FIntCmpTag op, FValue lhs, FValue rhs) {
 }
 
 FValue f_fpcmp(FBuilder b, enum FFpCmpTag op, FValue lhs, FValue rhs) {
-  FInstr *i = addinstr(b, FBool, FFpCmp);
+  FInstr *i = addinstr(b, cmptype(b, lhs), FFpCmp);
   i->u.fpcmp.op = op;
   i->u.fpcmp.lhs = lhs;
   i->u.fpcmp.rhs = rhs;
@@ -169,14 +332,14 @@ FValue f_ret(FBuilder b, FValue val) {
 static FInstr *create_call(FBuilder b, int function, int nargs) {
   FInstr *i;
   enum FType type = FVoid;
-  if (function < (int)vec_size(b.module->functions)) {
+  if (function < b.module->nfunctions) {
     FFunction *f = f_get_function(b.module, function);
     FFunctionType *ftype = f_get_ftype(b.module, f->type);
     type = ftype->ret;
   }
   i = addinstr(b, type, FCall);
   i->u.call.function = function;
-  i->u.call.args = mem_newarray(FValue, nargs);
+  i->u.call.args = f_arena_alloc(b.module->arena, nargs * sizeof(FValue));
   i->u.call.nargs = nargs;
   return i;
 }
@@ -202,15 +365,158 @@ FValue f_callv(FBuilder b, int function, int nargs, FValue *args) {
 
 FValue f_phi(FBuilder b, enum FType type) {
   FInstr *i = addinstr(b, type, FPhi);
-  vec_init(i->u.phi.inc);
+  i->u.phi.inc = NULL;
+  i->u.phi.ninc = 0;
+  i->u.phi.capacity = 0;
   return lastvalue(b);
 }
 
 void f_add_incoming(FBuilder b, FValue phi, int bb, FValue value) {
   FInstr *i = f_instr(b.module,  b.function, phi);
-  FPhiInc inc;
-  inc.bb = bb;
-  inc.value = value;
-  vec_push(i->u.phi.inc, inc);
+  FPhiInc *inc;
+  i->u.phi.inc = f_arena_reserve(b.module->arena, i->u.phi.inc,
+    i->u.phi.ninc, &i->u.phi.capacity, sizeof(FPhiInc));
+  inc = &i->u.phi.inc[i->u.phi.ninc++];
+  inc->bb = bb;
+  inc->value = value;
+  adduse(b, value, phi.id, i->u.phi.ninc - 1);
+}
+
+FValue f_splat(FBuilder b, FValue val, int lanes) {
+  FInstr *i = addinstr(b, f_vec(valuetype(b, val), lanes), FSplat);
+  i->u.splat.val = val;
+  return lastvalue(b);
+}
+
+FValue f_extract(FBuilder b, FValue vec, int lane) {
+  FInstr *i = addinstr(b, f_scalar(valuetype(b, vec)), FExtract);
+  i->u.extract.vec = vec;
+  i->u.extract.lane = lane;
+  return lastvalue(b);
+}
+
+FValue f_insert(FBuilder b, FValue vec, FValue val, int lane) {
+  FInstr *i = addinstr(b, valuetype(b, vec), FInsert);
+  i->u.insert.vec = vec;
+  i->u.insert.val = val;
+  i->u.insert.lane = lane;
+  return lastvalue(b);
+}
+
+FValue f_shuffle(FBuilder b, FValue lhs, FValue rhs, int nlanes,
+    const int *mask) {
+  enum FType type = f_vec(f_scalar(valuetype(b, lhs)), nlanes);
+  FInstr *i = addinstr(b, type, FShuffle);
+  int l;
+  i->u.shuffle.lhs = lhs;
+  i->u.shuffle.rhs = rhs;
+  i->u.shuffle.mask = nlanes > 0 ?
+    f_arena_alloc(b.module->arena, nlanes * sizeof(int)) : NULL;
+  for (l = 0; l < nlanes; ++l)
+    i->u.shuffle.mask[l] = mask[l];
+  return lastvalue(b);
+}
+
+FValue f_reduce(FBuilder b, enum FBinopTag op, FValue vec) {
+  FInstr *i = addinstr(b, f_scalar(valuetype(b, vec)), FReduce);
+  i->u.reduce.op = op;
+  i->u.reduce.vec = vec;
+  return lastvalue(b);
+}
+
+/* Create a memcpy or a memmove */
+static FValue create_copy(FBuilder b, enum FInstrTag tag, FValue dst,
+    FValue src, FValue size, int align, int isvolatile) {
+  FInstr *i = addinstr(b, FVoid, tag);
+  i->u.copy.dst = dst;
+  i->u.copy.src = src;
+  i->u.copy.size = size;
+  i->u.copy.align = align;
+  i->u.copy.isvolatile = !!isvolatile;
+  return lastvalue(b);
+}
+
+FValue f_memcpy(FBuilder b, FValue dst, FValue src, FValue size, int align,
+    int isvolatile) {
+  return create_copy(b, FMemcpy, dst, src, size, align, isvolatile);
+}
+
+FValue f_memmove(FBuilder b, FValue dst, FValue src, FValue size, int align,
+    int isvolatile) {
+  return create_copy(b, FMemmove, dst, src, size, align, isvolatile);
+}
+
+FValue f_memset(FBuilder b, FValue dst, FValue val, FValue size, int align,
+    int isvolatile) {
+  FInstr *i = addinstr(b, FVoid, FMemset);
+  i->u.fill.dst = dst;
+  i->u.fill.val = val;
+  i->u.fill.size = size;
+  i->u.fill.align = align;
+  i->u.fill.isvolatile = !!isvolatile;
+  return lastvalue(b);
+}
+
+FValue f_prefetch(FBuilder b, FValue addr, int write, int locality) {
+  FInstr *i = addinstr(b, FVoid, FPrefetch);
+  i->u.prefetch.addr = addr;
+  i->u.prefetch.write = write;
+  i->u.prefetch.locality = locality;
+  return lastvalue(b);
+}
+
+FValue f_alloca(FBuilder b, int size, int align) {
+  FInstr *i = addinstr(b, FPointer, FAlloca);
+  i->u.alloca.size = size;
+  i->u.alloca.dynsize = FNullValue;
+  i->u.alloca.align = align;
+  return lastvalue(b);
+}
+
+FValue f_alloca_dynamic(FBuilder b, FValue size, int align) {
+  FInstr *i = addinstr(b, FPointer, FAlloca);
+  i->u.alloca.size = 0;
+  i->u.alloca.dynsize = size;
+  i->u.alloca.align = align;
+  return lastvalue(b);
+}
+
+FValue f_atomic_load(FBuilder b, FValue addr, enum FType type,
+    enum FOrdering order) {
+  FValue v = f_load(b, addr, type);
+  f_instr(b.module, b.function, v)->u.load.order = order;
+  return v;
+}
+
+FValue f_atomic_store(FBuilder b, FValue addr, FValue val,
+    enum FOrdering order) {
+  FValue v = f_store(b, addr, val);
+  f_instr(b.module, b.function, v)->u.store.order = order;
+  return v;
+}
+
+FValue f_atomic_rmw(FBuilder b, enum FAtomicTag op, FValue addr, FValue val,
+    enum FOrdering order) {
+  FInstr *i = addinstr(b, valuetype(b, val), FAtomicRmw);
+  i->u.atomic.op = op;
+  i->u.atomic.addr = addr;
+  i->u.atomic.val = val;
+  i->u.atomic.order = order;
+  return lastvalue(b);
 }
 
+FValue f_cmpxchg(FBuilder b, FValue addr, FValue cmp, FValue val,
+    enum FOrdering order) {
+  FInstr *i = addinstr(b, valuetype(b, val), FCmpxchg);
+  i->u.cmpxchg.addr = addr;
+  i->u.cmpxchg.cmp = cmp;
+  i->u.cmpxchg.val = val;
+  i->u.cmpxchg.order = order;
+  return lastvalue(b);
+}
+
+FValue f_fence(FBuilder b, enum FOrdering order) {
+  FInstr *i = addinstr(b, FVoid, FFence);
+  i->u.fence.order = order;
+  return lastvalue(b);
+}
@@ -0,0 +1,1325 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fahrenheit/interp.h>
+#include <fahrenheit/ir.h>
+
+#include "cfg.h"
+#include "eval.h"
+
+/* Dispatch with computed gotos when the compiler supports them (it is a GNU
+ * extension, so the pedantic warnings are disabled in this file); otherwise
+ * fall back to a switch */
+#if defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define THREADED_DISPATCH
+#endif
+
+/* Bytecode
+ * Every SSA value has a register in the frame. The registers of a function
+ * are laid out as: constants, arguments, the other values, the phi shadows
+ * and one scratch register. Integers are kept zero extended, so most
+ * operations only have to truncate their results. Phis are implemented like
+ * in the baseline backend: each edge writes the shadow registers of the phis
+ * and the phi instruction copies its shadow. */
+
+/* Opcodes that depend on the integer width */
+#define INT_OPCODES(_, W) \
+  _(ADD##W) _(SUB##W) _(MUL##W) _(DIV##W) _(SHL##W) _(SREM##W) _(SAR##W) \
+  _(SLT##W) _(SLE##W) _(SEXT##W) _(TRUNC##W)
+
+/* Opcodes that depend on the float point type */
+#define FLOAT_OPCODES(_, T) \
+  _(ADD##T) _(SUB##T) _(MUL##T) _(DIV##T) \
+  _(OEQ##T) _(ONE##T) _(OLT##T) _(OLE##T) \
+  _(UEQ##T) _(UNE##T) _(ULT##T) _(ULE##T) \
+  _(TOU##T) _(TOS##T) _(FROMU##T) _(FROMS##T)
+
+#define OPCODES(_) \
+  _(MOV) _(CMOV) _(JMP) _(LOOP) _(JMPIF) _(RET) _(RETV) _(CALL) _(CALLEXT) \
+  _(LOADB) _(LOAD8) _(LOAD16) _(LOAD32) _(LOAD64) _(LOADF) _(LOADD) \
+  _(LOADP) _(STORE8) _(STORE16) _(STORE32) _(STORE64) _(STOREF) _(STORED) \
+  _(STOREP) _(ADDP) _(SUBP) _(UDIV) _(REM) _(SHR) _(AND) _(OR) _(XOR) \
+  _(EQ) _(NE) _(EQP) _(NEP) _(ULT) _(ULE) _(FTOD) _(DTOF) \
+  _(MEMCPY) _(MEMMOVE) _(MEMSET) _(EVAL) _(ALLOCA) _(ALLOCAV) \
+  _(ALOAD) _(ASTORE) _(ARMW) _(CMPXCHG) _(FENCE) \
+  INT_OPCODES(_, 8) INT_OPCODES(_, 16) INT_OPCODES(_, 32) INT_OPCODES(_, 64) \
+  FLOAT_OPCODES(_, F) FLOAT_OPCODES(_, D)
+
+#define OPCODE_ENUM(op) OP_##op,
+
+enum Opcode {
+  OPCODES(OPCODE_ENUM)
+  NOPCODES
+};
+
+/* Bytecode instruction
+ * Calls are followed by their arguments, three per instruction. Each
+ * argument is encoded as (register << 4 | type). Evaluations (see eval.h)
+ * encode the operation as (op << 4 | type) and are followed by the registers
+ * of their operands. Atomic instructions encode their ordering the same way
+ * (with the operation of rmw in the field of cmpxchg), and rmw and cmpxchg
+ * are followed by the registers of their operands. */
+typedef struct Code {
+  int op;
+  int a, b, c;
+} Code;
+
+VEC_DECLARE(Code);
+
+VEC_DECLARE(FInterpValue);
+
+/* Functions called by the evaluation instructions */
+enum EvalFunc {
+  EvalUnop, EvalBinop, EvalTernop, EvalOverflow
+};
+
+#define ARG_ENCODE(reg, type) ((reg) << 4 | (int)(type))
+#define ARG_REG(arg) ((arg) >> 4)
+#define ARG_TYPE(arg) ((enum FType)((arg) & 0xf))
+
+/* Number of instructions used by the arguments of a call */
+#define CALL_SIZE(nargs) (((nargs) + 2) / 3)
+
+/* Translated function */
+typedef struct Proto {
+  Code *code;
+  int ncode;
+  FInterpValue *konst;    /* initial value of the constant registers */
+  int nkonst;
+  int nargs;
+  int nregs;
+  FInterpProfile profile;
+} Proto;
+
+/* Interpreter data */
+typedef struct InterpData {
+  Proto **protos;         /* translated functions (NULL if not called yet) */
+  int nprotos;
+} InterpData;
+
+/* Jump target that must be patched with the start of a block */
+typedef struct Fixup {
+  int pos;
+  int field;
+} Fixup;
+
+VEC_DECLARE(Fixup);
+
+/* Translation state of a function */
+typedef struct Translator {
+  FModule *m;
+  int function;
+  int bblock;                   /* block being translated */
+  int *reg;                     /* register of each value */
+  int *shadow;                  /* shadow register of each phi */
+  int *backedge;                /* back edge flags of the block successors */
+  int *bbstart;                 /* first instruction of each block */
+  int scratch;
+  Vector(Code) code;
+  Vector(FInterpValue) konst;
+  Vector(Fixup) fixups;
+} Translator;
+
+/* Frames bigger than this are allocated in the heap */
+#define NFRAME 64
+
+/* Abort the execution */
+static void fatal(const char *msg, int function) {
+  fprintf(stderr, "fahrenheit interpreter: %s (function %d)\n", msg,
+    function + 1);
+  abort();
+}
+
+/* Obtain the integer width index (0 for 8 bits, 3 for 64 bits) */
+static int width(enum FType type) {
+  switch (type) {
+    case FInt16: return 1;
+    case FInt32: return 2;
+    case FInt64: return 3;
+    default: return 0;
+  }
+}
+
+/* Obtain the opcode of an integer operation given the 8 bits version */
+static int int_op(int op8, enum FType type) {
+  return op8 + width(type) * (OP_ADD16 - OP_ADD8);
+}
+
+/* Obtain the opcode of a float point operation given the float version */
+static int float_op(int opf, enum FType type) {
+  return type == FDouble ? opf + (OP_ADDD - OP_ADDF) : opf;
+}
+
+/* Truncate an integer to the type width */
+static ui64 truncate_int(ui64 value, enum FType type) {
+  switch (type) {
+    case FBool: return value & 1;
+    case FInt8: return value & 0xff;
+    case FInt16: return value & 0xffff;
+    case FInt32: return value & 0xffffffff;
+    default: return value;
+  }
+}
+
+/* Emit an instruction, return its position */
+static int emit(Translator *t, int op, int a, int b, int c) {
+  Code code;
+  code.op = op;
+  code.a = a;
+  code.b = b;
+  code.c = c;
+  vec_push(t->code, code);
+  return vec_size(t->code) - 1;
+}
+
+/* Set the field of an instruction (0 for a, 1 for b and 2 for c) */
+static void set_field(Code *code, int field, int value) {
+  switch (field) {
+    case 0: code->a = value; break;
+    case 1: code->b = value; break;
+    default: code->c = value; break;
+  }
+}
+
+/* Make the field jump to the start of the block */
+static void jump_to(Translator *t, int pos, int field, int bblock) {
+  Fixup fixup;
+  fixup.pos = pos;
+  fixup.field = field;
+  set_field(vec_getref(t->code, pos), field, bblock);
+  vec_push(t->fixups, fixup);
+}
+
+/* Obtain the register of a value */
+static int R(Translator *t, FValue v) {
+  if (f_is_konst(v))
+    return f_konst_index(v);
+  return t->reg[v.id];
+}
+
+/* Obtain the type of a value */
+static enum FType value_type(Translator *t, FValue v) {
+  return f_instr(t->m, t->function, v)->type;
+}
+
+/* Load the register with the sign extension of the integer value
+ * Return the register. */
+static int sign_extend(Translator *t, FValue v) {
+  enum FType type = value_type(t, v);
+  if (type == FInt64)
+    return R(t, v);
+  emit(t, int_op(OP_SEXT8, type), t->scratch, R(t, v), 0);
+  return t->scratch;
+}
+
+/* Emit the moves to the phi shadows of the edge from -> to
+ * Return the number of moves. */
+static int emit_phi_moves(Translator *t, int from, int to, int dry) {
+  FFunction *f = f_get_function(t->m, t->function);
+  int i, k, n = 0;
+  f_bblock_foreach(f, to, i) {
+    FValue v = f_value(i);
+    FInstr *phi = f_instr(t->m, t->function, v);
+    if (phi->tag != FPhi)
+      break;
+    for (k = 0; k < phi->u.phi.ninc; ++k) {
+      FPhiInc *inc = &phi->u.phi.inc[k];
+      if (inc->bb == from) {
+        if (!dry)
+          emit(t, OP_MOV, t->shadow[v.id], R(t, inc->value), 0);
+        n++;
+      }
+    }
+  }
+  return n;
+}
+
+/* Emit the edge from -> to: the phi moves and the jump */
+static void emit_edge(Translator *t, int from, int to, int back) {
+  emit_phi_moves(t, from, to, 0);
+  jump_to(t, emit(t, back ? OP_LOOP : OP_JMP, 0, 0, 0), 0, to);
+}
+
+/* Translate a branch of jmpif */
+static void translate_branch(Translator *t, int pos, int field, int from,
+    int to, int back) {
+  if (!back && emit_phi_moves(t, from, to, 1) == 0) {
+    jump_to(t, pos, field, to);
+  } else {
+    set_field(vec_getref(t->code, pos), field, vec_size(t->code));
+    emit_edge(t, from, to, back);
+  }
+}
+
+/* Translate a cast */
+static void translate_cast(Translator *t, int dst, FInstr *i) {
+  FValue val = i->u.cast.val;
+  enum FType from = value_type(t, val);
+  enum FType to = i->type;
+  int src = R(t, val);
+  switch (i->u.cast.op) {
+    case FUIntCast:
+      if (width(to) < width(from))
+        emit(t, int_op(OP_TRUNC8, to), dst, src, 0);
+      else
+        emit(t, OP_MOV, dst, src, 0);
+      break;
+    case FSIntCast:
+      src = sign_extend(t, val);
+      if (to != FInt64)
+        emit(t, int_op(OP_TRUNC8, to), dst, src, 0);
+      else
+        emit(t, OP_MOV, dst, src, 0);
+      break;
+    case FFloatCast:
+      if (from == to)
+        emit(t, OP_MOV, dst, src, 0);
+      else
+        emit(t, from == FFloat ? OP_FTOD : OP_DTOF, dst, src, 0);
+      break;
+    case FFloatToUInt:
+    case FFloatToSInt:
+      emit(t, float_op(i->u.cast.op == FFloatToUInt ? OP_TOUF : OP_TOSF,
+        from), dst, src, 0);
+      if (to != FInt64)
+        emit(t, int_op(OP_TRUNC8, to), dst, dst, 0);
+      break;
+    case FUIntToFloat:
+      emit(t, float_op(OP_FROMUF, to), dst, src, 0);
+      break;
+    case FSIntToFloat:
+      src = sign_extend(t, val);
+      emit(t, float_op(OP_FROMSF, to), dst, src, 0);
+      break;
+  }
+}
+
+/* Emit an operation evaluated by eval.c */
+static void emit_eval(Translator *t, int dst, enum EvalFunc func, int op,
+    enum FType type, int a, int b, int c) {
+  emit(t, OP_EVAL, dst, ARG_ENCODE(op, type), func);
+  emit(t, 0, a, b, c);
+}
+
+/* Translate a binary operation */
+static void translate_binop(Translator *t, int dst, FInstr *i) {
+  int lhs = R(t, i->u.binop.lhs);
+  int rhs = R(t, i->u.binop.rhs);
+  int op;
+  if (i->u.binop.op >= FMin && i->u.binop.op <= FRotr) {
+    emit_eval(t, dst, EvalBinop, i->u.binop.op, i->type, lhs, rhs, 0);
+    return;
+  }
+  if (f_is_float(i->type)) {
+    op = float_op(OP_ADDF + (i->u.binop.op - FAdd), i->type);
+  } else {
+    switch (i->u.binop.op) {
+      case FAdd: op = int_op(OP_ADD8, i->type); break;
+      case FSub: op = int_op(OP_SUB8, i->type); break;
+      case FMul: op = int_op(OP_MUL8, i->type); break;
+      case FDiv: op = int_op(OP_DIV8, i->type); break;
+      case FShl: op = int_op(OP_SHL8, i->type); break;
+      case FSRem: op = int_op(OP_SREM8, i->type); break;
+      case FAShr: op = int_op(OP_SAR8, i->type); break;
+      case FUDiv: op = OP_UDIV; break;
+      case FRem: op = OP_REM; break;
+      case FShr: op = OP_SHR; break;
+      case FAnd: op = OP_AND; break;
+      case FOr: op = OP_OR; break;
+      default: op = OP_XOR; break;
+    }
+  }
+  emit(t, op, dst, lhs, rhs);
+}
+
+/* Translate an integer comparison */
+static void translate_intcmp(Translator *t, int dst, FInstr *i) {
+  int lhs = R(t, i->u.intcmp.lhs);
+  int rhs = R(t, i->u.intcmp.rhs);
+  enum FType type = value_type(t, i->u.intcmp.lhs);
+  int ptr = type == FPointer;
+  switch (i->u.intcmp.op) {
+    case FIntEq: emit(t, ptr ? OP_EQP : OP_EQ, dst, lhs, rhs); break;
+    case FIntNe: emit(t, ptr ? OP_NEP : OP_NE, dst, lhs, rhs); break;
+    case FIntSLe: emit(t, int_op(OP_SLE8, type), dst, lhs, rhs); break;
+    case FIntSLt: emit(t, int_op(OP_SLT8, type), dst, lhs, rhs); break;
+    case FIntSGe: emit(t, int_op(OP_SLE8, type), dst, rhs, lhs); break;
+    case FIntSGt: emit(t, int_op(OP_SLT8, type), dst, rhs, lhs); break;
+    case FIntULe: emit(t, OP_ULE, dst, lhs, rhs); break;
+    case FIntULt: emit(t, OP_ULT, dst, lhs, rhs); break;
+    case FIntUGe: emit(t, OP_ULE, dst, rhs, lhs); break;
+    case FIntUGt: emit(t, OP_ULT, dst, rhs, lhs); break;
+  }
+}
+
+/* Translate a float point comparison */
+static void translate_fpcmp(Translator *t, int dst, FInstr *i) {
+  int lhs = R(t, i->u.fpcmp.lhs);
+  int rhs = R(t, i->u.fpcmp.rhs);
+  enum FType type = value_type(t, i->u.fpcmp.lhs);
+  switch (i->u.fpcmp.op) {
+    case FFpOEq: emit(t, float_op(OP_OEQF, type), dst, lhs, rhs); break;
+    case FFpONe: emit(t, float_op(OP_ONEF, type), dst, lhs, rhs); break;
+    case FFpOLe: emit(t, float_op(OP_OLEF, type), dst, lhs, rhs); break;
+    case FFpOLt: emit(t, float_op(OP_OLTF, type), dst, lhs, rhs); break;
+    case FFpOGe: emit(t, float_op(OP_OLEF, type), dst, rhs, lhs); break;
+    case FFpOGt: emit(t, float_op(OP_OLTF, type), dst, rhs, lhs); break;
+    case FFpUEq: emit(t, float_op(OP_UEQF, type), dst, lhs, rhs); break;
+    case FFpUNe: emit(t, float_op(OP_UNEF, type), dst, lhs, rhs); break;
+    case FFpULe: emit(t, float_op(OP_ULEF, type), dst, lhs, rhs); break;
+    case FFpULt: emit(t, float_op(OP_ULTF, type), dst, lhs, rhs); break;
+    case FFpUGe: emit(t, float_op(OP_ULEF, type), dst, rhs, lhs); break;
+    case FFpUGt: emit(t, float_op(OP_ULTF, type), dst, rhs, lhs); break;
+  }
+}
+
+/* Verify if the native call is supported by call_native */
+static int native_supported(FModule *m, int function, FInstr *call) {
+  FFunctionType *ftype = f_get_ftype_by_function(m, function);
+  int a, nint = 0, nfloat = 0;
+  for (a = 0; a < call->u.call.nargs; ++a) {
+    enum FType type = f_instr(m, function, call->u.call.args[a])->type;
+    if (f_is_float(type))
+      nfloat++;
+    else
+      nint++;
+  }
+#if defined(__x86_64__) && !defined(_WIN32)
+  (void)ftype;
+  return nint <= 6 && nfloat <= 8;
+#else
+  return nint <= 6 && nfloat == 0 && !ftype->vararg &&
+    !f_is_float(ftype->ret);
+#endif
+}
+
+/* Translate a checked operation, its value is the wrapped result */
+static void translate_checked(Translator *t, int dst, FInstr *i) {
+  static const enum FBinopTag ops[] = {FAdd, FAdd, FSub, FSub, FMul, FMul};
+  FInstr binop;
+  binop.type = i->type;
+  binop.tag = FBinop;
+  binop.u.binop.op = ops[i->u.checked.op];
+  binop.u.binop.lhs = i->u.checked.lhs;
+  binop.u.binop.rhs = i->u.checked.rhs;
+  translate_binop(t, dst, &binop);
+}
+
+/* Translate a call */
+static void translate_call(Translator *t, int dst, FInstr *i) {
+  int callee = i->u.call.function;
+  int nargs = i->u.call.nargs;
+  int a, pos = 0;
+  int op = OP_CALL;
+  if (f_get_function(t->m, callee)->tag == FExtFunc)
+    op = OP_CALLEXT;
+  emit(t, op, dst, callee, nargs);
+  for (a = 0; a < nargs; ++a) {
+    FValue arg = i->u.call.args[a];
+    int value = ARG_ENCODE(R(t, arg), value_type(t, arg));
+    if (a % 3 == 0)
+      pos = emit(t, 0, 0, 0, 0);
+    set_field(vec_getref(t->code, pos), a % 3, value);
+  }
+}
+
+/* Translate an instruction */
+static void translate_instr(Translator *t, FValue v, int *bbnext) {
+  FInstr *i = f_instr(t->m, t->function, v);
+  int dst = t->reg[v.id];
+  int bb = t->bblock;
+  switch (i->tag) {
+    case FKonst:
+    case FGetarg:
+      break;
+    case FLoad: {
+      int op;
+      if (i->u.load.order != FNotAtomic) {
+        emit(t, OP_ALOAD, dst, R(t, i->u.load.addr),
+          ARG_ENCODE(i->u.load.order, i->type));
+        break;
+      }
+      switch (i->type) {
+        case FBool: op = OP_LOADB; break;
+        case FInt8: op = OP_LOAD8; break;
+        case FInt16: op = OP_LOAD16; break;
+        case FInt32: op = OP_LOAD32; break;
+        case FInt64: op = OP_LOAD64; break;
+        case FFloat: op = OP_LOADF; break;
+        case FDouble: op = OP_LOADD; break;
+        default: op = OP_LOADP; break;
+      }
+      emit(t, op, dst, R(t, i->u.load.addr), 0);
+      break;
+    }
+    case FStore: {
+      int op;
+      if (i->u.store.order != FNotAtomic) {
+        emit(t, OP_ASTORE, R(t, i->u.store.addr), R(t, i->u.store.val),
+          ARG_ENCODE(i->u.store.order, value_type(t, i->u.store.val)));
+        break;
+      }
+      switch (value_type(t, i->u.store.val)) {
+        case FBool:
+        case FInt8: op = OP_STORE8; break;
+        case FInt16: op = OP_STORE16; break;
+        case FInt32: op = OP_STORE32; break;
+        case FInt64: op = OP_STORE64; break;
+        case FFloat: op = OP_STOREF; break;
+        case FDouble: op = OP_STORED; break;
+        default: op = OP_STOREP; break;
+      }
+      emit(t, op, R(t, i->u.store.addr), R(t, i->u.store.val), 0);
+      break;
+    }
+    case FMemcpy:
+    case FMemmove:
+      emit(t, i->tag == FMemcpy ? OP_MEMCPY : OP_MEMMOVE,
+        R(t, i->u.copy.dst), R(t, i->u.copy.src), R(t, i->u.copy.size));
+      break;
+    case FMemset:
+      emit(t, OP_MEMSET, R(t, i->u.fill.dst), R(t, i->u.fill.val),
+        R(t, i->u.fill.size));
+      break;
+    case FPrefetch:
+      /* Prefetching is only a hint */
+      break;
+    case FAlloca:
+      if (f_null(i->u.alloca.dynsize))
+        emit(t, OP_ALLOCA, dst, i->u.alloca.size, i->u.alloca.align);
+      else
+        emit(t, OP_ALLOCAV, dst, R(t, i->u.alloca.dynsize),
+          i->u.alloca.align);
+      break;
+    case FAtomicRmw:
+      emit(t, OP_ARMW, dst, ARG_ENCODE(i->u.atomic.order, i->type),
+        i->u.atomic.op);
+      emit(t, 0, R(t, i->u.atomic.addr), R(t, i->u.atomic.val), 0);
+      break;
+    case FCmpxchg:
+      emit(t, OP_CMPXCHG, dst, ARG_ENCODE(i->u.cmpxchg.order, i->type), 0);
+      emit(t, 0, R(t, i->u.cmpxchg.addr), R(t, i->u.cmpxchg.cmp),
+        R(t, i->u.cmpxchg.val));
+      break;
+    case FFence:
+      emit(t, OP_FENCE, i->u.fence.order, 0, 0);
+      break;
+    case FUnop:
+      emit_eval(t, dst, EvalUnop, i->u.unop.op, i->type, R(t, i->u.unop.val),
+        0, 0);
+      break;
+    case FTernop:
+      emit_eval(t, dst, EvalTernop, i->u.ternop.op, i->type,
+        R(t, i->u.ternop.a), R(t, i->u.ternop.b), R(t, i->u.ternop.c));
+      break;
+    case FChecked:
+      translate_checked(t, dst, i);
+      break;
+    case FOverflowed: {
+      /* Evaluated again from the operands of the checked operation */
+      FInstr *checked = f_instr(t->m, t->function, i->u.overflowed.checked);
+      emit_eval(t, dst, EvalOverflow, checked->u.checked.op, checked->type,
+        R(t, checked->u.checked.lhs), R(t, checked->u.checked.rhs), 0);
+      break;
+    }
+    case FOffset: {
+      int offset = sign_extend(t, i->u.offset.offset);
+      emit(t, i->u.offset.negative ? OP_SUBP : OP_ADDP, dst,
+        R(t, i->u.offset.addr), offset);
+      break;
+    }
+    case FCast:
+      translate_cast(t, dst, i);
+      break;
+    case FBinop:
+      translate_binop(t, dst, i);
+      break;
+    case FIntCmp:
+      translate_intcmp(t, dst, i);
+      break;
+    case FFpCmp:
+      translate_fpcmp(t, dst, i);
+      break;
+    case FJmpIf: {
+      int pos = emit(t, OP_JMPIF, R(t, i->u.jmpif.cond), 0, 0);
+      translate_branch(t, pos, 1, bb, i->u.jmpif.truebr,
+        t->backedge[bb] & 1);
+      translate_branch(t, pos, 2, bb, i->u.jmpif.falsebr,
+        t->backedge[bb] & 2);
+      break;
+    }
+    case FJmp:
+      /* Fall through when possible */
+      if (i->u.jmp.dest == *bbnext && !t->backedge[bb] &&
+          emit_phi_moves(t, bb, *bbnext, 1) == 0)
+        break;
+      emit_edge(t, bb, i->u.jmp.dest, t->backedge[bb]);
+      break;
+    case FSelect:
+      emit(t, OP_MOV, dst, R(t, i->u.select.falsev), 0);
+      emit(t, OP_CMOV, dst, R(t, i->u.select.cond),
+        R(t, i->u.select.truev));
+      break;
+    case FRet:
+      if (f_null(i->u.ret.val))
+        emit(t, OP_RETV, 0, 0, 0);
+      else
+        emit(t, OP_RET, R(t, i->u.ret.val), 0, 0);
+      break;
+    case FCall:
+      translate_call(t, i->type == FVoid ? t->scratch : dst, i);
+      break;
+    case FPhi:
+      emit(t, OP_MOV, dst, t->shadow[v.id], 0);
+      break;
+    case FSplat:
+    case FExtract:
+    case FInsert:
+    case FShuffle:
+    case FReduce:
+      /* Vector values are rejected by get_proto */
+      break;
+  }
+}
+
+/* Obtain the initial value of a constant */
+static FInterpValue konst_value(FInstr *i) {
+  FInterpValue value;
+  value.i = 0;
+  switch (i->type) {
+    case FFloat: value.f = (float)i->u.konst.f; break;
+    case FDouble: value.d = i->u.konst.f; break;
+    case FPointer: value.p = i->u.konst.p; break;
+    default: value.i = truncate_int(i->u.konst.i, i->type); break;
+  }
+  return value;
+}
+
+/* Translate a module function into bytecode */
+static Proto *translate(FModule *m, int function) {
+  Translator t;
+  Proto *p = mem_newarray(Proto, 1);
+  FFunction *f = f_get_function(m, function);
+  FFunctionType *ftype = f_get_ftype(m, f->type);
+  int nblocks = f->u.body.nbblocks;
+  int nvalues = f->u.body.ninstrs, nregs, bb, i;
+  t.m = m;
+  t.function = function;
+  t.backedge = mem_newarray(int, nblocks);
+  t.bbstart = mem_newarray(int, nblocks);
+  vec_init(t.code);
+  vec_init(t.konst);
+  vec_init(t.fixups);
+  t.reg = mem_newarray(int, nvalues);
+  t.shadow = mem_newarray(int, nvalues);
+  /* Assign the registers: the constants come first, then the arguments */
+  for (i = 0; i < f->u.body.nkonsts; ++i)
+    vec_push(t.konst, konst_value(&f->u.body.konsts[i]));
+  nregs = vec_size(t.konst) + ftype->nargs;
+  for (i = 0; i < nvalues; ++i) {
+    FInstr *instr = &f->u.body.instrs[i];
+    if (instr->tag == FGetarg)
+      t.reg[i] = vec_size(t.konst) + instr->u.getarg.n;
+    else
+      t.reg[i] = nregs++;
+    if (instr->tag == FPhi)
+      t.shadow[i] = nregs++;
+  }
+  t.scratch = nregs++;
+  /* Emit the code */
+  f_find_backedges(m, function, t.backedge);
+  for (bb = 0; bb < nblocks; ++bb) {
+    int bbnext = bb + 1;
+    t.bblock = bb;
+    t.bbstart[bb] = vec_size(t.code);
+    f_bblock_foreach(f, bb, i)
+      translate_instr(&t, f_value(i), &bbnext);
+  }
+  vec_foreach(t.fixups, fixup, {
+    Code *code = vec_getref(t.code, fixup->pos);
+    int bblock = fixup->field == 0 ? code->a :
+                 fixup->field == 1 ? code->b : code->c;
+    set_field(code, fixup->field, t.bbstart[bblock]);
+  });
+  /* Move the arrays to the prototype */
+  p->ncode = vec_size(t.code);
+  p->code = mem_newarray(Code, p->ncode);
+  memcpy(p->code, t.code.data, p->ncode * sizeof(Code));
+  p->nkonst = vec_size(t.konst);
+  p->konst = p->nkonst ? mem_newarray(FInterpValue, p->nkonst) : NULL;
+  if (p->nkonst)
+    memcpy(p->konst, t.konst.data, p->nkonst * sizeof(FInterpValue));
+  p->nargs = ftype->nargs;
+  p->nregs = nregs;
+  p->profile.calls = 0;
+  p->profile.backedges = 0;
+  vec_close(t.code);
+  vec_close(t.konst);
+  vec_close(t.fixups);
+  mem_deletearray(t.backedge, nblocks);
+  mem_deletearray(t.bbstart, nblocks);
+  mem_deletearray(t.reg, nvalues);
+  mem_deletearray(t.shadow, nvalues);
+  return p;
+}
+
+/* Release a prototype */
+static void delete_proto(Proto *p) {
+  mem_deletearray(p->code, p->ncode);
+  if (p->nkonst)
+    mem_deletearray(p->konst, p->nkonst);
+  mem_deletearray(p, 1);
+}
+
+/* Check if the module function can be translated
+ * Return the error message or NULL if it is supported. */
+static const char *unsupported(FModule *m, int function) {
+  FFunction *f = f_get_function(m, function);
+  int i;
+  for (i = 0; i < f->u.body.nkonsts; ++i)
+    if (f_is_vec(f->u.body.konsts[i].type))
+      return "vector types are not supported";
+  for (i = 0; i < f->u.body.ninstrs; ++i) {
+    FInstr *instr = &f->u.body.instrs[i];
+    if (f_is_vec(instr->type))
+      return "vector types are not supported";
+    if (instr->tag == FCall &&
+        f_get_function(m, instr->u.call.function)->tag == FExtFunc &&
+        !native_supported(m, function, instr))
+      return "unsupported external function signature";
+  }
+  return NULL;
+}
+
+/* Obtain the prototype of a module function, translating it if needed */
+static Proto *get_proto(FInterp *it, int function) {
+  InterpData *data = it->data;
+  int nfuncs = it->module->nfunctions;
+  if (data->nprotos < nfuncs) {
+    int i;
+    data->protos = mem_alloc(data->protos, data->nprotos * sizeof(Proto *),
+      nfuncs * sizeof(Proto *));
+    for (i = data->nprotos; i < nfuncs; ++i)
+      data->protos[i] = NULL;
+    data->nprotos = nfuncs;
+  }
+  if (!data->protos[function]) {
+    const char *msg = unsupported(it->module, function);
+    if (msg)
+      fatal(msg, function);
+    data->protos[function] = translate(it->module, function);
+  }
+  return data->protos[function];
+}
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+/* The SysV ABI passes the integer and the float point arguments in separate
+ * register sequences, so any function with up to 6 integer and 8 float point
+ * arguments can be called through a prototype that fills all of them. The
+ * variadic prototype makes the caller set al, as variadic callees expect. */
+typedef ui64 (*IntCall)(ui64, ui64, ui64, ui64, ui64, ui64, ...);
+typedef double (*FloatCall)(ui64, ui64, ui64, ui64, ui64, ui64, ...);
+
+/* Call an external function */
+static FInterpValue call_native(FFunctionPtr ptr, enum FType ret, int nargs,
+    const enum FType *types, const FInterpValue *args) {
+  ui64 i[6] = {0, 0, 0, 0, 0, 0};
+  double d[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  int a, ni = 0, nd = 0;
+  FInterpValue result;
+  for (a = 0; a < nargs; ++a) {
+    if (types[a] == FFloat) {
+      /* The callee reads the low bits of the register */
+      FInterpValue u;
+      u.d = 0;
+      u.f = args[a].f;
+      d[nd++] = u.d;
+    } else if (types[a] == FDouble) {
+      d[nd++] = args[a].d;
+    } else if (types[a] == FPointer) {
+      i[ni++] = (ui64)(size_t)args[a].p;
+    } else {
+      i[ni++] = args[a].i;
+    }
+  }
+  if (f_is_float(ret)) {
+    result.d = ((FloatCall)ptr)(i[0], i[1], i[2], i[3], i[4], i[5],
+      d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7]);
+  } else {
+    ui64 value = ((IntCall)ptr)(i[0], i[1], i[2], i[3], i[4], i[5],
+      d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7]);
+    if (ret == FPointer)
+      result.p = (void *)(size_t)value;
+    else
+      result.i = truncate_int(value, ret);
+  }
+  return result;
+}
+
+#else
+
+/* Only integer and pointer arguments are supported by the generic call */
+typedef ui64 (*IntCall)(ui64, ui64, ui64, ui64, ui64, ui64);
+
+/* Call an external function */
+static FInterpValue call_native(FFunctionPtr ptr, enum FType ret, int nargs,
+    const enum FType *types, const FInterpValue *args) {
+  ui64 i[6] = {0, 0, 0, 0, 0, 0};
+  int a;
+  ui64 value;
+  FInterpValue result;
+  for (a = 0; a < nargs; ++a)
+    i[a] = types[a] == FPointer ? (ui64)(size_t)args[a].p : args[a].i;
+  value = ((IntCall)ptr)(i[0], i[1], i[2], i[3], i[4], i[5]);
+  if (ret == FPointer)
+    result.p = (void *)(size_t)value;
+  else
+    result.i = truncate_int(value, ret);
+  return result;
+}
+
+#endif
+
+/* Obtain the raw bits of a register (see eval.h) */
+static ui64 value_bits(FInterpValue v, enum FType type) {
+  ui32 fbits;
+  ui64 bits;
+  switch (type) {
+    case FFloat:
+      memcpy(&fbits, &v.f, sizeof(fbits));
+      return fbits;
+    case FDouble:
+      memcpy(&bits, &v.d, sizeof(bits));
+      return bits;
+    default:
+      return v.i;
+  }
+}
+
+/* Execute an evaluation instruction */
+static void eval(const Code *pc, FInterpValue *r) {
+  const Code *args = pc + 1;
+  int op = ARG_REG(pc->b);
+  enum FType type = ARG_TYPE(pc->b);
+  ui64 a = value_bits(r[args->a], type);
+  ui64 b = value_bits(r[args->b], type);
+  ui64 c = value_bits(r[args->c], type);
+  ui64 bits;
+  FInterpValue result;
+  switch (pc->c) {
+    case EvalUnop: bits = f_eval_unop(op, type, a); break;
+    case EvalBinop: bits = f_eval_binop(op, type, a, b); break;
+    case EvalTernop: bits = f_eval_ternop(op, type, a, b, c); break;
+    default: bits = f_eval_overflow(op, type, a, b); break;
+  }
+  if (type == FFloat) {
+    ui32 fbits = (ui32)bits;
+    memcpy(&result.f, &fbits, sizeof(fbits));
+  } else if (type == FDouble) {
+    memcpy(&result.d, &bits, sizeof(bits));
+  } else {
+    result.i = bits;
+  }
+  r[pc->a] = result;
+}
+
+/* Convert an ordering to the memory order of the atomic builtins */
+static int memorder(enum FOrdering order) {
+  switch (order) {
+    case FRelaxed: return __ATOMIC_RELAXED;
+    case FAcquire: return __ATOMIC_ACQUIRE;
+    case FRelease: return __ATOMIC_RELEASE;
+    case FAcqRel: return __ATOMIC_ACQ_REL;
+    default: return __ATOMIC_SEQ_CST;
+  }
+}
+
+/* Run the statement with p pointing to the integer of the type at addr */
+#define ATOMIC_INT(type, addr, stmt) \
+  switch (type) { \
+    case FInt8: { ui8 *p = (ui8 *)(addr); stmt; break; } \
+    case FInt16: { ui16 *p = (ui16 *)(addr); stmt; break; } \
+    case FInt32: { ui32 *p = (ui32 *)(addr); stmt; break; } \
+    default: { ui64 *p = (ui64 *)(addr); stmt; break; } \
+  }
+
+/* Execute an atomic load */
+static FInterpValue atomic_load(void *addr, int arg) {
+  int order = memorder((enum FOrdering)ARG_REG(arg));
+  FInterpValue result;
+  if (ARG_TYPE(arg) == FPointer)
+    result.p = __atomic_load_n((void **)addr, order);
+  else
+    ATOMIC_INT(ARG_TYPE(arg), addr, result.i = __atomic_load_n(p, order))
+  return result;
+}
+
+/* Execute an atomic store */
+static void atomic_store(void *addr, FInterpValue val, int arg) {
+  int order = memorder((enum FOrdering)ARG_REG(arg));
+  if (ARG_TYPE(arg) == FPointer)
+    __atomic_store_n((void **)addr, val.p, order);
+  else
+    ATOMIC_INT(ARG_TYPE(arg), addr, __atomic_store_n(p, val.i, order))
+}
+
+/* Compare and exchange the integer (or pointer bits) at the address
+ * Return the value that was in memory. The ordering of a failure is the
+ * strongest one allowed for a load (see f_cmpxchg). */
+static ui64 compare_exchange(void *addr, enum FType type, ui64 cmp, ui64 val,
+    enum FOrdering order) {
+  int success = memorder(order);
+  int failure = order == FRelease ? __ATOMIC_RELAXED :
+                order == FAcqRel ? __ATOMIC_ACQUIRE : success;
+  switch (type) {
+    case FInt8: {
+      ui8 old = (ui8)cmp;
+      __atomic_compare_exchange_n((ui8 *)addr, &old, (ui8)val, 0, success,
+        failure);
+      return old;
+    }
+    case FInt16: {
+      ui16 old = (ui16)cmp;
+      __atomic_compare_exchange_n((ui16 *)addr, &old, (ui16)val, 0, success,
+        failure);
+      return old;
+    }
+    case FInt32: {
+      ui32 old = (ui32)cmp;
+      __atomic_compare_exchange_n((ui32 *)addr, &old, (ui32)val, 0, success,
+        failure);
+      return old;
+    }
+    case FPointer: {
+      void *old = (void *)(size_t)cmp;
+      __atomic_compare_exchange_n((void **)addr, &old, (void *)(size_t)val,
+        0, success, failure);
+      return (ui64)(size_t)old;
+    }
+    default: {
+      ui64 old = cmp;
+      __atomic_compare_exchange_n((ui64 *)addr, &old, val, 0, success,
+        failure);
+      return old;
+    }
+  }
+}
+
+/* Execute the atomic read-modify-write instruction
+ * Min and max don't have builtins, so they retry a compare and exchange. */
+static void atomic_rmw(const Code *pc, FInterpValue *r) {
+  static const enum FBinopTag minmax[] = {FMin, FMax, FUMin, FUMax};
+  enum FAtomicTag op = (enum FAtomicTag)pc->c;
+  enum FOrdering ordering = (enum FOrdering)ARG_REG(pc->b);
+  enum FType type = ARG_TYPE(pc->b);
+  int order = memorder(ordering);
+  void *addr = r[pc[1].a].p;
+  ui64 val = r[pc[1].b].i, old = 0, seen;
+  switch (op) {
+    case FAtomicXchg:
+      ATOMIC_INT(type, addr, old = __atomic_exchange_n(p, val, order))
+      break;
+    case FAtomicAdd:
+      ATOMIC_INT(type, addr, old = __atomic_fetch_add(p, val, order))
+      break;
+    case FAtomicSub:
+      ATOMIC_INT(type, addr, old = __atomic_fetch_sub(p, val, order))
+      break;
+    case FAtomicAnd:
+      ATOMIC_INT(type, addr, old = __atomic_fetch_and(p, val, order))
+      break;
+    case FAtomicOr:
+      ATOMIC_INT(type, addr, old = __atomic_fetch_or(p, val, order))
+      break;
+    case FAtomicXor:
+      ATOMIC_INT(type, addr, old = __atomic_fetch_xor(p, val, order))
+      break;
+    default:
+      ATOMIC_INT(type, addr, old = __atomic_load_n(p, __ATOMIC_RELAXED))
+      for (;;) {
+        ui64 result = f_eval_binop(minmax[op - FAtomicMin], type, old, val);
+        seen = compare_exchange(addr, type, old, result, ordering);
+        if (seen == old)
+          break;
+        old = seen;
+      }
+      break;
+  }
+  r[pc->a].i = old;
+}
+
+/* Execute the compare and exchange instruction */
+static void cmpxchg(const Code *pc, FInterpValue *r) {
+  enum FType type = ARG_TYPE(pc->b);
+  const Code *args = pc + 1;
+  ui64 cmp, val, old;
+  if (type == FPointer) {
+    cmp = (ui64)(size_t)r[args->b].p;
+    val = (ui64)(size_t)r[args->c].p;
+  } else {
+    cmp = r[args->b].i;
+    val = r[args->c].i;
+  }
+  old = compare_exchange(r[args->a].p, type, cmp, val,
+    (enum FOrdering)ARG_REG(pc->b));
+  if (type == FPointer)
+    r[pc->a].p = (void *)(size_t)old;
+  else
+    r[pc->a].i = old;
+}
+
+static FInterpValue execute(FInterp *it, Proto *p, const FInterpValue *args);
+
+/* Memory of the alloca instructions, released when the function returns */
+typedef struct Alloca {
+  struct Alloca *prev;
+  size_t size;
+} Alloca;
+
+/* Allocate the memory of an alloca instruction */
+static void *stack_alloc(Alloca **allocas, ui64 size, int align) {
+  size_t total;
+  Alloca *a;
+  if (align < 16) align = 16;
+  total = sizeof(Alloca) + align + (size_t)size;
+  a = mem_alloc(NULL, 0, total);
+  a->prev = *allocas;
+  a->size = total;
+  *allocas = a;
+  return (void *)(((size_t)(a + 1) + align - 1) & ~(size_t)(align - 1));
+}
+
+/* Release the memory of the alloca instructions */
+static void stack_free(Alloca *allocas) {
+  while (allocas) {
+    Alloca *prev = allocas->prev;
+    mem_alloc(allocas, allocas->size, 0);
+    allocas = prev;
+  }
+}
+
+/* Number of arguments passed without allocating memory */
+#define NARGS 16
+
+/* Execute the call instruction */
+static void call(FInterp *it, const Code *pc, FInterpValue *r) {
+  FInterpValue local[NARGS], *args = local;
+  enum FType localtypes[NARGS], *types = localtypes;
+  int nargs = pc->c;
+  int a;
+  if (nargs > NARGS) {
+    args = mem_newarray(FInterpValue, nargs);
+    types = mem_newarray(enum FType, nargs);
+  }
+  for (a = 0; a < nargs; ++a) {
+    const Code *code = pc + 1 + a / 3;
+    int arg = a % 3 == 0 ? code->a : a % 3 == 1 ? code->b : code->c;
+    args[a] = r[ARG_REG(arg)];
+    types[a] = ARG_TYPE(arg);
+  }
+  if (pc->op == OP_CALL) {
+    r[pc->a] = execute(it, get_proto(it, pc->b), args);
+  } else {
+    FFunction *f = f_get_function(it->module, pc->b);
+    FFunctionType *ftype = f_get_ftype(it->module, f->type);
+    r[pc->a] = call_native(f->u.ptr, ftype->ret, nargs, types, args);
+  }
+  if (nargs > NARGS) {
+    mem_deletearray(args, nargs);
+    mem_deletearray(types, nargs);
+  }
+}
+
+/* Integer operations over the zero extended registers */
+#define T8(x) ((x) & 0xff)
+#define T16(x) ((x) & 0xffff)
+#define T32(x) ((x) & 0xffffffff)
+#define T64(x) (x)
+#define S8(x) ((i64)((T8(x) ^ 0x80) - 0x80))
+#define S16(x) ((i64)((T16(x) ^ 0x8000) - 0x8000))
+#define S32(x) ((i64)((T32(x) ^ 0x80000000) - 0x80000000))
+#define S64(x) ((i64)(x))
+
+/* Arithmetic shift right (the signed shift is implementation defined) */
+#define SAR(x, n) ((x) < 0 ? ~(~(ui64)(x) >> (n)) : (ui64)(x) >> (n))
+
+/* Register operands of the current instruction */
+#define RA (r[pc->a])
+#define RB (r[pc->b])
+#define RC (r[pc->c])
+
+#ifdef THREADED_DISPATCH
+#define OPCODE_LABEL(op) &&L_##op,
+#define CASE(op) L_##op:
+#define DISPATCH() goto *labels[pc->op]
+#else
+#define CASE(op) case OP_##op:
+#define DISPATCH() goto dispatch
+#endif
+
+/* Go to the next instruction */
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+
+#define INT_HANDLERS(W) \
+  CASE(ADD##W) RA.i = T##W(RB.i + RC.i); NEXT(); \
+  CASE(SUB##W) RA.i = T##W(RB.i - RC.i); NEXT(); \
+  CASE(MUL##W) RA.i = T##W(RB.i * RC.i); NEXT(); \
+  CASE(DIV##W) RA.i = T##W((ui64)(S##W(RB.i) / S##W(RC.i))); NEXT(); \
+  CASE(SHL##W) RA.i = T##W(RB.i << (RC.i & 63)); NEXT(); \
+  CASE(SREM##W) RA.i = T##W((ui64)(S##W(RB.i) % S##W(RC.i))); NEXT(); \
+  CASE(SAR##W) RA.i = T##W(SAR(S##W(RB.i), RC.i & 63)); NEXT(); \
+  CASE(SLT##W) RA.i = S##W(RB.i) < S##W(RC.i); NEXT(); \
+  CASE(SLE##W) RA.i = S##W(RB.i) <= S##W(RC.i); NEXT(); \
+  CASE(SEXT##W) RA.i = (ui64)S##W(RB.i); NEXT(); \
+  CASE(TRUNC##W) RA.i = T##W(RB.i); NEXT();
+
+#define FLOAT_HANDLERS(T, F, C) \
+  CASE(ADD##T) RA.F = RB.F + RC.F; NEXT(); \
+  CASE(SUB##T) RA.F = RB.F - RC.F; NEXT(); \
+  CASE(MUL##T) RA.F = RB.F * RC.F; NEXT(); \
+  CASE(DIV##T) RA.F = RB.F / RC.F; NEXT(); \
+  CASE(OEQ##T) RA.i = RB.F == RC.F; NEXT(); \
+  CASE(ONE##T) RA.i = RB.F < RC.F || RB.F > RC.F; NEXT(); \
+  CASE(OLT##T) RA.i = RB.F < RC.F; NEXT(); \
+  CASE(OLE##T) RA.i = RB.F <= RC.F; NEXT(); \
+  CASE(UEQ##T) RA.i = !(RB.F < RC.F || RB.F > RC.F); NEXT(); \
+  CASE(UNE##T) RA.i = RB.F != RC.F; NEXT(); \
+  CASE(ULT##T) RA.i = !(RB.F >= RC.F); NEXT(); \
+  CASE(ULE##T) RA.i = !(RB.F > RC.F); NEXT(); \
+  CASE(TOU##T) RA.i = (ui64)RB.F; NEXT(); \
+  CASE(TOS##T) RA.i = (ui64)(i64)RB.F; NEXT(); \
+  CASE(FROMU##T) RA.F = (C)RB.i; NEXT(); \
+  CASE(FROMS##T) RA.F = (C)(i64)RB.i; NEXT();
+
+/* Execute a translated function */
+static FInterpValue execute(FInterp *it, Proto *p, const FInterpValue *args) {
+#ifdef THREADED_DISPATCH
+  static const void *const labels[] = { OPCODES(OPCODE_LABEL) NULL };
+#endif
+  FInterpValue frame[NFRAME], *r = frame, ret;
+  const Code *code = p->code, *pc = code;
+  Alloca *allocas = NULL;
+  if (p->nregs > NFRAME)
+    r = mem_newarray(FInterpValue, p->nregs);
+  if (p->nkonst)
+    memcpy(r, p->konst, p->nkonst * sizeof(FInterpValue));
+  if (p->nargs)
+    memcpy(r + p->nkonst, args, p->nargs * sizeof(FInterpValue));
+  p->profile.calls++;
+#ifdef THREADED_DISPATCH
+  DISPATCH();
+#else
+dispatch:
+  switch (pc->op) {
+#endif
+  CASE(MOV) RA = RB; NEXT();
+  CASE(CMOV) if (RB.i) RA = RC; NEXT();
+  CASE(JMP) pc = code + pc->a; DISPATCH();
+  CASE(LOOP) p->profile.backedges++; pc = code + pc->a; DISPATCH();
+  CASE(JMPIF) pc = code + (RA.i ? pc->b : pc->c); DISPATCH();
+  CASE(RET) ret = RA; goto done;
+  CASE(RETV) ret.i = 0; goto done;
+  CASE(CALL)
+  CASE(CALLEXT) call(it, pc, r); pc += 1 + CALL_SIZE(pc->c); DISPATCH();
+  CASE(LOADB) RA.i = *(ui8 *)RB.p & 1; NEXT();
+  CASE(LOAD8) RA.i = *(ui8 *)RB.p; NEXT();
+  CASE(LOAD16) RA.i = *(ui16 *)RB.p; NEXT();
+  CASE(LOAD32) RA.i = *(ui32 *)RB.p; NEXT();
+  CASE(LOAD64) RA.i = *(ui64 *)RB.p; NEXT();
+  CASE(LOADF) RA.f = *(float *)RB.p; NEXT();
+  CASE(LOADD) RA.d = *(double *)RB.p; NEXT();
+  CASE(LOADP) RA.p = *(void **)RB.p; NEXT();
+  CASE(STORE8) *(ui8 *)RA.p = (ui8)RB.i; NEXT();
+  CASE(STORE16) *(ui16 *)RA.p = (ui16)RB.i; NEXT();
+  CASE(STORE32) *(ui32 *)RA.p = (ui32)RB.i; NEXT();
+  CASE(STORE64) *(ui64 *)RA.p = RB.i; NEXT();
+  CASE(STOREF) *(float *)RA.p = RB.f; NEXT();
+  CASE(STORED) *(double *)RA.p = RB.d; NEXT();
+  CASE(STOREP) *(void **)RA.p = RB.p; NEXT();
+  CASE(MEMCPY) memcpy(RA.p, RB.p, (size_t)RC.i); NEXT();
+  CASE(MEMMOVE) memmove(RA.p, RB.p, (size_t)RC.i); NEXT();
+  CASE(MEMSET) memset(RA.p, (int)RB.i, (size_t)RC.i); NEXT();
+  CASE(EVAL) eval(pc, r); pc += 2; DISPATCH();
+  CASE(ALLOCA) RA.p = stack_alloc(&allocas, (ui64)pc->b, pc->c); NEXT();
+  CASE(ALLOCAV) RA.p = stack_alloc(&allocas, RB.i, pc->c); NEXT();
+  CASE(ALOAD) RA = atomic_load(RB.p, pc->c); NEXT();
+  CASE(ASTORE) atomic_store(RA.p, RB, pc->c); NEXT();
+  CASE(ARMW) atomic_rmw(pc, r); pc += 2; DISPATCH();
+  CASE(CMPXCHG) cmpxchg(pc, r); pc += 2; DISPATCH();
+  CASE(FENCE) __atomic_thread_fence(memorder((enum FOrdering)pc->a)); NEXT();
+  CASE(ADDP) RA.p = (char *)RB.p + S64(RC.i); NEXT();
+  CASE(SUBP) RA.p = (char *)RB.p - S64(RC.i); NEXT();
+  CASE(UDIV) RA.i = RB.i / RC.i; NEXT();
+  CASE(REM) RA.i = RB.i % RC.i; NEXT();
+  CASE(SHR) RA.i = RB.i >> (RC.i & 63); NEXT();
+  CASE(AND) RA.i = RB.i & RC.i; NEXT();
+  CASE(OR) RA.i = RB.i | RC.i; NEXT();
+  CASE(XOR) RA.i = RB.i ^ RC.i; NEXT();
+  CASE(EQ) RA.i = RB.i == RC.i; NEXT();
+  CASE(NE) RA.i = RB.i != RC.i; NEXT();
+  CASE(EQP) RA.i = RB.p == RC.p; NEXT();
+  CASE(NEP) RA.i = RB.p != RC.p; NEXT();
+  CASE(ULT) RA.i = RB.i < RC.i; NEXT();
+  CASE(ULE) RA.i = RB.i <= RC.i; NEXT();
+  CASE(FTOD) RA.d = RB.f; NEXT();
+  CASE(DTOF) RA.f = (float)RB.d; NEXT();
+  INT_HANDLERS(8)
+  INT_HANDLERS(16)
+  INT_HANDLERS(32)
+  INT_HANDLERS(64)
+  FLOAT_HANDLERS(F, f, float)
+  FLOAT_HANDLERS(D, d, double)
+#ifndef THREADED_DISPATCH
+  }
+#endif
+done:
+  stack_free(allocas);
+  if (r != frame)
+    mem_deletearray(r, p->nregs);
+  return ret;
+}
+
+void f_init_interp(FInterp *it, FModule *m) {
+  InterpData *data = mem_newarray(InterpData, 1);
+  data->protos = NULL;
+  data->nprotos = 0;
+  it->module = m;
+  it->data = data;
+}
+
+void f_close_interp(FInterp *it) {
+  InterpData *data = it->data;
+  int i;
+  for (i = 0; i < data->nprotos; ++i)
+    if (data->protos[i])
+      delete_proto(data->protos[i]);
+  if (data->nprotos)
+    mem_deletearray(data->protos, data->nprotos);
+  mem_deletearray(data, 1);
+  it->module = NULL;
+  it->data = NULL;
+}
+
+int f_interp_check(FInterp *it, int function) {
+  FModule *m = it->module;
+  int nfuncs = m->nfunctions;
+  int *visited = mem_newarray(int, nfuncs);
+  int *stack = mem_newarray(int, nfuncs);
+  int i, top = 0, status = 0;
+  for (i = 0; i < nfuncs; ++i)
+    visited[i] = 0;
+  visited[function] = 1;
+  stack[top++] = function;
+  while (top > 0 && !status) {
+    int current = stack[--top];
+    FFunction *f = f_get_function(m, current);
+    if (f->tag == FExtFunc) {
+      status = f_get_ftype(m, f->type)->nargs > 6;
+      continue;
+    }
+    if (unsupported(m, current)) {
+      status = 1;
+      continue;
+    }
+    for (i = 0; i < f->u.body.ninstrs; ++i) {
+      FInstr *instr = &f->u.body.instrs[i];
+      if (instr->tag == FCall && !visited[instr->u.call.function] &&
+          f_get_function(m, instr->u.call.function)->tag == FModFunc) {
+        visited[instr->u.call.function] = 1;
+        stack[top++] = instr->u.call.function;
+      }
+    }
+  }
+  mem_deletearray(visited, nfuncs);
+  mem_deletearray(stack, nfuncs);
+  return status;
+}
+
+FInterpValue f_interp_callv(FInterp *it, int function,
+    const FInterpValue *args) {
+  FFunction *f = f_get_function(it->module, function);
+  FFunctionType *ftype = f_get_ftype(it->module, f->type);
+  if (f->tag == FExtFunc) {
+    FInterpValue ret;
+    if (ftype->nargs > 6)
+      fatal("unsupported external function signature", function);
+    ret = call_native(f->u.ptr, ftype->ret, ftype->nargs, ftype->args, args);
+    return ret;
+  }
+  return execute(it, get_proto(it, function), args);
+}
+
+FInterpValue f_interp_call(FInterp *it, int function, ...) {
+  FFunctionType *ftype = f_get_ftype_by_function(it->module, function);
+  FInterpValue local[NARGS], *args = local, ret;
+  va_list ap;
+  int a;
+  if (ftype->nargs > NARGS)
+    args = mem_newarray(FInterpValue, ftype->nargs);
+  va_start(ap, function);
+  for (a = 0; a < ftype->nargs; ++a) {
+    switch (ftype->args[a]) {
+      case FInt64: args[a].i = va_arg(ap, ui64); break;
+      case FFloat: args[a].f = (float)va_arg(ap, double); break;
+      case FDouble: args[a].d = va_arg(ap, double); break;
+      case FPointer: args[a].p = va_arg(ap, void *); break;
+      default:
+        args[a].i = truncate_int(va_arg(ap, unsigned), ftype->args[a]);
+        break;
+    }
+  }
+  va_end(ap);
+  ret = f_interp_callv(it, function, args);
+  if (ftype->nargs > NARGS)
+    mem_deletearray(args, ftype->nargs);
+  return ret;
+}
+
+void f_interp_profile(FInterp *it, int function, FInterpProfile *profile) {
+  InterpData *data = it->data;
+  if (function < data->nprotos && data->protos[function]) {
+    *profile = data->protos[function]->profile;
+  } else {
+    profile->calls = 0;
+    profile->backedges = 0;
+  }
+}
+
+void f_interp_reset_profile(FInterp *it) {
+  InterpData *data = it->data;
+  int i;
+  for (i = 0; i < data->nprotos; ++i) {
+    if (data->protos[i]) {
+      data->protos[i]->profile.calls = 0;
+      data->protos[i]->profile.backedges = 0;
+    }
+  }
+}
@@ -24,46 +24,152 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include <fahrenheit/ir.h>
 
-const FValue FNullValue = {-1, -1};
+/* Default size of the arena chunks */
+#define ARENA_CHUNK 65536
+
+/* Alignment of the arena allocations */
+#define ARENA_ALIGN 16
+
+/* Round the size up to the arena alignment */
+#define arena_size(size) \
+  (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+const FValue FNullValue = {-1};
+
+/* Obtain the first usable byte of a chunk */
+static char *chunk_data(FArenaChunk *c) {
+  return (char *)c + arena_size(sizeof(FArenaChunk));
+}
+
+/* Move the arena to a chunk with at least size bytes
+ * The chunks kept by f_reset_arena are reused when they are big enough. */
+static void next_chunk(FArena *a, size_t size) {
+  FArenaChunk *c = a->current ? a->current->next : a->chunks;
+  while (c && c->size < size)
+    c = c->next;
+  if (!c) {
+    size_t n = size > a->chunksize ? size : a->chunksize;
+    c = mem_alloc(NULL, 0, arena_size(sizeof(FArenaChunk)) + n);
+    c->size = n;
+    if (a->current) {
+      c->next = a->current->next;
+      a->current->next = c;
+    } else {
+      c->next = a->chunks;
+      a->chunks = c;
+    }
+  }
+  a->current = c;
+  a->ptr = chunk_data(c);
+  a->end = a->ptr + c->size;
+}
+
+void f_init_arena(FArena *a, size_t chunksize) {
+  a->chunks = NULL;
+  a->current = NULL;
+  a->ptr = NULL;
+  a->end = NULL;
+  a->chunksize = chunksize ? chunksize : ARENA_CHUNK;
+}
+
+void f_close_arena(FArena *a) {
+  FArenaChunk *c = a->chunks;
+  while (c) {
+    FArenaChunk *next = c->next;
+    mem_alloc(c, arena_size(sizeof(FArenaChunk)) + c->size, 0);
+    c = next;
+  }
+  f_init_arena(a, a->chunksize);
+}
+
+void f_reset_arena(FArena *a) {
+  a->current = NULL;
+  a->ptr = NULL;
+  a->end = NULL;
+}
+
+void *f_arena_alloc(FArena *a, size_t size) {
+  char *p;
+  size = arena_size(size);
+  if (!a->current || size > (size_t)(a->end - a->ptr))
+    next_chunk(a, size);
+  p = a->ptr;
+  a->ptr += size;
+  return p;
+}
+
+void *f_arena_grow(FArena *a, void *p, size_t oldsize, size_t newsize) {
+  void *q;
+  if (newsize <= oldsize)
+    return p;
+  if (p && (char *)p + arena_size(oldsize) == a->ptr &&
+      arena_size(newsize) - arena_size(oldsize) <=
+      (size_t)(a->end - a->ptr)) {
+    a->ptr = (char *)p + arena_size(newsize);
+    return p;
+  }
+  q = f_arena_alloc(a, newsize);
+  if (p)
+    memcpy(q, p, oldsize);
+  return q;
+}
+
+void *f_arena_reserve(FArena *a, void *data, int size, int *capacity,
+    size_t elemsize) {
+  if (size < *capacity)
+    return data;
+  *capacity = *capacity ? 2 * *capacity : 4;
+  return f_arena_grow(a, data, size * elemsize, *capacity * elemsize);
+}
 
 void f_init_module(FModule *m) {
-  vec_init(m->functions);
-  vec_init(m->ftypes);
+  f_init_arena(&m->ownarena, 0);
+  f_init_module_arena(m, &m->ownarena);
+}
+
+void f_init_module_arena(FModule *m, FArena *arena) {
+  m->functions = NULL;
+  m->nfunctions = 0;
+  m->capfunctions = 0;
+  m->ftypes = NULL;
+  m->nftypes = 0;
+  m->capftypes = 0;
+  m->arena = arena;
 }
 
 void f_close_module(FModule *m) {
-  vec_foreach(m->functions, func, {
-    switch (func->tag) {
-      case FExtFunc:
-        break;
-      case FModFunc:
-        vec_foreach(func->u.bblocks, bb, {
-          vec_foreach(*bb, i, {
-            switch (i->tag) {
-              case FPhi:
-                vec_close(i->u.phi.inc);
-                break;
-              case FCall:
-                mem_deletearray(i->u.call.args, i->u.call.nargs);
-                break;
-              default:
-                break;
-            }
-          });
-          vec_close(*bb);
-        });
-        vec_close(func->u.bblocks);
-        break;
-    }
-  });
-  vec_close(m->functions);
-  vec_foreach(m->ftypes, ftype, {
-    mem_deletearray(ftype->args, ftype->nargs);
-  });
-  vec_close(m->ftypes);
+  if (m->arena == &m->ownarena)
+    f_close_arena(&m->ownarena);
+  f_init_module_arena(m, m->arena);
+}
+
+void f_reset_module(FModule *m) {
+  f_reset_arena(m->arena);
+  f_init_module_arena(m, m->arena);
+}
+
+/* Allocate an array in the module arena */
+#define arena_newarray(m, T, n) \
+  ((T *)f_arena_alloc((m)->arena, sizeof(T) * (n)))
+
+/* Add a function type to the module */
+static int add_ftype(FModule *m, FFunctionType *type) {
+  m->ftypes = f_arena_reserve(m->arena, m->ftypes, m->nftypes,
+    &m->capftypes, sizeof(FFunctionType));
+  m->ftypes[m->nftypes] = *type;
+  return m->nftypes++;
+}
+
+/* Add a function to the module */
+static int add_function(FModule *m, FFunction *f) {
+  m->functions = f_arena_reserve(m->arena, m->functions, m->nfunctions,
+    &m->capfunctions, sizeof(FFunction));
+  m->functions[m->nfunctions] = *f;
+  return m->nfunctions++;
 }
 
 int f_ftype(FModule *m, enum FType ret, int nargs, ...) {
@@ -72,27 +178,25 @@ int f_ftype(FModule *m, enum FType ret, int nargs, ...) {
   FFunctionType type;
   va_start(args, nargs);
   type.ret = ret;
-  type.args = mem_newarray(enum FType, nargs);
+  type.args = arena_newarray(m, enum FType, nargs);
   type.nargs = nargs;
   type.vararg = 0;
   for (i = 0; i < nargs; ++i)
     type.args[i] = va_arg(args, enum FType);
   va_end(args);
-  vec_push(m->ftypes, type);
-  return vec_size(m->ftypes) - 1;
+  return add_ftype(m, &type);
 }
 
 int f_ftypev(FModule *m, enum FType ret, int nargs, enum FType *args) {
   int i;
   FFunctionType type;
   type.ret = ret;
-  type.args = mem_newarray(enum FType, nargs);
+  type.args = arena_newarray(m, enum FType, nargs);
   type.nargs = nargs;
   type.vararg = 0;
   for (i = 0; i < nargs; ++i)
     type.args[i] = args[i];
-  vec_push(m->ftypes, type);
-  return vec_size(m->ftypes) - 1;
+  return add_ftype(m, &type);
 }
 
 void f_set_vararg(FModule *m, int ftype) {
@@ -101,7 +205,8 @@ void f_set_vararg(FModule *m, int ftype) {
 }
 
 FFunctionType* f_get_ftype(FModule *m, int ftype) {
-  return vec_getref(m->ftypes, ftype);
+  assert(ftype >= 0 && ftype < m->nftypes);
+  return &m->ftypes[ftype];
 }
 
 FFunctionType* f_get_ftype_by_function(FModule* m, int function) {
@@ -112,37 +217,160 @@ int f_add_function(FModule *m, int ftype) {
   FFunction f;
   f.tag = FModFunc;
   f.type = ftype;
-  vec_init(f.u.bblocks);
-  vec_push(m->functions, f);
-  return vec_size(m->functions) - 1;
+  f.attrs = 0;
+  f.params = NULL;
+  f.u.body.instrs = NULL;
+  f.u.body.ninstrs = 0;
+  f.u.body.capinstrs = 0;
+  f.u.body.konsts = NULL;
+  f.u.body.nkonsts = 0;
+  f.u.body.capkonsts = 0;
+  f.u.body.konstmap = NULL;
+  f.u.body.capkonstmap = 0;
+  f.u.body.firstuse = NULL;
+  f.u.body.capfirstuse = 0;
+  f.u.body.uses = NULL;
+  f.u.body.nuses = 0;
+  f.u.body.capuses = 0;
+  f.u.body.bblocks = NULL;
+  f.u.body.nbblocks = 0;
+  f.u.body.capbblocks = 0;
+  return add_function(m, &f);
 }
 
 int f_add_extfunction(FModule *m, int ftype, FFunctionPtr ptr) {
   FFunction f;
   f.tag = FExtFunc;
   f.type = ftype;
+  f.attrs = 0;
+  f.params = NULL;
   f.u.ptr = ptr;
-  vec_push(m->functions, f);
-  return vec_size(m->functions) - 1;
+  return add_function(m, &f);
+}
+
+/* Copy the arrays referenced by an instruction into the module arena */
+static void copy_instr_arrays(FModule *m, FInstr *instr) {
+  if (instr->tag == FPhi) {
+    FPhiInc *inc = instr->u.phi.inc;
+    instr->u.phi.inc = arena_newarray(m, FPhiInc, instr->u.phi.ninc);
+    instr->u.phi.capacity = instr->u.phi.ninc;
+    if (instr->u.phi.ninc)
+      memcpy(instr->u.phi.inc, inc, instr->u.phi.ninc * sizeof(FPhiInc));
+  } else if (instr->tag == FCall) {
+    FValue *args = instr->u.call.args;
+    instr->u.call.args = arena_newarray(m, FValue, instr->u.call.nargs);
+    if (instr->u.call.nargs)
+      memcpy(instr->u.call.args, args, instr->u.call.nargs * sizeof(FValue));
+  } else if (instr->tag == FShuffle && instr->u.shuffle.mask) {
+    int *mask = instr->u.shuffle.mask;
+    instr->u.shuffle.mask = arena_newarray(m, int, f_lanes(instr->type));
+    memcpy(instr->u.shuffle.mask, mask, f_lanes(instr->type) * sizeof(int));
+  }
+}
+
+int f_copy_function(FModule *dst, FModule *src, int function) {
+  FFunction *f = f_get_function(src, function);
+  FFunctionType *ftype = f_get_ftype(src, f->type);
+  int type = f_ftypev(dst, ftype->ret, ftype->nargs, ftype->args);
+  int copy, a, i;
+  FFunction *to;
+  if (ftype->vararg)
+    f_set_vararg(dst, type);
+  if (f->tag == FExtFunc)
+    copy = f_add_extfunction(dst, type, f->u.ptr);
+  else
+    copy = f_add_function(dst, type);
+  f_set_fattr(dst, copy, f->attrs);
+  if (f->params) {
+    for (a = 0; a < ftype->nargs; ++a) {
+      f_set_argattr(dst, copy, a, f->params[a].attrs);
+      f_set_argalign(dst, copy, a, f->params[a].align);
+    }
+  }
+  if (f->tag == FExtFunc)
+    return copy;
+  /* The value ids are kept, so the blocks are copied as they are */
+  to = f_get_function(dst, copy);
+  to->u.body.ninstrs = to->u.body.capinstrs = f->u.body.ninstrs;
+  to->u.body.instrs = arena_newarray(dst, FInstr, f->u.body.ninstrs);
+  for (i = 0; i < f->u.body.ninstrs; ++i) {
+    to->u.body.instrs[i] = f->u.body.instrs[i];
+    copy_instr_arrays(dst, &to->u.body.instrs[i]);
+  }
+  to->u.body.nkonsts = to->u.body.capkonsts = f->u.body.nkonsts;
+  to->u.body.konsts = arena_newarray(dst, FInstr, f->u.body.nkonsts);
+  for (i = 0; i < f->u.body.nkonsts; ++i)
+    to->u.body.konsts[i] = f->u.body.konsts[i];
+  to->u.body.capkonstmap = f->u.body.capkonstmap;
+  to->u.body.konstmap = arena_newarray(dst, int, f->u.body.capkonstmap);
+  for (i = 0; i < f->u.body.capkonstmap; ++i)
+    to->u.body.konstmap[i] = f->u.body.konstmap[i];
+  to->u.body.capfirstuse = f->u.body.ninstrs;
+  to->u.body.firstuse = arena_newarray(dst, int, f->u.body.ninstrs);
+  for (i = 0; i < f->u.body.ninstrs; ++i)
+    to->u.body.firstuse[i] = f->u.body.firstuse[i];
+  to->u.body.nuses = to->u.body.capuses = f->u.body.nuses;
+  to->u.body.uses = arena_newarray(dst, FUse, f->u.body.nuses);
+  for (i = 0; i < f->u.body.nuses; ++i)
+    to->u.body.uses[i] = f->u.body.uses[i];
+  to->u.body.nbblocks = to->u.body.capbblocks = f->u.body.nbblocks;
+  to->u.body.bblocks = arena_newarray(dst, FBBlock, f->u.body.nbblocks);
+  for (i = 0; i < f->u.body.nbblocks; ++i)
+    to->u.body.bblocks[i] = f->u.body.bblocks[i];
+  return copy;
 }
 
 FFunction *f_get_function(FModule *m, int function) {
-  return vec_getref(m->functions, function);
+  assert(function >= 0 && function < m->nfunctions);
+  return &m->functions[function];
+}
+
+/* Obtain the parameter attributes, they are allocated on the first use */
+static FParamAttr *get_param(FModule *m, int function, int arg) {
+  FFunction *f = f_get_function(m, function);
+  int nargs = f_get_ftype(m, f->type)->nargs;
+  assert(arg >= 0 && arg < nargs);
+  if (!f->params) {
+    int a;
+    f->params = arena_newarray(m, FParamAttr, nargs);
+    for (a = 0; a < nargs; ++a) {
+      f->params[a].attrs = 0;
+      f->params[a].align = 0;
+    }
+  }
+  return &f->params[arg];
+}
+
+void f_set_fattr(FModule *m, int function, int attrs) {
+  f_get_function(m, function)->attrs |= attrs;
+}
+
+void f_set_argattr(FModule *m, int function, int arg, int attrs) {
+  get_param(m, function, arg)->attrs |= attrs;
+}
+
+void f_set_argalign(FModule *m, int function, int arg, int align) {
+  get_param(m, function, arg)->align = align;
 }
 
 int f_add_bblock(FModule *m, int function) {
-  FFunction *f = vec_getref(m->functions, function);
-  FBBlock bb;
+  FFunction *f = f_get_function(m, function);
+  FBBlock *bb;
   assert(f->tag == FModFunc);
-  vec_init(bb);
-  vec_push(f->u.bblocks, bb);
-  return vec_size(f->u.bblocks) - 1;
+  f->u.body.bblocks = f_arena_reserve(m->arena, f->u.body.bblocks,
+    f->u.body.nbblocks, &f->u.body.capbblocks, sizeof(FBBlock));
+  bb = &f->u.body.bblocks[f->u.body.nbblocks];
+  bb->first = -1;
+  bb->last = -1;
+  bb->ninstrs = 0;
+  return f->u.body.nbblocks++;
 }
 
 FBBlock *f_get_bblock(FModule *m, int function, int bblock) {
   FFunction *f = f_get_function(m, function);
   assert(f->tag == FModFunc);
-  return vec_getref(f->u.bblocks, bblock);
+  assert(bblock >= 0 && bblock < f->u.body.nbblocks);
+  return &f->u.body.bblocks[bblock];
 }
 
 FBBlock *f_get_bblock_by_builder(FBuilder b) {
@@ -161,15 +389,14 @@ void f_set_bblock(FBuilder *b, int bblock) {
   b->bblock = bblock;
 }
 
-FValue f_value(int bblock, int instr) {
+FValue f_value(int id) {
   FValue v;
-  v.bblock = bblock;
-  v.instr = instr;
+  v.id = id;
   return v;
 }
 
 int f_same(FValue a, FValue b) {
-  return a.bblock == b.bblock && a.instr == b.instr;
+  return a.id == b.id;
 }
 
 int f_null(FValue v) {
@@ -177,7 +404,142 @@ int f_null(FValue v) {
 }
 
 FInstr* f_instr(FModule *m, int function, FValue v) {
-  FBBlock *bb = f_get_bblock(m, function, v.bblock);
-  return vec_getref(*bb, v.instr);
+  FFunction *f = &m->functions[function];
+  assert(function >= 0 && function < m->nfunctions);
+  assert(f->tag == FModFunc);
+  if (f_is_konst(v)) {
+    assert(f_konst_index(v) < f->u.body.nkonsts);
+    return &f->u.body.konsts[f_konst_index(v)];
+  }
+  assert(v.id >= 0 && v.id < f->u.body.ninstrs);
+  return &f->u.body.instrs[v.id];
+}
+
+FValue *f_operand(FInstr *i, int n) {
+  FValue *ops[3];
+  int nops = 0;
+  switch (i->tag) {
+    case FLoad:
+      ops[nops++] = &i->u.load.addr;
+      break;
+    case FStore:
+      ops[nops++] = &i->u.store.addr;
+      ops[nops++] = &i->u.store.val;
+      break;
+    case FOffset:
+      ops[nops++] = &i->u.offset.addr;
+      ops[nops++] = &i->u.offset.offset;
+      break;
+    case FCast:
+      ops[nops++] = &i->u.cast.val;
+      break;
+    case FBinop:
+      ops[nops++] = &i->u.binop.lhs;
+      ops[nops++] = &i->u.binop.rhs;
+      break;
+    case FIntCmp:
+      ops[nops++] = &i->u.intcmp.lhs;
+      ops[nops++] = &i->u.intcmp.rhs;
+      break;
+    case FFpCmp:
+      ops[nops++] = &i->u.fpcmp.lhs;
+      ops[nops++] = &i->u.fpcmp.rhs;
+      break;
+    case FJmpIf:
+      ops[nops++] = &i->u.jmpif.cond;
+      break;
+    case FSelect:
+      ops[nops++] = &i->u.select.cond;
+      ops[nops++] = &i->u.select.truev;
+      ops[nops++] = &i->u.select.falsev;
+      break;
+    case FRet:
+      ops[nops++] = &i->u.ret.val;
+      break;
+    case FCall:
+      return n >= 0 && n < i->u.call.nargs ? &i->u.call.args[n] : NULL;
+    case FPhi:
+      return n >= 0 && n < i->u.phi.ninc ? &i->u.phi.inc[n].value : NULL;
+    case FSplat:
+      ops[nops++] = &i->u.splat.val;
+      break;
+    case FExtract:
+      ops[nops++] = &i->u.extract.vec;
+      break;
+    case FInsert:
+      ops[nops++] = &i->u.insert.vec;
+      ops[nops++] = &i->u.insert.val;
+      break;
+    case FShuffle:
+      ops[nops++] = &i->u.shuffle.lhs;
+      ops[nops++] = &i->u.shuffle.rhs;
+      break;
+    case FReduce:
+      ops[nops++] = &i->u.reduce.vec;
+      break;
+    case FMemcpy:
+    case FMemmove:
+      ops[nops++] = &i->u.copy.dst;
+      ops[nops++] = &i->u.copy.src;
+      ops[nops++] = &i->u.copy.size;
+      break;
+    case FMemset:
+      ops[nops++] = &i->u.fill.dst;
+      ops[nops++] = &i->u.fill.val;
+      ops[nops++] = &i->u.fill.size;
+      break;
+    case FPrefetch:
+      ops[nops++] = &i->u.prefetch.addr;
+      break;
+    case FAtomicRmw:
+      ops[nops++] = &i->u.atomic.addr;
+      ops[nops++] = &i->u.atomic.val;
+      break;
+    case FCmpxchg:
+      ops[nops++] = &i->u.cmpxchg.addr;
+      ops[nops++] = &i->u.cmpxchg.cmp;
+      ops[nops++] = &i->u.cmpxchg.val;
+      break;
+    case FUnop:
+      ops[nops++] = &i->u.unop.val;
+      break;
+    case FTernop:
+      ops[nops++] = &i->u.ternop.a;
+      ops[nops++] = &i->u.ternop.b;
+      ops[nops++] = &i->u.ternop.c;
+      break;
+    case FChecked:
+      ops[nops++] = &i->u.checked.lhs;
+      ops[nops++] = &i->u.checked.rhs;
+      break;
+    case FOverflowed:
+      ops[nops++] = &i->u.overflowed.checked;
+      break;
+    case FAlloca:
+      ops[nops++] = &i->u.alloca.dynsize;
+      break;
+    default:
+      break;
+  }
+  return n >= 0 && n < nops ? ops[n] : NULL;
 }
 
+void f_replace_all_uses(FModule *m, int function, FValue old, FValue value) {
+  FFunction *f = f_get_function(m, function);
+  int u, last = -1;
+  assert(f->tag == FModFunc);
+  assert(old.id >= 0 && old.id < f->u.body.ninstrs);
+  if (f_same(old, value))
+    return;
+  f_use_foreach(f, old, u) {
+    FUse *use = &f->u.body.uses[u];
+    *f_operand(&f->u.body.instrs[use->user], use->operand) = value;
+    last = u;
+  }
+  /* The whole list moves to the new value, which keeps its old uses after */
+  if (last >= 0 && value.id >= 0) {
+    f->u.body.uses[last].next = f->u.body.firstuse[value.id];
+    f->u.body.firstuse[value.id] = f->u.body.firstuse[old.id];
+  }
+  f->u.body.firstuse[old.id] = -1;
+}
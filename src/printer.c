@@ -34,46 +34,39 @@ typedef struct PrinterState {
   FILE *f;
   FModule *m;
   int function;
-  int **valueid;
+  int *valueid;                 /* printed id of each value, in block order */
 } PrinterState;
 
 static void printer_init(PrinterState *ps, FILE *f, FModule *m,
     int function) {
   FFunction *func = f_get_function(m, function);
-  int id = 1;
+  int id = 1, i, j;
   ps->f = f;
   ps->m = m;
   ps->function = function;
   if(func->tag == FModFunc) {
-    ps->valueid = mem_newarray(int *, vec_size(func->u.bblocks));
-    vec_for(func->u.bblocks, i, {
-      FBBlock *bb = vec_getref(func->u.bblocks, i);
-      ps->valueid[i] = mem_newarray(int, vec_size(*bb));
-      vec_for(*bb, j, {
-        FInstr *instr = f_instr(m, function, f_value(i, j));
-        if (instr->tag != FKonst && instr->type != FVoid)
-          ps->valueid[i][j] = id++;
+    ps->valueid = mem_newarray(int, func->u.body.ninstrs);
+    for (i = 0; i < func->u.body.nbblocks; ++i) {
+      f_bblock_foreach(func, i, j) {
+        FInstr *instr = &func->u.body.instrs[j];
+        if (instr->type != FVoid)
+          ps->valueid[j] = id++;
         else
-          ps->valueid[i][j] = -1;
-      });
-    });
+          ps->valueid[j] = -1;
+      }
+    }
   }
 }
 
 static void printer_finish(PrinterState *ps) {
   FFunction *func = f_get_function(ps->m, ps->function);
-  if(func->tag == FModFunc) {
-    vec_for(func->u.bblocks, i, {
-      FBBlock *bb = vec_getref(func->u.bblocks, i);
-      mem_deletearray(ps->valueid[i], vec_size(*bb));
-    });
-    mem_deletearray(ps->valueid, vec_size(func->u.bblocks));
-  }
+  if(func->tag == FModFunc)
+    mem_deletearray(ps->valueid, func->u.body.ninstrs);
 }
 
 static void print_type(PrinterState *ps, enum FType type) {
-  const char *str;
-  switch(type) {
+  const char *str = "?";
+  switch(f_scalar(type)) {
     case FBool:    str = "bool"; break;
     case FInt8:    str = "i8"; break;
     case FInt16:   str = "i16"; break;
@@ -83,20 +76,46 @@ static void print_type(PrinterState *ps, enum FType type) {
     case FDouble:  str = "dbl"; break;
     case FPointer: str = "ptr"; break;
     case FVoid:    str = "void"; break;
+    default: break;
   }
   fprintf(ps->f, "%s", str);
+  if (f_is_vec(type))
+    fprintf(ps->f, "x%d", f_lanes(type));
+}
+
+static void print_attrs(PrinterState *ps, int attrs) {
+  if (attrs & FAttrNoAlias) fprintf(ps->f, " noalias");
+  if (attrs & FAttrNonNull) fprintf(ps->f, " nonnull");
+  if (attrs & FAttrReadOnly) fprintf(ps->f, " readonly");
+  if (attrs & FAttrReadNone) fprintf(ps->f, " readnone");
+  if (attrs & FAttrNoUnwind) fprintf(ps->f, " nounwind");
+  if (attrs & FAttrAlwaysInline) fprintf(ps->f, " alwaysinline");
+  if (attrs & FAttrNoInline) fprintf(ps->f, " noinline");
+  if (attrs & FAttrCold) fprintf(ps->f, " cold");
+  if (attrs & FAttrHot) fprintf(ps->f, " hot");
+}
+
+static void print_arg(PrinterState *ps, FFunctionType *ftype,
+    FParamAttr *params, int arg) {
+  print_type(ps, ftype->args[arg]);
+  if (params) {
+    print_attrs(ps, params[arg].attrs);
+    if (params[arg].align)
+      fprintf(ps->f, " align %d", params[arg].align);
+  }
 }
 
-static void print_ftype(PrinterState *ps, FFunctionType *ftype) {
+static void print_ftype(PrinterState *ps, FFunctionType *ftype,
+    FParamAttr *params) {
   int i;
   int n = ftype->nargs;
   if (n == 0)
     print_type(ps, FVoid);
   else {
-    print_type(ps, ftype->args[0]);
+    print_arg(ps, ftype, params, 0);
     for (i = 1; i < n; ++i) {
       fprintf(ps->f, ", ");
-      print_type(ps, ftype->args[i]);
+      print_arg(ps, ftype, params, i);
     }
   }
   if (ftype->vararg)
@@ -114,7 +133,7 @@ static void print_bblock(PrinterState *ps, int bb) {
 }
 
 static void print_value_id(PrinterState *ps, FValue v) {
-  fprintf(ps->f, "$%03d", ps->valueid[v.bblock][v.instr]);
+  fprintf(ps->f, "$%03d", ps->valueid[v.id]);
 }
 
 static void print_konst(PrinterState *ps, FInstr *i) {
@@ -168,6 +187,39 @@ static void print_binop(PrinterState *ps, enum FBinopTag op) {
     case FAnd: fprintf(ps->f, " & "); break;
     case FOr:  fprintf(ps->f, " | "); break;
     case FXor: fprintf(ps->f, " ^ "); break;
+    case FMin: fprintf(ps->f, " min "); break;
+    case FMax: fprintf(ps->f, " max "); break;
+    case FUMin: fprintf(ps->f, " U min "); break;
+    case FUMax: fprintf(ps->f, " U max "); break;
+    case FRotl: fprintf(ps->f, " rotl "); break;
+    case FRotr: fprintf(ps->f, " rotr "); break;
+    case FUDiv: fprintf(ps->f, " U / "); break;
+    case FSRem: fprintf(ps->f, " S %% "); break;
+    case FAShr: fprintf(ps->f, " S >> "); break;
+  }
+}
+
+static void print_checked(PrinterState *ps, enum FCheckedTag op) {
+  switch (op) {
+    case FCheckedSAdd: fprintf(ps->f, " S + "); break;
+    case FCheckedUAdd: fprintf(ps->f, " U + "); break;
+    case FCheckedSSub: fprintf(ps->f, " S - "); break;
+    case FCheckedUSub: fprintf(ps->f, " U - "); break;
+    case FCheckedSMul: fprintf(ps->f, " S * "); break;
+    case FCheckedUMul: fprintf(ps->f, " U * "); break;
+  }
+}
+
+static void print_unop(PrinterState *ps, enum FUnopTag op) {
+  switch (op) {
+    case FSqrt: fprintf(ps->f, "sqrt "); break;
+    case FFloor: fprintf(ps->f, "floor "); break;
+    case FCeil: fprintf(ps->f, "ceil "); break;
+    case FAbs: fprintf(ps->f, "abs "); break;
+    case FPopcount: fprintf(ps->f, "popcount "); break;
+    case FCtlz: fprintf(ps->f, "ctlz "); break;
+    case FCttz: fprintf(ps->f, "cttz "); break;
+    case FBswap: fprintf(ps->f, "bswap "); break;
   }
 }
 
@@ -203,8 +255,40 @@ static void print_fpcmp(PrinterState *ps, enum FFpCmpTag op) {
   }
 }
 
-static void print_instruction(PrinterState *ps, int bblock, int instr) {
-  FValue v = f_value(bblock, instr);
+static void print_memflags(PrinterState *ps, int align, int isvolatile) {
+  if (align)
+    fprintf(ps->f, " align %d", align);
+  if (isvolatile)
+    fprintf(ps->f, " volatile");
+}
+
+static void print_ordering(PrinterState *ps, enum FOrdering order) {
+  switch (order) {
+    case FNotAtomic: break;
+    case FRelaxed: fprintf(ps->f, " relaxed"); break;
+    case FAcquire: fprintf(ps->f, " acquire"); break;
+    case FRelease: fprintf(ps->f, " release"); break;
+    case FAcqRel:  fprintf(ps->f, " acq_rel"); break;
+    case FSeqCst:  fprintf(ps->f, " seq_cst"); break;
+  }
+}
+
+static void print_atomic(PrinterState *ps, enum FAtomicTag op) {
+  switch (op) {
+    case FAtomicXchg: fprintf(ps->f, "xchg "); break;
+    case FAtomicAdd:  fprintf(ps->f, "add "); break;
+    case FAtomicSub:  fprintf(ps->f, "sub "); break;
+    case FAtomicAnd:  fprintf(ps->f, "and "); break;
+    case FAtomicOr:   fprintf(ps->f, "or "); break;
+    case FAtomicXor:  fprintf(ps->f, "xor "); break;
+    case FAtomicMin:  fprintf(ps->f, "S min "); break;
+    case FAtomicMax:  fprintf(ps->f, "S max "); break;
+    case FAtomicUMin: fprintf(ps->f, "U min "); break;
+    case FAtomicUMax: fprintf(ps->f, "U max "); break;
+  }
+}
+
+static void print_instruction(PrinterState *ps, FValue v) {
   FInstr *i = f_instr(ps->m, ps->function, v);
   if (i->tag == FKonst) return;
   if (i->type == FVoid)
@@ -227,6 +311,9 @@ static void print_instruction(PrinterState *ps, int bblock, int instr) {
       print_type(ps, i->type);
       fprintf(ps->f, " from ");
       print_value(ps, i->u.load.addr);
+      if (i->u.load.order != FNotAtomic)
+        fprintf(ps->f, " atomic");
+      print_ordering(ps, i->u.load.order);
       break;
     }
     case FStore: {
@@ -234,6 +321,9 @@ static void print_instruction(PrinterState *ps, int bblock, int instr) {
       print_value(ps, i->u.store.val);
       fprintf(ps->f, " at ");
       print_value(ps, i->u.store.addr);
+      if (i->u.store.order != FNotAtomic)
+        fprintf(ps->f, " atomic");
+      print_ordering(ps, i->u.store.order);
       break;
     }
     case FOffset: {
@@ -317,17 +407,144 @@ static void print_instruction(PrinterState *ps, int bblock, int instr) {
       break;
     }
     case FPhi: {
+      int p;
       fprintf(ps->f, "phi ");
-      vec_for(i->u.phi.inc, p, {
-        FPhiInc *phi = vec_getref(i->u.phi.inc, p);
+      for (p = 0; p < i->u.phi.ninc; ++p) {
+        FPhiInc *phi = &i->u.phi.inc[p];
         fprintf(ps->f, "[");
         print_bblock(ps, phi->bb);
         fprintf(ps->f, " -> ");
         print_value(ps, phi->value);
         fprintf(ps->f, "]");
-        if (p != vec_size(i->u.phi.inc) - 1)
+        if (p != i->u.phi.ninc - 1)
           fprintf(ps->f, ", ");
-      });
+      }
+      break;
+    }
+    case FSplat: {
+      fprintf(ps->f, "splat ");
+      print_value(ps, i->u.splat.val);
+      fprintf(ps->f, " to ");
+      print_type(ps, i->type);
+      break;
+    }
+    case FExtract: {
+      fprintf(ps->f, "extract ");
+      print_value(ps, i->u.extract.vec);
+      fprintf(ps->f, " [%d]", i->u.extract.lane);
+      break;
+    }
+    case FInsert: {
+      fprintf(ps->f, "insert ");
+      print_value(ps, i->u.insert.val);
+      fprintf(ps->f, " in ");
+      print_value(ps, i->u.insert.vec);
+      fprintf(ps->f, " [%d]", i->u.insert.lane);
+      break;
+    }
+    case FShuffle: {
+      int l, n = i->u.shuffle.mask ? f_lanes(i->type) : 0;
+      fprintf(ps->f, "shuffle ");
+      print_value(ps, i->u.shuffle.lhs);
+      fprintf(ps->f, ", ");
+      print_value(ps, i->u.shuffle.rhs);
+      fprintf(ps->f, " [");
+      for (l = 0; l < n; ++l)
+        fprintf(ps->f, l == 0 ? "%d" : ", %d", i->u.shuffle.mask[l]);
+      fprintf(ps->f, "]");
+      break;
+    }
+    case FReduce: {
+      fprintf(ps->f, "reduce");
+      print_binop(ps, i->u.reduce.op);
+      print_value(ps, i->u.reduce.vec);
+      break;
+    }
+    case FMemcpy:
+    case FMemmove: {
+      fprintf(ps->f, i->tag == FMemcpy ? "memcpy " : "memmove ");
+      print_value(ps, i->u.copy.src);
+      fprintf(ps->f, " to ");
+      print_value(ps, i->u.copy.dst);
+      fprintf(ps->f, " size ");
+      print_value(ps, i->u.copy.size);
+      print_memflags(ps, i->u.copy.align, i->u.copy.isvolatile);
+      break;
+    }
+    case FMemset: {
+      fprintf(ps->f, "memset ");
+      print_value(ps, i->u.fill.val);
+      fprintf(ps->f, " to ");
+      print_value(ps, i->u.fill.dst);
+      fprintf(ps->f, " size ");
+      print_value(ps, i->u.fill.size);
+      print_memflags(ps, i->u.fill.align, i->u.fill.isvolatile);
+      break;
+    }
+    case FPrefetch: {
+      fprintf(ps->f, "prefetch %s ", i->u.prefetch.write ? "write" : "read");
+      print_value(ps, i->u.prefetch.addr);
+      fprintf(ps->f, " locality %d", i->u.prefetch.locality);
+      break;
+    }
+    case FAtomicRmw: {
+      fprintf(ps->f, "atomic ");
+      print_atomic(ps, i->u.atomic.op);
+      print_value(ps, i->u.atomic.val);
+      fprintf(ps->f, " at ");
+      print_value(ps, i->u.atomic.addr);
+      print_ordering(ps, i->u.atomic.order);
+      break;
+    }
+    case FCmpxchg: {
+      fprintf(ps->f, "cmpxchg ");
+      print_value(ps, i->u.cmpxchg.cmp);
+      fprintf(ps->f, " to ");
+      print_value(ps, i->u.cmpxchg.val);
+      fprintf(ps->f, " at ");
+      print_value(ps, i->u.cmpxchg.addr);
+      print_ordering(ps, i->u.cmpxchg.order);
+      break;
+    }
+    case FFence: {
+      fprintf(ps->f, "fence");
+      print_ordering(ps, i->u.fence.order);
+      break;
+    }
+    case FUnop: {
+      fprintf(ps->f, "unop ");
+      print_unop(ps, i->u.unop.op);
+      print_value(ps, i->u.unop.val);
+      break;
+    }
+    case FChecked: {
+      fprintf(ps->f, "checked ");
+      print_value(ps, i->u.checked.lhs);
+      print_checked(ps, i->u.checked.op);
+      print_value(ps, i->u.checked.rhs);
+      break;
+    }
+    case FOverflowed: {
+      fprintf(ps->f, "overflowed ");
+      print_value(ps, i->u.overflowed.checked);
+      break;
+    }
+    case FAlloca:
+      fprintf(ps->f, "alloca ");
+      if (f_null(i->u.alloca.dynsize))
+        fprintf(ps->f, "%d", i->u.alloca.size);
+      else
+        print_value(ps, i->u.alloca.dynsize);
+      print_memflags(ps, i->u.alloca.align, 0);
+      break;
+    case FTernop: {
+      /* Fma is the only ternary operation */
+      fprintf(ps->f, "ternop fma ");
+      print_value(ps, i->u.ternop.a);
+      fprintf(ps->f, " * ");
+      print_value(ps, i->u.ternop.b);
+      fprintf(ps->f, " + ");
+      print_value(ps, i->u.ternop.c);
       break;
     }
   }
@@ -341,28 +558,31 @@ static void print_function(PrinterState *ps) {
   fprintf(ps->f, "function ");
   print_fname(ps, ps->function);
   fprintf(ps->f, " : ");
-  print_ftype(ps, f_get_ftype(ps->m, ps->function));
+  print_ftype(ps, f_get_ftype(ps->m, func->type), func->params);
+  print_attrs(ps, func->attrs);
   fprintf(ps->f, "\n");
   if (func->tag == FModFunc) {
-    vec_for(func->u.bblocks, i, {
-      FBBlock *bb = vec_getref(func->u.bblocks, i);
+    int i, j;
+    for (i = 0; i < func->u.body.nbblocks; ++i) {
       fprintf(ps->f, " ");
       print_bblock(ps, i);
       fprintf(ps->f, "\n");
-      vec_for(*bb, j, print_instruction(ps, i, j));
-    });
+      f_bblock_foreach(func, i, j)
+        print_instruction(ps, f_value(j));
+    }
   }
   fprintf(ps->f, "\n");
 }
 
 void f_printer(struct FModule *m, FILE *f) {
+  int function;
   fprintf(f, "Fahrenheit module\n");
-  vec_for(m->functions, function, {
+  for (function = 0; function < m->nfunctions; ++function) {
     PrinterState ps;
     printer_init(&ps, f, m, function);
     print_function(&ps);
     printer_finish(&ps);
-  });
+  }
   fprintf(f, ".\n");
 }
 
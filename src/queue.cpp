@@ -0,0 +1,187 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <fahrenheit/backend.h>
+#include <fahrenheit/queue.h>
+}
+
+/* Job shared by the user and the compiler thread
+ * The job is deleted when both release it. */
+struct FCompileJob {
+  FEngine *engine;
+  FModule *module;
+  FCompileOptions opts;
+  std::string cache_dir;
+  std::string cpu;
+  std::string features;
+  bool has_opts;
+  FCompileCallback callback;
+  void *userdata;
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done;
+  int status;
+  int refs;
+};
+
+namespace {
+
+/* Queue exported */
+struct FCompileQueueData {
+  std::mutex mutex;
+  std::condition_variable pending;
+  std::deque<FCompileJob *> jobs;
+  std::vector<std::thread> threads;
+  bool closing;
+};
+
+/* Decrement the job references and delete it if needed */
+void release_job(FCompileJob *job) {
+  bool last;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    last = --job->refs == 0;
+  }
+  if (last) delete job;
+}
+
+/* Copy the options into the job, including the strings they point to */
+void copy_options(FCompileJob *job, const FCompileOptions *opts) {
+  job->opts = *opts;
+  if (opts->cache_dir) {
+    job->cache_dir = opts->cache_dir;
+    job->opts.cache_dir = job->cache_dir.c_str();
+  }
+  if (opts->cpu) {
+    job->cpu = opts->cpu;
+    job->opts.cpu = job->cpu.c_str();
+  }
+  if (opts->features) {
+    job->features = opts->features;
+    job->opts.features = job->features.c_str();
+  }
+}
+
+/* Compile a single job and notify the waiting threads */
+void run_job(FCompileJob *job) {
+  auto opts = job->has_opts ? &job->opts : nullptr;
+  int status = f_compile_ex(job->engine, job->module, opts);
+  if (job->callback)
+    job->callback(job->engine, status, job->userdata);
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->status = status;
+    job->done = true;
+  }
+  job->finished.notify_all();
+  release_job(job);
+}
+
+/* Main loop of a compiler thread */
+void compiler_thread(FCompileQueueData *data) {
+  while (true) {
+    FCompileJob *job;
+    {
+      std::unique_lock<std::mutex> lock(data->mutex);
+      data->pending.wait(lock, [data] {
+        return data->closing || !data->jobs.empty();
+      });
+      if (data->jobs.empty()) return;
+      job = data->jobs.front();
+      data->jobs.pop_front();
+    }
+    run_job(job);
+  }
+}
+
+}
+
+void f_init_queue(FCompileQueue *q, int nthreads) {
+  auto data = new FCompileQueueData();
+  data->closing = false;
+  if (nthreads <= 0)
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < nthreads; ++i)
+    data->threads.emplace_back(compiler_thread, data);
+  q->data = data;
+}
+
+void f_close_queue(FCompileQueue *q) {
+  auto data = reinterpret_cast<FCompileQueueData *>(q->data);
+  if (!data) return;
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->closing = true;
+  }
+  data->pending.notify_all();
+  for (auto &thread : data->threads)
+    thread.join();
+  delete data;
+  q->data = nullptr;
+}
+
+FCompileJob *f_compile_async(FCompileQueue *q, FEngine *e, FModule *m,
+    const FCompileOptions *opts, FCompileCallback callback, void *userdata) {
+  auto data = reinterpret_cast<FCompileQueueData *>(q->data);
+  auto job = new FCompileJob();
+  job->engine = e;
+  job->module = m;
+  job->has_opts = opts != nullptr;
+  if (opts) copy_options(job, opts);
+  job->callback = callback;
+  job->userdata = userdata;
+  job->done = false;
+  job->status = 0;
+  job->refs = 2;
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->jobs.push_back(job);
+  }
+  data->pending.notify_one();
+  return job;
+}
+
+int f_job_done(FCompileJob *job) {
+  std::lock_guard<std::mutex> lock(job->mutex);
+  return job->done;
+}
+
+int f_job_wait(FCompileJob *job) {
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->finished.wait(lock, [job] { return job->done; });
+  return job->status;
+}
+
+void f_job_release(FCompileJob *job) {
+  release_job(job);
+}
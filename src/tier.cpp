@@ -0,0 +1,309 @@
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2017 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <fahrenheit/backend.h>
+#include <fahrenheit/ir.h>
+#include <fahrenheit/tier.h>
+#include "engine.h"
+}
+
+namespace {
+
+/* Tiered engine exported
+ * The counters are written by the baseline code without synchronization and
+ * the table is read by it, so both are accessed with atomic builtins. */
+struct TierData {
+  FModule module;                 /* private copy of the IR */
+  FCompileOptions opts;           /* its strings point to the fields below */
+  std::string cache_dir;
+  std::string cpu;
+  std::string features;
+  FTierOptions tier;
+  FEngine baseline;
+  std::vector<ui64> counters;     /* calls and back edges of each function */
+  std::vector<FJitFunc> table;    /* exported as e->funcs */
+  std::vector<FEngine> optimized;
+  std::mutex update_mutex;        /* serializes the promotions */
+  std::mutex mutex;               /* protects the fields below */
+  std::vector<FTier> tiers;
+  FTierStats stats;
+  std::condition_variable wake;
+  bool closing;
+  std::thread thread;
+};
+
+/* Obtain the tier data of the engine (NULL if it isn't tiered) */
+TierData *get_data(FEngine *e) {
+  if (e->backend != FBackendTiered) return nullptr;
+  return reinterpret_cast<TierData *>(e->data);
+}
+
+/* Read a counter written by the baseline code */
+ui64 read_counter(TierData *data, int index) {
+  return __atomic_load_n(&data->counters[index], __ATOMIC_RELAXED);
+}
+
+/* Check if the function calls one of the selected functions */
+bool calls_selected(FFunction *f, const std::vector<bool> &selected) {
+  for (int i = 0; i < f->u.body.ninstrs; ++i) {
+    FInstr *instr = &f->u.body.instrs[i];
+    if (instr->tag == FCall && selected[instr->u.call.function])
+      return true;
+  }
+  return false;
+}
+
+/* Add the optimized functions that call the given ones, directly or through
+ * other added functions
+ * The optimized code binds its callees to their address at the time of the
+ * compilation, so the callers are recompiled together with the promoted
+ * functions to call their new version. The functions stay sorted. */
+void add_callers(TierData *data, std::vector<int> &functions) {
+  int nfuncs = data->module.nfunctions;
+  std::vector<bool> selected(nfuncs, false);
+  for (int i : functions)
+    selected[i] = true;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < nfuncs; ++i) {
+      auto f = f_get_function(&data->module, i);
+      if (selected[i] || f->tag != FModFunc ||
+          data->tiers[i] != FTierOptimized || !calls_selected(f, selected))
+        continue;
+      selected[i] = true;
+      changed = true;
+    }
+  }
+  functions.clear();
+  for (int i = 0; i < nfuncs; ++i)
+    if (selected[i]) functions.push_back(i);
+}
+
+/* Create a module where the given functions are copied and the others are
+ * external functions that point to their current version */
+void create_module(TierData *data, const std::vector<int> &functions,
+    FModule *m) {
+  int nfuncs = data->module.nfunctions;
+  size_t next = 0;
+  f_init_module(m);
+  for (int i = 0; i < nfuncs; ++i) {
+    if (next < functions.size() && functions[next] == i) {
+      f_copy_function(m, &data->module, i);
+      next++;
+    } else {
+      auto ftype = f_get_ftype_by_function(&data->module, i);
+      int type = f_ftypev(m, ftype->ret, ftype->nargs, ftype->args);
+      if (ftype->vararg) f_set_vararg(m, type);
+      int ext = f_add_extfunction(m, type,
+          __atomic_load_n(&data->table[i], __ATOMIC_ACQUIRE));
+      auto f = f_get_function(&data->module, i);
+      f_set_fattr(m, ext, f->attrs);
+      for (int a = 0; f->params && a < ftype->nargs; ++a) {
+        f_set_argattr(m, ext, a, f->params[a].attrs);
+        f_set_argalign(m, ext, a, f->params[a].align);
+      }
+    }
+  }
+}
+
+/* Promote the functions that reached the thresholds
+ * Return the number of promoted functions. */
+int update(TierData *data) {
+  std::lock_guard<std::mutex> update_lock(data->update_mutex);
+  std::vector<int> hot;
+  std::vector<int> functions;
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    for (size_t i = 0; i < data->tiers.size(); ++i) {
+      if (data->tiers[i] != FTierBaseline) continue;
+      if (read_counter(data, 2 * i) >= data->tier.call_threshold ||
+          read_counter(data, 2 * i + 1) >= data->tier.loop_threshold)
+        hot.push_back(i);
+    }
+    data->stats.checks++;
+    if (hot.empty()) return 0;
+    functions = hot;
+    add_callers(data, functions);
+  }
+  FModule m;
+  FEngine engine;
+  create_module(data, functions, &m);
+  f_init_engine(&engine);
+  int status = f_compile_ex(&engine, &m, &data->opts);
+  f_close_module(&m);
+  std::lock_guard<std::mutex> lock(data->mutex);
+  data->stats.compilations++;
+  if (status) {
+    for (int i : hot)
+      data->tiers[i] = FTierFailed;
+    data->stats.failures += hot.size();
+    return 0;
+  }
+  for (int i : functions)
+    __atomic_store_n(&data->table[i], engine.funcs[i], __ATOMIC_RELEASE);
+  for (int i : hot)
+    data->tiers[i] = FTierOptimized;
+  data->stats.promotions += hot.size();
+  data->optimized.push_back(engine);
+  return hot.size();
+}
+
+/* Check the counters periodically until the engine is closed */
+void tier_thread(TierData *data) {
+  auto interval = std::chrono::milliseconds(data->tier.interval);
+  std::unique_lock<std::mutex> lock(data->mutex);
+  while (!data->closing) {
+    data->wake.wait_for(lock, interval);
+    if (data->closing) break;
+    lock.unlock();
+    update(data);
+    lock.lock();
+  }
+}
+
+}
+
+void f_init_tier_options(FTierOptions *opts) {
+  opts->call_threshold = 1000;
+  opts->loop_threshold = 10000;
+  opts->background = 1;
+  opts->interval = 10;
+}
+
+int f_tier_compile(FEngine *e, FModule *m, const FCompileOptions *opts,
+    const FTierOptions *tier) {
+  auto data = new TierData();
+  int nfuncs = m->nfunctions;
+  int status;
+  f_init_module(&data->module);
+  for (int i = 0; i < nfuncs; ++i)
+    f_copy_function(&data->module, m, i);
+  data->opts = *opts;
+  if (opts->cache_dir) {
+    data->cache_dir = opts->cache_dir;
+    data->opts.cache_dir = data->cache_dir.c_str();
+  }
+  if (opts->cpu) {
+    data->cpu = opts->cpu;
+    data->opts.cpu = data->cpu.c_str();
+  }
+  if (opts->features) {
+    data->features = opts->features;
+    data->opts.features = data->features.c_str();
+  }
+  if (tier)
+    data->tier = *tier;
+  else
+    f_init_tier_options(&data->tier);
+  data->counters.assign(2 * nfuncs, 0);
+  data->table.assign(nfuncs, nullptr);
+  data->tiers.assign(nfuncs, FTierBaseline);
+  data->stats = FTierStats();
+  data->closing = false;
+  f_init_engine(&data->baseline);
+  for (int i = 0; i < nfuncs; ++i)
+    if (f_get_function(m, i)->tag == FExtFunc)
+      data->tiers[i] = FTierOptimized;
+  bool baseline = F_X64_SUPPORTED;
+  if (baseline) {
+    data->baseline.backend = FBackendX64;
+    status = f_x64_compile_instrumented(&data->baseline, &data->module,
+        data->counters.data(), data->table.data());
+    baseline = status == 0;
+  }
+  if (!baseline) {
+    /* Without the baseline code (because the host or the module isn't
+     * supported), everything is optimized right away */
+    data->baseline.backend = FBackendLLVM;
+    status = f_compile_ex(&data->baseline, &data->module, opts);
+    data->tiers.assign(nfuncs, FTierOptimized);
+  }
+  if (status) {
+    f_close_module(&data->module);
+    delete data;
+    return status;
+  }
+  for (int i = 0; i < nfuncs; ++i)
+    data->table[i] = data->baseline.funcs[i];
+  e->funcs = data->table.data();
+  e->nfuncs = nfuncs;
+  e->data = data;
+  if (baseline && data->tier.background)
+    data->thread = std::thread(tier_thread, data);
+  return 0;
+}
+
+void f_tier_close_engine(void *engine_data) {
+  auto data = reinterpret_cast<TierData *>(engine_data);
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->closing = true;
+  }
+  data->wake.notify_all();
+  if (data->thread.joinable())
+    data->thread.join();
+  f_close_engine(&data->baseline);
+  for (auto &engine : data->optimized)
+    f_close_engine(&engine);
+  f_close_module(&data->module);
+  delete data;
+}
+
+int f_tier_update(FEngine *e) {
+  auto data = get_data(e);
+  if (!data) return 0;
+  return update(data);
+}
+
+void f_get_tier_stats(FEngine *e, FTierStats *stats) {
+  auto data = get_data(e);
+  if (!data) {
+    *stats = FTierStats();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(data->mutex);
+  *stats = data->stats;
+}
+
+void f_get_tier_function_stats(FEngine *e, int function,
+    FTierFunctionStats *stats) {
+  auto data = get_data(e);
+  if (!data) {
+    *stats = FTierFunctionStats();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(data->mutex);
+  stats->calls = read_counter(data, 2 * function);
+  stats->loops = read_counter(data, 2 * function + 1);
+  stats->tier = data->tiers[function];
+}
@@ -35,7 +35,8 @@ typedef struct VerifyState {
   FModule *m;
   int f;
   int bb;
-  int i;
+  int i;                        /* position of the instruction in the block */
+  int id;                       /* value of the instruction */
   int bb_ended;
   jmp_buf jmp;
 } VerifyState;
@@ -43,17 +44,15 @@ typedef struct VerifyState {
 static int
 instruction_id(VerifyState *vs) {
   FFunction *func = f_get_function(vs->m, vs->f);
-  vec_for(func->u.bblocks, i, {
-    FBBlock *bb = vec_getref(func->u.bblocks, i);
+  int i, j;
+  for (i = 0; i < func->u.body.nbblocks; ++i) {
     int id = 0;
-    vec_for(*bb, j, {
-      FInstr *instr = f_instr(vs->m, vs->f, f_value(i, j));
-      if (instr->tag != FKonst)
-        id++;
-      if (vs->bb == i && vs->i == j)
+    f_bblock_foreach(func, i, j) {
+      id++;
+      if (vs->id == j)
         return id;
-    });
-  });
+    }
+  }
   return 0;
 }
 
@@ -94,36 +93,79 @@ static FInstr *get_instr(VerifyState *vs, FValue v) {
 /* Verify if the basic block is valid */
 static void verify_bb(VerifyState *vs, int bb) {
   FFunction *f = f_get_function(vs->m, vs->f);
-  int nbbs = vec_size(f->u.bblocks);
+  int nbbs = f->u.body.nbblocks;
   verify(vs, bb >= 1 && bb < nbbs, "invalid basic block %d", bb);
 }
 
 /* Verify if the instruction is the last one */
 static void verify_end(VerifyState *vs) {
   FBBlock *bb = f_get_bblock(vs->m,  vs->f, vs->bb);
-  verify(vs, vs->i == (int)vec_size(*bb) - 1,
+  verify(vs, vs->i == bb->ninstrs - 1,
     "instruction after basic block end");
   vs->bb_ended = 1;
 }
 
 /* Verify if there is a non phi instruction before phi */
 static void verify_instr_before_phi(VerifyState *vs) {
-  FBBlock *bb = f_get_bblock(vs->m,  vs->f, vs->bb);
-  vec_for(*bb, instr_id, {
-    FInstr *instr;
-    if ((int)instr_id >= vs->i) break;
-    instr = f_instr(vs->m, vs->f, f_value(vs->bb, instr_id));    
-    verify(vs, instr->tag == FPhi, "phi after instruction");
-  });
+  FFunction *f = f_get_function(vs->m, vs->f);
+  int id;
+  f_bblock_foreach(f, vs->bb, id) {
+    if (id == vs->id)
+      break;
+    verify(vs, f->u.body.instrs[id].tag == FPhi, "phi after instruction");
+  }
+}
+
+/* Check if the type is a scalar or a valid vector type */
+static int valid_type(enum FType type) {
+  enum FType scalar = f_scalar(type);
+  int lanes = f_lanes(type);
+  if (!f_is_vec(type))
+    return 1;
+  return (scalar == FBool || f_is_num(scalar)) && lanes >= 2 &&
+    lanes <= 64 && (lanes & (lanes - 1)) == 0;
+}
+
+/* Obtain a vector instruction */
+static FInstr *get_vector(VerifyState *vs, FValue v) {
+  FInstr *instr = get_instr(vs, v);
+  verify(vs, f_is_vec(instr->type), "vector expected");
+  return instr;
+}
+
+/* Verify if the lane is inside the vector */
+static void verify_lane(VerifyState *vs, FInstr *vec, int lane) {
+  verify(vs, lane >= 0 && lane < f_lanes(vec->type), "invalid lane %d", lane);
+}
+
+/* Verify if the alignment is 0 (unknown) or a power of two */
+static void verify_align(VerifyState *vs, int align) {
+  verify(vs, align >= 0 && (align & (align - 1)) == 0,
+    "invalid alignment %d", align);
+}
+
+/* Verify the type of an atomic access, pointers are optional */
+static void verify_atomic_type(VerifyState *vs, enum FType type,
+    int pointer) {
+  verify(vs, f_is_int(type) || (pointer && type == FPointer),
+    "invalid atomic type");
+}
+
+/* Verify if the ordering is valid and one of the allowed ones */
+static void verify_ordering(VerifyState *vs, enum FOrdering order,
+    enum FOrdering forbidden1, enum FOrdering forbidden2) {
+  verify(vs, order > FNotAtomic && order <= FSeqCst && order != forbidden1 &&
+    order != forbidden2, "invalid ordering %d", order);
 }
 
 /* Verify an instruction */
 static void verify_instr(VerifyState *vs) {
   FFunctionType *ftype = f_get_ftype_by_function(vs->m, vs->f);
-  FInstr *i = f_instr(vs->m, vs->f, f_value(vs->bb, vs->i));
+  FInstr *i = f_instr(vs->m, vs->f, f_value(vs->id));
+  verify(vs, valid_type(i->type), "invalid type");
   switch (i->tag) {
     case FKonst:
-      /* Don't need to verify constants */
+      /* Constants are in the pool, which is verified by verify_function */
       break;
     case FGetarg: {
       int n = i->u.getarg.n;
@@ -133,6 +175,12 @@ static void verify_instr(VerifyState *vs) {
     case FLoad: {
       FInstr *addr = get_instr(vs, i->u.load.addr);
       verify(vs, addr->type == FPointer, "load from non pointer");
+      verify(vs, !f_is_vec(i->type) || f_scalar(i->type) != FBool,
+          "load of boolean vector");
+      if (i->u.load.order != FNotAtomic) {
+        verify_atomic_type(vs, i->type, 1);
+        verify_ordering(vs, i->u.load.order, FRelease, FAcqRel);
+      }
       break;
     }
     case FStore: {
@@ -140,6 +188,12 @@ static void verify_instr(VerifyState *vs) {
       FInstr *val = get_instr(vs, i->u.store.val);
       verify(vs, addr->type == FPointer, "store in non pointer");
       verify(vs, val->type != FVoid, "store void value");
+      verify(vs, !f_is_vec(val->type) || f_scalar(val->type) != FBool,
+          "store of boolean vector");
+      if (i->u.store.order != FNotAtomic) {
+        verify_atomic_type(vs, val->type, 1);
+        verify_ordering(vs, i->u.store.order, FAcquire, FAcqRel);
+      }
       break;
     }
     case FOffset: {
@@ -176,7 +230,8 @@ static void verify_instr(VerifyState *vs) {
       enum FType lhs_type = get_instr(vs, i->u.binop.lhs)->type;
       enum FType rhs_type = get_instr(vs, i->u.binop.rhs)->type;
       verify(vs, lhs_type == rhs_type, "type mismatch in binop");
-      if (op >= FAdd && op <= FDiv)
+      lhs_type = f_scalar(lhs_type);
+      if ((op >= FAdd && op <= FDiv) || op == FMin || op == FMax)
         verify(vs, f_is_num(lhs_type), "invalid binop type");
       else
         verify(vs, f_is_int(lhs_type), "invalid binop type");
@@ -187,6 +242,7 @@ static void verify_instr(VerifyState *vs) {
       enum FType lhs_type = get_instr(vs, i->u.intcmp.lhs)->type;
       enum FType rhs_type = get_instr(vs, i->u.intcmp.rhs)->type;
       verify(vs, lhs_type == rhs_type, "type mismatch");
+      lhs_type = f_scalar(lhs_type);
       if (op == FIntEq || op == FIntNe)
         verify(vs, lhs_type == FPointer || f_is_int(lhs_type),
             "invalid integer comparison");
@@ -198,7 +254,7 @@ static void verify_instr(VerifyState *vs) {
       enum FType lhs_type = get_instr(vs, i->u.fpcmp.lhs)->type;
       enum FType rhs_type = get_instr(vs, i->u.fpcmp.rhs)->type;
       verify(vs, lhs_type == rhs_type, "type mismatch in cmp");
-      verify(vs, f_is_float(lhs_type), "invalid float comparison");
+      verify(vs, f_is_float(f_scalar(lhs_type)), "invalid float comparison");
       break;
     }
     case FJmpIf: {
@@ -218,7 +274,9 @@ static void verify_instr(VerifyState *vs) {
       FInstr *cond = get_instr(vs, i->u.jmpif.cond);
       enum FType lhs_type = get_instr(vs, i->u.select.truev)->type;
       enum FType rhs_type = get_instr(vs, i->u.select.falsev)->type;
-      verify(vs, cond->type == FBool, "select condition must be boolean");
+      verify(vs, cond->type == FBool ||
+          cond->type == f_vec(FBool, f_lanes(lhs_type)),
+          "select condition must be boolean");
       verify(vs, lhs_type == rhs_type, "type mismatch in select");
       break;
     }
@@ -258,12 +316,153 @@ static void verify_instr(VerifyState *vs) {
       break;
     }
     case FPhi: {
+      int n;
       verify(vs, vs->bb != 0, "phi instruction in the first block");
       verify_instr_before_phi(vs);
-      vec_foreach(i->u.phi.inc, inc, {
-        FInstr *inc_value = get_instr(vs, inc->value);
+      for (n = 0; n < i->u.phi.ninc; ++n) {
+        FInstr *inc_value = get_instr(vs, i->u.phi.inc[n].value);
         verify(vs, inc_value->type == i->type, "mismatch phi type");
-      });
+      }
+      break;
+    }
+    case FSplat: {
+      enum FType type = get_instr(vs, i->u.splat.val)->type;
+      verify(vs, f_is_vec(i->type), "invalid number of lanes");
+      verify(vs, type == FBool || f_is_num(type), "invalid splat value");
+      break;
+    }
+    case FExtract: {
+      FInstr *vec = get_vector(vs, i->u.extract.vec);
+      verify_lane(vs, vec, i->u.extract.lane);
+      break;
+    }
+    case FInsert: {
+      FInstr *vec = get_vector(vs, i->u.insert.vec);
+      FInstr *val = get_instr(vs, i->u.insert.val);
+      verify(vs, val->type == f_scalar(vec->type), "type mismatch in insert");
+      verify_lane(vs, vec, i->u.insert.lane);
+      break;
+    }
+    case FShuffle: {
+      FInstr *lhs = get_vector(vs, i->u.shuffle.lhs);
+      FInstr *rhs = get_instr(vs, i->u.shuffle.rhs);
+      int l, nlanes = f_lanes(i->type);
+      verify(vs, lhs->type == rhs->type, "type mismatch in shuffle");
+      verify(vs, i->u.shuffle.mask != NULL, "invalid number of lanes");
+      for (l = 0; l < nlanes; ++l) {
+        int lane = i->u.shuffle.mask[l];
+        verify(vs, lane >= 0 && lane < 2 * f_lanes(lhs->type),
+            "invalid lane %d", lane);
+      }
+      break;
+    }
+    case FReduce: {
+      enum FBinopTag op = i->u.reduce.op;
+      enum FType type = f_scalar(get_vector(vs, i->u.reduce.vec)->type);
+      verify(vs, op == FAdd || op == FMul || op == FAnd || op == FOr ||
+          op == FXor, "invalid reduce operation");
+      if (op == FAdd || op == FMul)
+        verify(vs, f_is_num(type), "invalid reduce type");
+      else
+        verify(vs, f_is_int(type), "invalid reduce type");
+      break;
+    }
+    case FMemcpy:
+    case FMemmove: {
+      FInstr *dst = get_instr(vs, i->u.copy.dst);
+      FInstr *src = get_instr(vs, i->u.copy.src);
+      FInstr *size = get_instr(vs, i->u.copy.size);
+      verify(vs, dst->type == FPointer && src->type == FPointer,
+          "copy between non pointers");
+      verify(vs, f_is_int(size->type), "size must be an integer");
+      verify_align(vs, i->u.copy.align);
+      break;
+    }
+    case FMemset: {
+      FInstr *dst = get_instr(vs, i->u.fill.dst);
+      FInstr *val = get_instr(vs, i->u.fill.val);
+      FInstr *size = get_instr(vs, i->u.fill.size);
+      verify(vs, dst->type == FPointer, "memset in non pointer");
+      verify(vs, val->type == FInt8, "memset value must be an 8 bits integer");
+      verify(vs, f_is_int(size->type), "size must be an integer");
+      verify_align(vs, i->u.fill.align);
+      break;
+    }
+    case FPrefetch: {
+      FInstr *addr = get_instr(vs, i->u.prefetch.addr);
+      int locality = i->u.prefetch.locality;
+      verify(vs, addr->type == FPointer, "prefetch of non pointer");
+      verify(vs, locality >= 0 && locality <= 3, "invalid locality %d",
+          locality);
+      break;
+    }
+    case FAtomicRmw: {
+      FInstr *addr = get_instr(vs, i->u.atomic.addr);
+      FInstr *val = get_instr(vs, i->u.atomic.val);
+      verify(vs, addr->type == FPointer, "atomic operation in non pointer");
+      verify_atomic_type(vs, val->type, 0);
+      verify(vs, i->u.atomic.op >= FAtomicXchg &&
+          i->u.atomic.op <= FAtomicUMax, "invalid atomic operation");
+      verify_ordering(vs, i->u.atomic.order, FNotAtomic, FNotAtomic);
+      break;
+    }
+    case FCmpxchg: {
+      FInstr *addr = get_instr(vs, i->u.cmpxchg.addr);
+      FInstr *cmp = get_instr(vs, i->u.cmpxchg.cmp);
+      FInstr *val = get_instr(vs, i->u.cmpxchg.val);
+      verify(vs, addr->type == FPointer, "cmpxchg in non pointer");
+      verify(vs, cmp->type == val->type, "type mismatch in cmpxchg");
+      verify_atomic_type(vs, val->type, 1);
+      verify_ordering(vs, i->u.cmpxchg.order, FNotAtomic, FNotAtomic);
+      break;
+    }
+    case FFence:
+      verify_ordering(vs, i->u.fence.order, FRelaxed, FRelaxed);
+      break;
+    case FUnop: {
+      enum FUnopTag op = i->u.unop.op;
+      enum FType type = f_scalar(get_instr(vs, i->u.unop.val)->type);
+      if (op == FSqrt || op == FFloor || op == FCeil)
+        verify(vs, f_is_float(type), "invalid unop type");
+      else if (op == FAbs)
+        verify(vs, f_is_num(type), "invalid unop type");
+      else
+        verify(vs, f_is_int(type), "invalid unop type");
+      verify(vs, op != FBswap || type != FInt8, "bswap of 8 bits integer");
+      break;
+    }
+    case FChecked: {
+      enum FType lhs_type = get_instr(vs, i->u.checked.lhs)->type;
+      enum FType rhs_type = get_instr(vs, i->u.checked.rhs)->type;
+      verify(vs, lhs_type == rhs_type, "type mismatch in checked");
+      verify(vs, f_is_int(lhs_type), "invalid checked type");
+      verify(vs, i->u.checked.op >= FCheckedSAdd &&
+          i->u.checked.op <= FCheckedUMul, "invalid checked operation");
+      break;
+    }
+    case FOverflowed: {
+      FInstr *checked = get_instr(vs, i->u.overflowed.checked);
+      verify(vs, checked->tag == FChecked, "overflow of unchecked value");
+      break;
+    }
+    case FAlloca:
+      if (f_null(i->u.alloca.dynsize)) {
+        verify(vs, i->u.alloca.size > 0, "invalid alloca size %d",
+          i->u.alloca.size);
+        verify(vs, vs->bb == 0, "fixed alloca outside the entry block");
+      } else {
+        FInstr *size = get_instr(vs, i->u.alloca.dynsize);
+        verify(vs, f_is_int(size->type), "size must be an integer");
+      }
+      verify_align(vs, i->u.alloca.align);
+      break;
+    case FTernop: {
+      enum FType a_type = get_instr(vs, i->u.ternop.a)->type;
+      enum FType b_type = get_instr(vs, i->u.ternop.b)->type;
+      enum FType c_type = get_instr(vs, i->u.ternop.c)->type;
+      verify(vs, a_type == b_type && a_type == c_type,
+          "type mismatch in ternop");
+      verify(vs, f_is_float(f_scalar(a_type)), "invalid ternop type");
       break;
     }
   }
@@ -274,8 +473,42 @@ static void verify_ftype(VerifyState *vs) {
   FFunctionType *ftype;
 
   ftype = f_get_ftype_by_function(vs->m, vs->f);
-  for (i = 0; i < ftype->nargs; ++i)
+  verify(vs, valid_type(ftype->ret), "invalid return type");
+  for (i = 0; i < ftype->nargs; ++i) {
     verify(vs, ftype->args[i] != FVoid, "void argument");
+    verify(vs, valid_type(ftype->args[i]), "invalid argument type");
+  }
+}
+
+/* Verify if the attributes are valid and don't conflict */
+static void verify_attrs(VerifyState *vs, int attrs, int valid) {
+  verify(vs, (attrs & ~valid) == 0, "invalid attribute");
+  verify(vs, !((attrs & FAttrReadOnly) && (attrs & FAttrReadNone)),
+    "conflicting attributes");
+  verify(vs, !((attrs & FAttrAlwaysInline) && (attrs & FAttrNoInline)),
+    "conflicting attributes");
+  verify(vs, !((attrs & FAttrCold) && (attrs & FAttrHot)),
+    "conflicting attributes");
+}
+
+/* Verify the attributes of the function and of its parameters */
+static void verify_fattrs(VerifyState *vs) {
+  int i;
+  FFunction *f = f_get_function(vs->m, vs->f);
+  FFunctionType *ftype = f_get_ftype(vs->m, f->type);
+  verify_attrs(vs, f->attrs, FAttrReadOnly | FAttrReadNone | FAttrNoUnwind |
+    FAttrAlwaysInline | FAttrNoInline | FAttrCold | FAttrHot);
+  if (!f->params) return;
+  for (i = 0; i < ftype->nargs; ++i) {
+    FParamAttr *param = &f->params[i];
+    if (ftype->args[i] != FPointer) {
+      verify(vs, param->attrs == 0 && param->align == 0,
+        "attribute of non pointer argument");
+    }
+    verify_attrs(vs, param->attrs, FAttrNoAlias | FAttrNonNull |
+      FAttrReadOnly | FAttrReadNone);
+    verify_align(vs, param->align);
+  }
 }
 
 static int verify_function(FModule *m, int function, char *err) {
@@ -286,40 +519,44 @@ static int verify_function(FModule *m, int function, char *err) {
   vs.f = function;
   vs.bb = -1;
   vs.i = -1;
+  vs.id = -1;
   if(setjmp(vs.jmp)) return 1;
-  verify(&vs, function >= 0 && (size_t)function < vec_size(m->functions),
+  verify(&vs, function >= 0 && function < m->nfunctions,
     "function not found");
   f = f_get_function(m, function);
   verify_ftype(&vs);
+  verify_fattrs(&vs);
   switch (f->tag) {
     case FExtFunc:
       break;
     case FModFunc:
-      verify(&vs, vec_size(f->u.bblocks) > 0, "function without basic blocks");
-      vec_for(f->u.bblocks, bb, {
-        FBBlock *bblock = f_get_bblock(m, function, bb);
-        vs.bb = bb;
+      verify(&vs, f->u.body.nbblocks > 0, "function without basic blocks");
+      for (vs.i = 0; vs.i < f->u.body.nkonsts; ++vs.i)
+        verify(&vs, valid_type(f->u.body.konsts[vs.i].type),
+          "constant #%d has invalid type", vs.i + 1);
+      for (vs.bb = 0; vs.bb < f->u.body.nbblocks; ++vs.bb) {
         vs.bb_ended = 0;
-        vec_for(*bblock, i, {
-          vs.i = i;
+        vs.i = 0;
+        f_bblock_foreach(f, vs.bb, vs.id) {
           verify_instr(&vs);
-        });
+          vs.i++;
+        }
         verify(&vs, vs.bb_ended, "basic block not terminated");
-      });
+      }
       break;
   }
   return 0;
 }
 
 int f_verify_module(FModule *m, char *err) {
-  if (vec_empty(m->functions)) {
+  if (m->nfunctions == 0) {
     sprintf(err, "module with no functions");
     return 1;
   }
   else {
-    vec_for(m->functions, i, {
+    int i;
+    for (i = 0; i < m->nfunctions; ++i)
       if (verify_function(m, i, err)) return 1;
-    });
     return 0;
   }
 }
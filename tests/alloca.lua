@@ -0,0 +1,188 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test for the stack allocation instructions
+
+local test = require 'test'
+
+local decls = [[
+static int is_aligned(void *p, int align) {
+    return ((size_t)p & (align - 1)) == 0;
+}
+]]
+
+test.preamble(decls)
+
+-- Spill a value to a fixed slot and load it back
+test.case {
+    success = true,
+    functions = {{
+        args = {'1234'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_alloca(b, 4, 4);
+                   f_store(b, v[1], v[0]);
+            v[2] = f_load(b, v[1], FInt32);
+                   f_ret(b, v[2]);]]
+    }}
+}
+
+-- Small array of doubles in the stack
+test.case {
+    success = true,
+    functions = {{
+        args = {'1.5', '2.25'},
+        type = {'FDouble', 'FDouble', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_alloca(b, 16, 0);
+            v[3] = f_offset(b, v[2], f_consti(b, 8, FInt32), 0);
+                   f_store(b, v[2], v[0]);
+                   f_store(b, v[3], v[1]);
+            v[4] = f_load(b, v[2], FDouble);
+            v[5] = f_load(b, v[3], FDouble);
+            v[6] = f_binop(b, FSub, v[5], v[4]);
+                   f_ret(b, v[6]);]]
+    }}
+}
+
+-- Out parameter written by the callee
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FVoid', 'FPointer', 'FInt64'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_binop(b, FMul, v[1], v[1]);
+                   f_store(b, v[0], v[2]);
+                   f_ret_void(b);]]
+    },
+    {
+        args = {'12'},
+        type = {'FInt64', 'FInt64'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_alloca(b, 8, 8);
+                   f_call(b, f[0], 2, v[1], v[0]);
+            v[2] = f_load(b, v[1], FInt64);
+                   f_ret(b, v[2]);]]
+    },
+    }
+}
+
+-- Alignment bigger than the stack alignment
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FPointer', 'FInt32'},
+        ext = '(FFunctionPtr)is_aligned',
+    },
+    {
+        args = {},
+        type = {'FInt32'},
+        code = [[
+            v[0] = f_alloca(b, 1, 0);
+            v[1] = f_alloca(b, 8, 64);
+            v[2] = f_call(b, f[0], 2, v[1], f_consti(b, 64, FInt32));
+                   f_ret(b, v[2]);]]
+    },
+    }
+}
+
+-- Dynamic size filled with memset
+test.case {
+    success = true,
+    functions = {{
+        args = {'100'},
+        type = {'FInt8', 'FInt16'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            v[1] = f_alloca_dynamic(b, v[0], 32);
+            v[2] = f_consti(b, 7, FInt8);
+                   f_memset(b, v[1], v[2], v[0], 32, 0);
+            v[3] = f_offset(b, v[1], v[0], 0);
+            v[4] = f_offset(b, v[3], f_consti(b, 1, FInt16), 1);
+            v[5] = f_load(b, v[4], FInt8);
+                   f_ret(b, v[5]);]]
+    }}
+}
+
+-- Fixed size outside the entry block
+test.case {
+    success = false,
+    functions = {{
+        type = {'FPointer'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            v[0] = f_alloca(b, 8, 0);
+                   f_ret(b, v[0]);]]
+    }}
+}
+
+-- Empty fixed size
+test.case {
+    success = false,
+    functions = {{
+        type = {'FPointer'},
+        code = [[
+            v[0] = f_alloca(b, 0, 0);
+                   f_ret(b, v[0]);]]
+    }}
+}
+
+-- Invalid alignment
+test.case {
+    success = false,
+    functions = {{
+        type = {'FPointer'},
+        code = [[
+            v[0] = f_alloca(b, 8, 3);
+                   f_ret(b, v[0]);]]
+    }}
+}
+
+-- Dynamic size of float point
+test.case {
+    success = false,
+    functions = {{
+        type = {'FPointer', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_alloca_dynamic(b, v[0], 0);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+test.epilog()
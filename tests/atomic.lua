@@ -0,0 +1,228 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test for atomic instructions: atomic load/store, rmw, cmpxchg, fence
+
+local test = require 'test'
+
+test.preamble()
+
+-- Atomic load and store with each ordering
+local load_orders = {'FRelaxed', 'FAcquire', 'FSeqCst'}
+local store_orders = {'FRelaxed', 'FRelease', 'FSeqCst'}
+for i = 1, #load_orders do
+    test.case {
+        success = true,
+        decls = 'i32 cell = 5;\n',
+        functions = {{
+            args = {'&cell'},
+            type = {'FInt32', 'FPointer'},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_atomic_load(b, v[0], FInt32, ]]..
+                    load_orders[i] ..[[);
+                v[2] = f_binop(b, FAdd, v[1], f_consti(b, 1, FInt32));
+                       f_atomic_store(b, v[0], v[2], ]]..
+                    store_orders[i] ..[[);
+                       f_ret(b, v[1]);]]
+        }},
+        after = [[
+        printf("%d\n", cell);
+]]
+    }
+end
+
+-- Atomic read-modify-write operations (the old value is returned)
+local rmw_ops = {
+    {'FAtomicXchg', 3},
+    {'FAtomicAdd', -2},
+    {'FAtomicSub', -8},
+    {'FAtomicAnd', 3},
+    {'FAtomicOr', -5},
+    {'FAtomicXor', -8},
+    {'FAtomicMin', -5},
+    {'FAtomicMax', 3},
+    {'FAtomicUMin', 3},
+    {'FAtomicUMax', -5},
+}
+for _, t in ipairs(test.int_types) do
+    for _, op in ipairs(rmw_ops) do
+        local ctype = test.convert_type(t):gsub('ui', 'i')
+        test.case {
+            success = true,
+            decls = ctype .. ' cell = -5;\n',
+            functions = {{
+                args = {'&cell', '3'},
+                type = {t, 'FPointer', t},
+                code = [[
+                    v[0] = f_getarg(b, 0);
+                    v[1] = f_getarg(b, 1);
+                    v[2] = f_atomic_rmw(b, ]].. op[1] ..[[, v[0], v[1],
+                        FSeqCst);
+                           f_ret(b, v[2]);]]
+            }},
+            after = [[
+        test(cell == ]].. op[2] ..[[);
+]]
+        }
+    end
+end
+
+-- Compare and exchange that succeeds and that fails
+for _, expected in ipairs({'7', '8'}) do
+    test.case {
+        success = true,
+        decls = 'i64 cell = 7;\n',
+        functions = {{
+            args = {'&cell', expected},
+            type = {'FInt64', 'FPointer', 'FInt64'},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_cmpxchg(b, v[0], v[1], f_consti(b, 42, FInt64),
+                    FAcqRel);
+                       f_ret(b, v[2]);]]
+        }},
+        after = [[
+        printf("%d\n", (int)cell);
+]]
+    }
+end
+
+-- Compare and exchange of pointers
+test.case {
+    success = true,
+    decls = 'void *cell = NULL;\n',
+    functions = {{
+        args = {'&cell'},
+        type = {'FBool', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_cmpxchg(b, v[0], f_nullp(b), v[0], FSeqCst);
+            v[2] = f_intcmp(b, FIntEq, v[1], f_nullp(b));
+                   f_ret(b, v[2]);]]
+    }},
+    after = [[
+        test(cell == &cell);
+]]
+}
+
+-- Fences
+test.case {
+    success = true,
+    functions = {{
+        type = {'FVoid'},
+        code = [[
+            f_fence(b, FAcquire);
+            f_fence(b, FRelease);
+            f_fence(b, FAcqRel);
+            f_fence(b, FSeqCst);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Atomic load of a float
+test.case {
+    success = false,
+    functions = {{
+        type = {'FFloat', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_atomic_load(b, v[0], FFloat, FSeqCst);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Atomic load with release ordering
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_atomic_load(b, v[0], FInt32, FRelease);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Atomic store with acquire ordering
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+                   f_atomic_store(b, v[0], v[0], FAcquire);
+                   f_ret_void(b);]]
+    }}
+}
+
+-- Atomic operation over a pointer value
+test.case {
+    success = false,
+    functions = {{
+        type = {'FPointer', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_atomic_rmw(b, FAtomicXchg, v[0], v[0], FSeqCst);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Atomic operation in a non pointer
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_atomic_rmw(b, FAtomicAdd, v[0], v[0], FRelaxed);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Compare and exchange with different types
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FPointer', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_cmpxchg(b, v[0], f_consti(b, 0, FInt64), v[1],
+                FSeqCst);
+                   f_ret(b, v[2]);]]
+    }}
+}
+
+-- Relaxed fence
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid'},
+        code = [[
+            f_fence(b, FRelaxed);
+            f_ret_void(b);]]
+    }}
+}
+
+test.epilog()
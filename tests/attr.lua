@@ -0,0 +1,161 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test function and parameter attributes
+
+local test = require 'test'
+
+local decls = [[
+static i32 ints[] = {1, 2, 3, 4};
+static i32 out[4];
+
+static int ext_square(int x) {
+    return x * x;
+}
+]]
+
+test.preamble(decls)
+
+-- Pointer parameters that don't alias
+test.case {
+    success = true,
+    functions = {{
+        args = {'ints', 'out'},
+        type = {'FInt32', 'FPointer', 'FPointer'},
+        code = [[
+            f_set_argattr(&module, f[0], 0,
+                FAttrNoAlias | FAttrNonNull | FAttrReadOnly);
+            f_set_argalign(&module, f[0], 0, 16);
+            f_set_argattr(&module, f[0], 1, FAttrNoAlias);
+            f_set_fattr(&module, f[0], FAttrNoUnwind);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            f_store(b, v[1], f_consti(b, 7, FInt32));
+            v[2] = f_load(b, v[0], FInt32);
+            f_ret(b, v[2]);]]
+    }},
+    after = [[
+    printf("%d\n", out[0]);
+]]
+}
+
+-- Calls to functions with attributes
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        ext = '(FFunctionPtr)ext_square',
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            f_set_fattr(&module, f[1], FAttrAlwaysInline | FAttrReadNone);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FMul, v[0], f_consti(b, 2, FInt32));
+            f_ret(b, v[1]);]]
+    },
+    {
+        args = {'5'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            f_set_fattr(&module, f[0], FAttrReadNone | FAttrNoUnwind);
+            f_set_fattr(&module, f[2], FAttrHot);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            v[2] = f_call(b, f[0], 1, v[0]);
+            v[3] = f_call(b, f[1], 1, v[1]);
+            v[4] = f_binop(b, FAdd, v[2], v[3]);
+            f_ret(b, v[4]);]]
+    },
+    }
+}
+
+-- Rarely called function that is never inlined
+test.case {
+    success = true,
+    functions = {{
+        args = {'3'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            f_set_fattr(&module, f[0], FAttrCold | FAttrNoInline);
+            v[0] = f_getarg(b, 0);
+            f_ret(b, v[0]);]]
+    }}
+}
+
+-- Parameter attribute on a function
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid'},
+        code = [[
+            f_set_fattr(&module, f[0], FAttrNoAlias);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Conflicting function attributes
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid'},
+        code = [[
+            f_set_fattr(&module, f[0], FAttrReadOnly | FAttrReadNone);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Attribute of a non pointer argument
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FInt32'},
+        code = [[
+            f_set_argattr(&module, f[0], 0, FAttrNonNull);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Function attribute on a parameter
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            f_set_argattr(&module, f[0], 0, FAttrNoUnwind);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Invalid alignment
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            f_set_argalign(&module, f[0], 0, 12);
+            f_ret_void(b);]]
+    }}
+}
+
+test.epilog()
@@ -116,5 +116,59 @@ for i = 1, #test.types - 1 do
     end
 end
 
-test.epilog()
+-- Repeated constants share the same value
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        args = {'3'},
+        ret = '15',
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            f_set_bblock(&b, bb[1]);
+            v[0] = f_consti(b, 5, FInt32);
+            test(f_same(v[0], f_consti(b, 5, FInt32)));
+            test(!f_same(v[0], f_consti(b, 5, FInt64)));
+            test(!f_same(v[0], f_consti(b, 6, FInt32)));
+            test(f_same(f_consti(b, -1, FInt8), f_consti(b, 255, FInt8)));
+            test(f_same(f_consti(b, 2, FBool), f_constb(b, 1)));
+            test(f_same(f_constf(b, 1.5, FFloat), f_constf(b, 1.5, FFloat)));
+            test(f_same(f_nullp(b), f_constp(b, NULL)));
+            v[1] = f_binop(b, FMul, f_getarg(b, 0), v[0]);
+            f_ret(b, v[1]);
+
+            f_set_bblock(&b, bb[0]);
+            test(f_same(v[0], f_consti(b, 5, FInt32)));
+            f_jmp(b, bb[1]);
+        ]]
+    }}
+}
 
+-- Replace all uses of a value
+test.case {
+    success = true,
+    decls = 'FFunction *func;\nint u, n = 0;\n',
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        args = {'3'},
+        ret = '36',
+        code = [[
+            func = f_get_function(&module, f[0]);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FAdd, v[0], f_consti(b, 1, FInt32));
+            v[2] = f_binop(b, FMul, v[0], f_consti(b, 2, FInt32));
+            v[3] = f_binop(b, FMul, v[1], v[1]);
+            f_ret(b, v[3]);
+            f_replace_all_uses(&module, f[0], v[1], v[2]);
+            f_use_foreach(func, v[1], u)
+                test(0);
+            f_use_foreach(func, v[2], u) {
+                test(f_same(f_value(func->u.body.uses[u].user), v[3]));
+                n++;
+            }
+            test(n == 2);
+        ]]
+    }}
+}
+
+test.epilog()
@@ -0,0 +1,111 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the inlining of host functions defined in bitcode
+
+local test = require 'test'
+
+local decls = [[
+#include TEST_HELPERS
+
+#define CACHE_DIR "bitcode.d"
+]]
+
+test.preamble(decls)
+
+-- Bound external functions are part of the cache keys
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        ext = '(FFunctionPtr)helper_inc',
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_callv(b, f[0], 1, v);
+            f_ret(b, v[1]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      FModule other;
+      FEngine e;
+      test(f_add_bitcode_file(TEST_BITCODE) == 0);
+      /* The functions are already defined */
+      test(f_add_bitcode_file(TEST_BITCODE) != 0);
+      test(f_bind_bitcode((FFunctionPtr)helper_inc, "helper_inc") == 0);
+      test(f_bind_bitcode((FFunctionPtr)helper_dbl, "helper_dbl") == 0);
+      test(f_bind_bitcode((FFunctionPtr)printf, "printf") != 0);
+      f_init_compile_options(&opts, 2);
+      opts.cache_dir = CACHE_DIR;
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+      /* A module with the same shape bound to another helper */
+      f_init_module(&other);
+      f[0] = f_add_extfunction(&other, f_ftype(&other, FInt32, 1, FInt32),
+          (FFunctionPtr)helper_dbl);
+      f[1] = f_add_function(&other, f_ftype(&other, FInt32, 1, FInt32));
+      f_add_bblock(&other, f[1]);
+      b = f_builder(&other, f[1], 0);
+      v[0] = f_getarg(b, 0);
+      f_ret(b, f_callv(b, f[0], 1, v));
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &other, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, f[1], ui32, (ui32))(10));
+      f_close_engine(&e);
+      f_close_module(&other);
+    }
+]]
+}
+
+-- Bound function declared with another type
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        ext = '(FFunctionPtr)helper_inc',
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        variadic = true,
+        ext = '(FFunctionPtr)helper_inc',
+    },
+    {
+        args = {'10'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_callv(b, f[0], 1, v);
+            v[2] = f_callv(b, f[1], 1, v);
+            f_ret(b, f_binop(b, FAdd, v[1], v[2]));
+        ]]
+    },
+    }
+}
+
+test.epilog()
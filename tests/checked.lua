@@ -0,0 +1,198 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test for the unsigned division, signed remainder, arithmetic shift and the
+-- checked arithmetic operations
+
+local test = require 'test'
+
+test.preamble()
+
+-- Binary operation over two arguments
+local function binop_case(op, type, lhs, rhs)
+    test.case {
+        success = true,
+        functions = {{
+            args = {lhs, rhs},
+            type = {type, type, type},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_binop(b, ]].. op ..[[, v[0], v[1]);
+                       f_ret(b, v[2]);]]
+        }}
+    }
+end
+
+-- Checked operation that returns the wrapped value
+local function value_case(op, type, lhs, rhs)
+    test.case {
+        success = true,
+        functions = {{
+            args = {lhs, rhs},
+            type = {type, type, type},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_checked(b, ]].. op ..[[, v[0], v[1]);
+                       f_ret(b, v[2]);]]
+        }}
+    }
+end
+
+-- Checked operation that returns the overflow flag
+local function flag_case(op, type, lhs, rhs)
+    test.case {
+        success = true,
+        functions = {{
+            args = {lhs, rhs},
+            type = {'FBool', type, type},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_checked(b, ]].. op ..[[, v[0], v[1]);
+                v[3] = f_overflowed(b, v[2]);
+                       f_ret(b, v[3]);]]
+        }}
+    }
+end
+
+-- Checked operation that overflows and one that doesn't
+local function checked_case(op, type, lhs, rhs, safe_lhs, safe_rhs)
+    value_case(op, type, lhs, rhs)
+    flag_case(op, type, lhs, rhs)
+    value_case(op, type, safe_lhs, safe_rhs)
+    flag_case(op, type, safe_lhs, safe_rhs)
+end
+
+local max = {
+    FInt8 = '0x7f', FInt16 = '0x7fff', FInt32 = '0x7fffffff',
+    FInt64 = '0x7fffffffffffffff'
+}
+
+for _, t in ipairs(test.int_types) do
+    binop_case('FUDiv', t, '-8', '3')
+    binop_case('FSRem', t, '-8', '3')
+    binop_case('FSRem', t, '8', '-3')
+    binop_case('FAShr', t, '-8', '1')
+    binop_case('FAShr', t, max[t], '2')
+    checked_case('FCheckedSAdd', t, max[t], '1', '-3', '2')
+    checked_case('FCheckedUAdd', t, '-1', '1', max[t], '1')
+    checked_case('FCheckedSSub', t, '-' .. max[t], '2', '3', '-2')
+    checked_case('FCheckedUSub', t, '1', '2', '2', '1')
+    checked_case('FCheckedSMul', t, max[t], '2', '-3', '5')
+    checked_case('FCheckedUMul', t, '-1', '2', '3', '5')
+end
+
+-- Count the additions until the accumulator overflows
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt8', 'FInt8'},
+        args = {'30'},
+        ret = 4,
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+            bb[3] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 0, FInt8);
+            f_jmp(b, bb[1]);
+
+            /* loop header */
+            b = f_builder(&module, f[0], bb[1]);
+            v[2] = f_phi(b, FInt8);
+            v[3] = f_phi(b, FInt8);
+            v[4] = f_checked(b, FCheckedSAdd, v[2], v[0]);
+            v[5] = f_overflowed(b, v[4]);
+            f_jmpif(b, v[5], bb[3], bb[2]);
+
+            /* loop body */
+            b = f_builder(&module, f[0], bb[2]);
+            v[6] = f_binop(b, FAdd, v[3], f_consti(b, 1, FInt8));
+            f_jmp(b, bb[1]);
+
+            /* return */
+            b = f_builder(&module, f[0], bb[3]);
+            f_ret(b, v[3]);
+
+            f_add_incoming(b, v[2], bb[0], v[1]);
+            f_add_incoming(b, v[2], bb[2], v[4]);
+
+            f_add_incoming(b, v[3], bb[0], v[1]);
+            f_add_incoming(b, v[3], bb[2], v[6]);
+        ]]
+    }}
+}
+
+-- Checked operation over float points
+test.case {
+    success = false,
+    functions = {{
+        type = {'FDouble', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_checked(b, FCheckedSAdd, v[0], v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Checked operation with different types
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FInt32', 'FInt64'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_checked(b, FCheckedUMul, v[0], v[1]);
+                   f_ret(b, v[2]);]]
+    }}
+}
+
+-- Overflow flag of an unchecked operation
+test.case {
+    success = false,
+    functions = {{
+        type = {'FBool', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FAdd, v[0], v[0]);
+            v[2] = f_overflowed(b, v[1]);
+                   f_ret(b, v[2]);]]
+    }}
+}
+
+-- Unsigned division of float points
+test.case {
+    success = false,
+    functions = {{
+        type = {'FFloat', 'FFloat'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FUDiv, v[0], v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+test.epilog()
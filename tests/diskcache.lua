@@ -0,0 +1,150 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the on-disk object cache
+
+local test = require 'test'
+
+local decls = [[
+#define CACHE_DIR "diskcache.d"
+]] .. test.cachefiles .. [[
+
+/* Overwrite a cached object with the contents of another
+ * The files start with the check hash of their key (8 bytes). If keep_check
+ * is set, the check of the overwritten file is kept, so the cache accepts the
+ * other object under the key of the file. */
+static void copy_object(const char *to, const char *from, int keep_check) {
+  FILE *in, *out;
+  char check[8];
+  int c, n = 0;
+  if (keep_check) {
+    in = fopen(to, "rb");
+    if (!in || fread(check, 1, sizeof(check), in) != sizeof(check)) {
+      fprintf(stderr, "unable to read %s\n", to);
+      exit(1);
+    }
+    fclose(in);
+  }
+  in = fopen(from, "rb");
+  out = fopen(to, "wb");
+  if (!in || !out) {
+    fprintf(stderr, "unable to copy %s\n", from);
+    exit(1);
+  }
+  while ((c = fgetc(in)) != EOF) {
+    fputc(keep_check && n < 8 ? check[n] : c, out);
+    n++;
+  }
+  fclose(in);
+  fclose(out);
+}
+
+/* Overwrite the start of the object with zeros, keeping the header */
+static void corrupt_object(const char *path) {
+  FILE *f = fopen(path, "r+b");
+  int i;
+  if (!f || fseek(f, 16, SEEK_SET) != 0) {
+    fprintf(stderr, "unable to corrupt %s\n", path);
+    exit(1);
+  }
+  for (i = 0; i < 16; ++i)
+    fputc(0, f);
+  fclose(f);
+}
+]]
+
+test.preamble(decls)
+
+-- Store the objects and reuse them by key
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FAdd, v[0], f_consti(b, 1, FInt32));
+            f_ret(b, v[1]);
+        ]]
+    }},
+    after = [[
+    {
+      FCompileOptions opts;
+      FModule other;
+      FEngine e;
+      char first[256] = "", second[256] = "";
+      f_init_compile_options(&opts, 2);
+      opts.cache_dir = CACHE_DIR;
+      clear_cache();
+      /* Miss: the object is generated and stored */
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(first, ""));
+      /* A module with the same shape and another body has its own key */
+      f_init_module(&other);
+      f_add_function(&other, f_ftype(&other, FInt32, 1, FInt32));
+      f_add_bblock(&other, 0);
+      b = f_builder(&other, 0, 0);
+      v[0] = f_getarg(b, 0);
+      f_ret(b, f_binop(b, FMul, v[0], f_consti(b, 2, FInt32)));
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &other, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, 0, ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(second, first));
+      f_close_engine(&e);
+      f_close_module(&other);
+      /* Hit: replace the first object to see that it is loaded instead of
+       * generated again */
+      copy_object(first, second, 1);
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, f[0], ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(second, first));
+      f_close_engine(&e);
+      /* The check of another key is rejected, so the object is generated
+       * again and overwritten */
+      copy_object(first, second, 0);
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, f[0], ui32, (ui32))(10));
+      f_close_engine(&e);
+      /* So is an object that can't be parsed */
+      corrupt_object(first);
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, f[0], ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(second, first));
+      f_close_engine(&e);
+      /* The options are part of the key */
+      opts.opt_level = 3;
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(second, first));
+      opts.features = "";
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+      printf("objects: %d\n", count_objects(second, first));
+      clear_cache();
+    }
+]]
+}
+
+test.epilog()
@@ -0,0 +1,142 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the cache of compiled functions
+
+local test = require 'test'
+
+local decls = [[
+static FCacheStats stats, last;
+
+/* Print the change of the cache statistics since the last call */
+static void print_stats(void) {
+  f_get_function_cache_stats(&stats);
+  printf("hits %lu, misses %lu, evictions %lu, entries %d\n",
+    stats.hits - last.hits, stats.misses - last.misses,
+    stats.evictions - last.evictions, (int)stats.entries);
+  last = stats;
+}
+]]
+
+test.preamble(decls)
+
+-- Reuse, key and evict the functions
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FAdd, v[0], f_consti(b, 1, FInt32));
+            f_ret(b, v[1]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            f_ret(b, v[1]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      FEngine e;
+      size_t size;
+      f_init_compile_options(&opts, 2);
+      f_set_function_cache_budget(1 << 30);
+      f_clear_function_cache();
+      f_get_function_cache_stats(&last);
+      /* Miss: the functions are compiled and cached */
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+      print_stats();
+      size = stats.size;
+      printf("%d\n", size > 0);
+      /* Hit: another engine reuses the functions */
+      f_init_engine(&e);
+      test(f_compile_ex(&e, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&e, f[1], ui32, (ui32))(10));
+      print_stats();
+      printf("%d\n", stats.size == size);
+      f_close_engine(&e);
+      /* The options are part of the key */
+      opts.opt_level = 3;
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+      print_stats();
+      printf("%d\n", stats.size > size);
+      /* Evict the compilations that don't fit the budget, each one is only
+       * released with its last function */
+      f_set_function_cache_budget(stats.size - 1);
+      print_stats();
+      printf("%d\n", stats.size < stats.budget);
+      f_set_function_cache_budget(1);
+      print_stats();
+      printf("%d\n", stats.size == 0);
+      /* A compilation bigger than the budget isn't cached */
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+      print_stats();
+      f_set_function_cache_budget(0);
+    }
+]]
+}
+
+-- Reuse a function of the same engine in an incremental compilation
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FAdd, v[0], f_consti(b, 1, FInt32));
+            f_ret(b, v[1]);
+        ]]
+    }},
+    after = [[
+    {
+      int i;
+      f_set_function_cache_budget(1 << 30);
+      f_get_function_cache_stats(&last);
+      test(f_compile(&engine, &module) == 0);
+      print_stats();
+      for (i = 1; i <= 2; ++i) {
+        f[i] = f_add_function(&module, f_ftype(&module, FInt32, 1, FInt32));
+        bb[0] = f_add_bblock(&module, f[i]);
+        b = f_builder(&module, f[i], bb[0]);
+        v[0] = f_getarg(b, 0);
+        v[1] = f_binop(b, FAdd, v[0], f_consti(b, 1, FInt32));
+        f_ret(b, v[1]);
+        test(f_compile_incremental(&engine, &module) == 0);
+        printf("%u\n", f_get_fpointer(&engine, f[i], ui32, (ui32))(10));
+        print_stats();
+      }
+      f_set_function_cache_budget(0);
+    }
+]]
+}
+
+test.epilog()
@@ -0,0 +1,115 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test incremental compilation
+
+local test = require 'test'
+
+test.preamble()
+
+-- Add functions that call the previously compiled ones
+test.case {
+    success = true,
+    functions = {{
+        args = {'1'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    }},
+    after = [[
+    f[1] = f_add_function(&module, f_ftype(&module, FInt32, 1, FInt32));
+    bb[0] = f_add_bblock(&module, f[1]);
+    b = f_builder(&module, f[1], bb[0]);
+    v[0] = f_getarg(b, 0);
+    v[1] = f_call(b, f[0], 1, v[0]);
+    v[2] = f_call(b, f[0], 1, v[1]);
+    f_ret(b, v[2]);
+    test(f_verify_module(&module, err) == 0);
+    test(f_compile_incremental(&engine, &module) == 0);
+    test(engine.nfuncs == 2);
+    printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+    f[2] = f_add_function(&module, f_ftype(&module, FInt32, 1, FInt32));
+    bb[0] = f_add_bblock(&module, f[2]);
+    b = f_builder(&module, f[2], bb[0]);
+    v[0] = f_getarg(b, 0);
+    v[1] = f_call(b, f[1], 1, v[0]);
+    v[2] = f_call(b, f[0], 1, v[1]);
+    f_ret(b, v[2]);
+    test(f_verify_module(&module, err) == 0);
+    test(f_compile_incremental(&engine, &module) == 0);
+    test(engine.nfuncs == 3);
+    printf("%u\n", f_get_fpointer(&engine, f[2], ui32, (ui32))(10));
+    printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+]]
+}
+
+-- Compile an empty engine incrementally
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            f_ret(b, v[0]);
+        ]]
+    }},
+    after = [[
+    test(f_compile_incremental(&engine, &module) == 0);
+    test(f_compile_incremental(&engine, &module) == 0);
+    test(engine.nfuncs == 1);
+    printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+]]
+}
+
+-- Reset the module and build a new one reusing its memory
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            f_ret(b, v[0]);
+        ]]
+    }},
+    after = [[
+    test(f_compile(&engine, &module) == 0);
+    f_reset_module(&module);
+    test(module.nfunctions == 0);
+    f[0] = f_add_function(&module, f_ftype(&module, FInt32, 1, FInt32));
+    bb[0] = f_add_bblock(&module, f[0]);
+    b = f_builder(&module, f[0], bb[0]);
+    v[0] = f_getarg(b, 0);
+    v[1] = f_consti(b, 3, FInt32);
+    v[2] = f_binop(b, FMul, v[0], v[1]);
+    f_ret(b, v[2]);
+    test(f_verify_module(&module, err) == 0);
+    test(f_compile(&engine, &module) == 0);
+    test(engine.nfuncs == 1);
+    printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(10));
+]]
+}
+
+test.epilog()
@@ -0,0 +1,188 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the interpreter
+
+local test = require 'test'
+
+local decls = [[
+static double ext_mix(int a, double b, float c, ui64 d, void *p) {
+    return a + b + c + d + (p != NULL);
+}
+]]
+
+test.preamble(decls)
+
+-- Count the calls and the loop iterations
+test.case {
+    success = true,
+    decls = 'FInterp it; FInterpProfile prof;',
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+            bb[3] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 0, FInt32);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            v[2] = f_phi(b, FInt32);
+            v[3] = f_phi(b, FInt32);
+            v[4] = f_intcmp(b, FIntSLt, v[2], v[0]);
+            f_jmpif(b, v[4], bb[2], bb[3]);
+
+            b = f_builder(&module, f[0], bb[2]);
+            v[5] = f_binop(b, FAdd, v[3], v[2]);
+            v[6] = f_binop(b, FAdd, v[2], f_consti(b, 1, FInt32));
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[3]);
+            f_ret(b, v[3]);
+
+            f_add_incoming(b, v[2], bb[0], v[1]);
+            f_add_incoming(b, v[2], bb[2], v[6]);
+            f_add_incoming(b, v[3], bb[0], v[1]);
+            f_add_incoming(b, v[3], bb[2], v[5]);
+        ]]
+    }},
+    after = [[
+    f_init_interp(&it, &module);
+    printf("%u\n", (unsigned)f_interp_call(&it, f[0], 10).i);
+    f_interp_profile(&it, f[0], &prof);
+    printf("%lu %lu\n", prof.calls, prof.backedges);
+    printf("%u\n", (unsigned)f_interp_call(&it, f[0], 5).i);
+    f_interp_profile(&it, f[0], &prof);
+    printf("%lu %lu\n", prof.calls, prof.backedges);
+    f_interp_reset_profile(&it);
+    f_interp_profile(&it, f[0], &prof);
+    printf("%lu %lu\n", prof.calls, prof.backedges);
+    f_close_interp(&it);
+    ]]
+}
+
+-- Recursive calls
+test.case {
+    success = true,
+    decls = 'FInterp it; FInterpProfile prof;',
+    functions = {{
+        type = {'FInt64', 'FInt64'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_intcmp(b, FIntSLt, v[0], f_consti(b, 2, FInt64));
+            f_jmpif(b, v[1], bb[1], bb[2]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            f_ret(b, v[0]);
+
+            b = f_builder(&module, f[0], bb[2]);
+            v[2] = f_binop(b, FSub, v[0], f_consti(b, 1, FInt64));
+            v[3] = f_call(b, f[0], 1, v[2]);
+            v[4] = f_binop(b, FSub, v[0], f_consti(b, 2, FInt64));
+            v[5] = f_call(b, f[0], 1, v[4]);
+            v[6] = f_binop(b, FAdd, v[3], v[5]);
+            f_ret(b, v[6]);
+        ]]
+    }},
+    after = [[
+    f_init_interp(&it, &module);
+    printf("%lu\n", f_interp_call(&it, f[0], (ui64)10).i);
+    f_interp_profile(&it, f[0], &prof);
+    printf("%lu %lu\n", prof.calls, prof.backedges);
+    f_close_interp(&it);
+    ]]
+}
+
+-- Call an external function with mixed argument types
+test.case {
+    success = true,
+    decls = 'FInterp it;',
+    functions = {
+    {
+        type = {'FDouble', 'FInt32', 'FDouble', 'FFloat', 'FInt64',
+                'FPointer'},
+        ext = '(FFunctionPtr)ext_mix',
+    },
+    {
+        type = {'FDouble', 'FFloat'},
+        code = [[
+            v[0] = f_consti(b, 1, FInt32);
+            v[1] = f_constf(b, 0.5, FDouble);
+            v[2] = f_getarg(b, 0);
+            v[3] = f_consti(b, 100, FInt64);
+            v[4] = f_constp(b, &module);
+            v[5] = f_callv(b, f[0], 5, v);
+            f_ret(b, v[5]);
+        ]]
+    },
+    },
+    after = [[
+    f_init_interp(&it, &module);
+    printf("%g\n", f_interp_call(&it, f[1], 0.25).d);
+    f_close_interp(&it);
+    ]]
+}
+
+-- Check the functions before calling them
+test.case {
+    success = true,
+    decls = 'FInterp it; FModule vec; int caller, callee;',
+    functions = {{
+        args = {'4'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            f_ret(b, f_binop(b, FMul, v[0], v[0]));
+        ]]
+    }},
+    after = [[
+    f_init_interp(&it, &module);
+    printf("%d\n", f_interp_check(&it, f[0]));
+    f_close_interp(&it);
+    /* The callee sums the lanes of a vector */
+    f_init_module(&vec);
+    callee = f_add_function(&vec, f_ftype(&vec, FInt32, 1, FInt32));
+    f_add_bblock(&vec, callee);
+    b = f_builder(&vec, callee, 0);
+    v[0] = f_splat(b, f_getarg(b, 0), 4);
+    f_ret(b, f_reduce(b, FAdd, v[0]));
+    caller = f_add_function(&vec, f_ftype(&vec, FInt32, 1, FInt32));
+    f_add_bblock(&vec, caller);
+    b = f_builder(&vec, caller, 0);
+    v[0] = f_getarg(b, 0);
+    f_ret(b, f_call(b, callee, 1, v[0]));
+    test(f_verify_module(&vec, NULL) == 0);
+    f_init_interp(&it, &vec);
+    printf("%d %d\n", f_interp_check(&it, callee) != 0,
+        f_interp_check(&it, caller) != 0);
+    f_close_interp(&it);
+    f_close_module(&vec);
+    ]]
+}
+
+test.epilog()
+
@@ -0,0 +1,121 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test lazy compilation
+
+local test = require 'test'
+
+local decls = [[
+#define CACHE_DIR "lazy.d"
+]] .. test.cachefiles
+
+test.preamble(decls)
+
+-- Compile the functions on their first call
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            f_ret(b, v[1]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      f_init_compile_options(&opts, 2);
+      opts.lazy = 1;
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(10));
+      printf("%u\n", f_get_fpointer(&engine, f[1], ui32, (ui32))(20));
+      printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(30));
+    }
+]]
+}
+
+-- Only the called functions are compiled
+-- Each lazy function is stored in its own object, so the objects in the cache
+-- show which functions were compiled.
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 2, FInt32);
+            v[2] = f_binop(b, FMul, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            f_ret(b, v[1]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      char name[256];
+      f_init_compile_options(&opts, 2);
+      opts.lazy = 1;
+      opts.cache_dir = CACHE_DIR;
+      clear_cache();
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("compiled: %d\n", count_objects(name, ""));
+      printf("%u\n", f_get_fpointer(&engine, f[2], ui32, (ui32))(10));
+      printf("compiled: %d\n", count_objects(name, ""));
+      printf("%u\n", f_get_fpointer(&engine, f[2], ui32, (ui32))(20));
+      printf("%u\n", f_get_fpointer(&engine, f[0], ui32, (ui32))(30));
+      printf("compiled: %d\n", count_objects(name, ""));
+      clear_cache();
+    }
+]]
+}
+
+test.epilog()
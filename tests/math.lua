@@ -0,0 +1,196 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test for the math and bit manipulation operations: unop, ternop and the
+-- binops min, max and rotate
+
+local test = require 'test'
+
+test.preamble()
+
+-- Unary operation over an argument
+local function unop_case(op, type, arg)
+    test.case {
+        success = true,
+        functions = {{
+            args = {arg},
+            type = {type, type},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_unop(b, ]].. op ..[[, v[0]);
+                       f_ret(b, v[1]);]]
+        }}
+    }
+end
+
+-- Binary operation over two arguments
+local function binop_case(op, type, lhs, rhs)
+    test.case {
+        success = true,
+        functions = {{
+            args = {lhs, rhs},
+            type = {type, type, type},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_binop(b, ]].. op ..[[, v[0], v[1]);
+                       f_ret(b, v[2]);]]
+        }}
+    }
+end
+
+-- Bit manipulation of each integer type
+for _, t in ipairs(test.int_types) do
+    for _, op in ipairs({'FAbs', 'FPopcount', 'FCtlz', 'FCttz'}) do
+        unop_case(op, t, '-12')
+    end
+    unop_case('FCtlz', t, '0')
+    unop_case('FCttz', t, '0')
+    if t ~= 'FInt8' then
+        unop_case('FBswap', t, '0x1234')
+    end
+    binop_case('FMin', t, '-3', '2')
+    binop_case('FMax', t, '-3', '2')
+    binop_case('FUMin', t, '-3', '2')
+    binop_case('FUMax', t, '-3', '2')
+    binop_case('FRotl', t, '0x81', '4')
+    binop_case('FRotr', t, '0x81', '4')
+end
+
+-- Rotation amount bigger than the width
+binop_case('FRotl', 'FInt32', '1', '33')
+
+-- Float point operations
+for _, t in ipairs(test.float_types) do
+    for _, op in ipairs({'FSqrt', 'FFloor', 'FCeil'}) do
+        unop_case(op, t, '6.25')
+    end
+    unop_case('FAbs', t, '-1.5')
+    unop_case('FFloor', t, '-1.5')
+    binop_case('FMin', t, '-1.5', '2.5')
+    binop_case('FMax', t, '-1.5', '2.5')
+    binop_case('FMin', t, '0.0 / 0.0', '2.5')
+    test.case {
+        success = true,
+        functions = {{
+            args = {'1.5', '2.0', '0.25'},
+            type = {t, t, t, t},
+            code = [[
+                v[0] = f_getarg(b, 0);
+                v[1] = f_getarg(b, 1);
+                v[2] = f_getarg(b, 2);
+                v[3] = f_ternop(b, FFma, v[0], v[1], v[2]);
+                       f_ret(b, v[3]);]]
+        }}
+    }
+end
+
+-- Fused multiply add rounds once: the product is 1 - 2^-54, which is rounded
+-- to 1 before the addition when the operation isn't fused
+test.case {
+    success = true,
+    functions = {{
+        args = {'1.0 + 1.0 / 134217728', '1.0 - 1.0 / 134217728', '-1.0'},
+        type = {'FDouble', 'FDouble', 'FDouble', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_getarg(b, 2);
+            v[3] = f_ternop(b, FFma, v[0], v[1], v[2]);
+                   f_ret(b, v[3]);]]
+    }}
+}
+
+-- Square root of an integer
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_unop(b, FSqrt, v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Population count of a float point
+test.case {
+    success = false,
+    functions = {{
+        type = {'FDouble', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_unop(b, FPopcount, v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Byte swap of a single byte
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt8', 'FInt8'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_unop(b, FBswap, v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Unsigned minimum of float points
+test.case {
+    success = false,
+    functions = {{
+        type = {'FFloat', 'FFloat'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_binop(b, FUMin, v[0], v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Fused multiply add of integers
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_ternop(b, FFma, v[0], v[0], v[0]);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Fused multiply add with different types
+test.case {
+    success = false,
+    functions = {{
+        type = {'FFloat', 'FFloat', 'FDouble'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_ternop(b, FFma, v[0], v[0], v[1]);
+                   f_ret(b, v[2]);]]
+    }}
+}
+
+test.epilog()
@@ -0,0 +1,186 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test for bulk memory instructions: memcpy, memmove, memset, prefetch
+
+local test = require 'test'
+
+local decls = [[
+static i8 src[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+static i8 dst[8];
+]]
+
+test.preamble(decls)
+
+-- Copy between buffers
+test.case {
+    success = true,
+    functions = {{
+        args = {'dst', 'src', '6'},
+        type = {'FVoid', 'FPointer', 'FPointer', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_getarg(b, 2);
+                   f_memcpy(b, v[0], v[1], v[2], 1, 0);
+                   f_ret_void(b);]]
+    }},
+    after = [[
+    printf("%d %d %d\n", dst[0], dst[5], dst[6]);
+]]
+}
+
+-- Copy a constant size with alignment and volatile
+test.case {
+    success = true,
+    functions = {{
+        args = {'dst', 'src'},
+        type = {'FVoid', 'FPointer', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_consti(b, 8, FInt64);
+                   f_memcpy(b, v[0], v[1], v[2], 8, 1);
+                   f_ret_void(b);]]
+    }},
+    after = [[
+    printf("%d %d\n", dst[0], dst[7]);
+]]
+}
+
+-- Move between overlapping regions
+test.case {
+    success = true,
+    functions = {{
+        args = {'src'},
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 2, FInt32);
+            v[2] = f_offset(b, v[0], v[1], 0);
+            v[3] = f_consti(b, 4, FInt16);
+                   f_memmove(b, v[2], v[0], v[3], 0, 0);
+                   f_ret_void(b);]]
+    }},
+    after = [[
+    printf("%d %d %d %d\n", src[2], src[3], src[4], src[5]);
+]]
+}
+
+-- Fill a buffer
+test.case {
+    success = true,
+    functions = {{
+        args = {'dst', '42'},
+        type = {'FVoid', 'FPointer', 'FInt8'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_consti(b, 5, FInt32);
+                   f_memset(b, v[0], v[1], v[2], 4, 0);
+                   f_ret_void(b);]]
+    }},
+    after = [[
+    printf("%d %d %d\n", dst[0], dst[4], dst[5]);
+]]
+}
+
+-- Prefetch for reading and writing
+test.case {
+    success = true,
+    functions = {{
+        args = {'src'},
+        type = {'FInt8', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+                   f_prefetch(b, v[0], 0, 3);
+                   f_prefetch(b, v[0], 1, 0);
+            v[1] = f_load(b, v[0], FInt8);
+                   f_ret(b, v[1]);]]
+    }}
+}
+
+-- Copy from a non pointer
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer', 'FInt64'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+                   f_memcpy(b, v[0], v[1], v[1], 0, 0);
+                   f_ret_void(b);]]
+    }}
+}
+
+-- Non integer size
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+                   f_memmove(b, v[0], v[1], v[1], 0, 0);
+                   f_ret_void(b);]]
+    }}
+}
+
+-- Fill with a value that isn't a byte
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+                   f_memset(b, v[0], v[1], v[1], 0, 0);
+                   f_ret_void(b);]]
+    }}
+}
+
+-- Invalid alignment
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer', 'FInt8'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+                   f_memset(b, v[0], v[1], f_consti(b, 1, FInt32), 3, 0);
+                   f_ret_void(b);]]
+    }}
+}
+
+-- Invalid locality
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+                   f_prefetch(b, v[0], 0, 4);
+                   f_ret_void(b);]]
+    }}
+}
+
+test.epilog()
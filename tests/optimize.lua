@@ -0,0 +1,107 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the optimization levels and passes
+
+local test = require 'test'
+
+local decls = [[
+static ui32 array[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+  17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33};
+
+/* Run the functions of the module and print the results */
+static void run(FEngine *e, const char *name, int sum, int twice) {
+  ui32 n = sizeof(array) / sizeof(*array);
+  printf("%s: %u %u\n", name,
+         f_get_fpointer(e, sum, ui32, (void *, ui32))(array, n),
+         f_get_fpointer(e, twice, ui32, (void *, ui32))(array, n));
+}
+]]
+
+test.preamble(decls)
+
+-- Compile the same module with each level and with each pass alone
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FPointer', 'FInt32'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+            bb[3] = f_add_bblock(&module, f[0]);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_consti(b, 0, FInt32);
+            f_jmp(b, bb[1]);
+            b = f_builder(&module, f[0], bb[1]);
+            v[3] = f_phi(b, FInt32);
+            v[4] = f_phi(b, FInt32);
+            v[5] = f_intcmp(b, FIntULt, v[3], v[1]);
+            f_jmpif(b, v[5], bb[2], bb[3]);
+            b = f_builder(&module, f[0], bb[2]);
+            v[6] = f_arr_get(b, ui32, v[0], v[3], FInt32);
+            v[7] = f_binop(b, FAdd, v[4], v[6]);
+            v[8] = f_binop(b, FAdd, v[3], f_consti(b, 1, FInt32));
+            f_jmp(b, bb[1]);
+            b = f_builder(&module, f[0], bb[3]);
+            f_ret(b, v[4]);
+            f_add_incoming(b, v[3], bb[0], v[2]);
+            f_add_incoming(b, v[3], bb[2], v[8]);
+            f_add_incoming(b, v[4], bb[0], v[2]);
+            f_add_incoming(b, v[4], bb[2], v[7]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FPointer', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_getarg(b, 1);
+            v[2] = f_call(b, f[0], 2, v[0], v[1]);
+            v[3] = f_call(b, f[0], 2, v[0], v[1]);
+            f_ret(b, f_binop(b, FAdd, v[2], v[3]));
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      const char *names[] = {"mem2reg", "instcombine", "gvn", "licm",
+        "loop unroll", "loop vectorize", "slp vectorize", "inline"};
+      int i;
+      f_init_compile_options(&opts, 0);
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      run(&engine, "level 0", f[0], f[1]);
+      f_init_compile_options(&opts, 3);
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      run(&engine, "level 3", f[0], f[1]);
+      for (i = 0; i < 8; ++i) {
+        f_init_compile_options(&opts, 0);
+        opts.passes = 1 << i;
+        test(f_compile_ex(&engine, &module, &opts) == 0);
+        run(&engine, names[i], f[0], f[1]);
+      }
+    }
+]]
+}
+
+test.epilog()
@@ -0,0 +1,90 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the parallel code generation
+
+local test = require 'test'
+
+test.preamble()
+
+-- Generate the code of the module partitions in parallel
+-- The functions call each other across the partitions.
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            v[2] = f_binop(b, FMul, v[1], f_consti(b, 2, FInt32));
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[1], 1, v[0]);
+            v[2] = f_call(b, f[0], 1, v[0]);
+            v[3] = f_binop(b, FAdd, v[1], v[2]);
+            f_ret(b, v[3]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[2], 1, v[0]);
+            v[2] = f_binop(b, FSub, v[1], f_consti(b, 1, FInt32));
+            f_ret(b, v[2]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileOptions opts;
+      int nthreads[] = {1, 2, 3, 8};
+      int n, i;
+      f_init_compile_options(&opts, 2);
+      for (n = 0; n < 4; ++n) {
+        opts.nthreads = nthreads[n];
+        test(f_compile_ex(&engine, &module, &opts) == 0);
+        printf("%d threads:", nthreads[n]);
+        for (i = 0; i < 4; ++i)
+          printf(" %u", f_get_fpointer(&engine, f[i], ui32, (ui32))(10));
+        printf("\n");
+      }
+    }
+]]
+}
+
+test.epilog()
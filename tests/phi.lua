@@ -194,5 +194,36 @@ test.case {
     }}
 }
 
+-- Blocks built out of order
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        args = {'3'},
+        ret = '30',
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 10, FInt32);
+            v[2] = f_intcmp(b, FIntSLt, v[0], v[1]);
+            f_jmpif(b, v[2], bb[1], bb[2]);
+
+            f_set_bblock(&b, bb[2]);
+            v[3] = f_phi(b, FInt32);
+
+            f_set_bblock(&b, bb[1]);
+            v[4] = f_binop(b, FMul, v[0], v[1]);
+            f_jmp(b, bb[2]);
+
+            f_set_bblock(&b, bb[2]);
+            f_add_incoming(b, v[3], bb[0], v[0]);
+            f_add_incoming(b, v[3], bb[1], v[4]);
+            f_ret(b, v[3]);
+        ]]
+    }}
+}
+
 test.epilog()
 
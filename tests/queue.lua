@@ -0,0 +1,129 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the background compilation queue
+
+local test = require 'test'
+
+local decls = test.lockedmem .. [[
+
+#define NJOBS 4
+
+static pthread_mutex_t calllock = PTHREAD_MUTEX_INITIALIZER;
+static int ncallbacks = 0;
+static int callback_status = 0;
+
+/* Count the finished jobs (called by the compiler threads) */
+static void compiled(FEngine *e, int status, void *userdata) {
+  (void)e;
+  (void)userdata;
+  pthread_mutex_lock(&calllock);
+  ncallbacks++;
+  callback_status |= status;
+  pthread_mutex_unlock(&calllock);
+}
+
+/* Build a module that computes x * k + 1 */
+static int build(FModule *m, ui32 k) {
+  FBuilder b;
+  FValue x;
+  int f;
+  f_init_module(m);
+  f = f_add_function(m, f_ftype(m, FInt32, 1, FInt32));
+  b = f_builder(m, f, f_add_bblock(m, f));
+  x = f_binop(b, FMul, f_getarg(b, 0), f_consti(b, k, FInt32));
+  f_ret(b, f_binop(b, FAdd, x, f_consti(b, 1, FInt32)));
+  return f;
+}
+
+/* Print the results of the engines */
+static void print_results(FEngine *engines, int *f) {
+  int i;
+  for (i = 0; i < NJOBS; ++i)
+    printf(" %u", f_get_fpointer(&engines[i], f[i], ui32, (ui32))(10));
+  printf("\n");
+}
+]]
+
+test.preamble(decls)
+
+-- Compile modules in background and wait for them
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            f_ret(b, f_getarg(b, 0));
+        ]]
+    },
+    },
+    after = [[
+    {
+      FCompileQueue queue;
+      FCompileOptions opts;
+      FModule modules[NJOBS];
+      FEngine engines[NJOBS];
+      FCompileJob *jobs[NJOBS];
+      int i;
+      mem_alloc = lockedmem;
+      f_init_queue(&queue, 2);
+      for (i = 0; i < NJOBS; ++i) {
+        f[i] = build(&modules[i], i + 2);
+        f_init_engine(&engines[i]);
+        engines[i].backend = TEST_BACKEND;
+        jobs[i] = f_compile_async(&queue, &engines[i], &modules[i], NULL,
+            compiled, NULL);
+      }
+      for (i = 0; i < NJOBS; ++i) {
+        test(f_job_wait(jobs[i]) == 0);
+        test(f_job_done(jobs[i]));
+        f_job_release(jobs[i]);
+      }
+      printf("callbacks: %d, status: %d\n", ncallbacks, callback_status);
+      printf("waited:");
+      print_results(engines, f);
+      /* Closing the queue finishes the pending jobs */
+      f_init_compile_options(&opts, 0);
+      for (i = 0; i < NJOBS; ++i) {
+        f_close_engine(&engines[i]);
+        f_init_engine(&engines[i]);
+        engines[i].backend = TEST_BACKEND;
+        jobs[i] = f_compile_async(&queue, &engines[i], &modules[i], &opts,
+            i % 2 ? compiled : NULL, NULL);
+        f_job_release(jobs[i]);
+      }
+      f_close_queue(&queue);
+      printf("callbacks: %d, status: %d\n", ncallbacks, callback_status);
+      printf("closed:");
+      print_results(engines, f);
+      for (i = 0; i < NJOBS; ++i) {
+        f_close_engine(&engines[i]);
+        f_close_module(&modules[i]);
+      }
+      mem_alloc = checkmem;
+      test(threadmem == 0);
+    }
+]]
+}
+
+test.epilog()
@@ -119,6 +119,73 @@ function test.default_value(type)
     end
 end
 
+-- Declarations of an allocator that can be used by several threads
+-- The harness counter isn't thread-safe, so set mem_alloc to lockedmem while
+-- other threads allocate and check that threadmem is 0 afterwards.
+test.lockedmem = [[
+#include <pthread.h>
+
+static pthread_mutex_t memlock = PTHREAD_MUTEX_INITIALIZER;
+static int threadmem = 0;
+
+static void *lockedmem(void *addr, size_t oldsize, size_t newsize) {
+  void *p;
+  pthread_mutex_lock(&memlock);
+  threadmem = threadmem - oldsize + newsize;
+  p = mem_alloc_(addr, oldsize, newsize);
+  pthread_mutex_unlock(&memlock);
+  return p;
+}
+]]
+
+-- Declarations of functions that list the objects of the on-disk cache
+-- The macro CACHE_DIR must be defined with the cache directory.
+test.cachefiles = [[
+#include <dirent.h>
+#include <string.h>
+
+/* Check if the file is a cached object */
+static int is_object(const char *name) {
+  size_t len = strlen(name);
+  return len > 2 && strcmp(name + len - 2, ".o") == 0;
+}
+
+/* Remove the objects of the cache */
+static void clear_cache(void) {
+  DIR *dir = opendir(CACHE_DIR);
+  struct dirent *entry;
+  char path[256];
+  if (!dir) return;
+  while ((entry = readdir(dir)) != NULL) {
+    if (is_object(entry->d_name)) {
+      sprintf(path, "%s/%s", CACHE_DIR, entry->d_name);
+      remove(path);
+    }
+  }
+  closedir(dir);
+}
+
+/* Count the cached objects
+ * Return by reference the path of an object that isn't the given one. */
+static int count_objects(char *name, const char *skip) {
+  DIR *dir = opendir(CACHE_DIR);
+  struct dirent *entry;
+  char path[256];
+  int n = 0;
+  if (!dir) return 0;
+  while ((entry = readdir(dir)) != NULL) {
+    if (is_object(entry->d_name)) {
+      sprintf(path, "%s/%s", CACHE_DIR, entry->d_name);
+      if (strcmp(path, skip) != 0)
+        strcpy(name, path);
+      n++;
+    }
+  }
+  closedir(dir);
+  return n;
+}
+]]
+
 -- Initialize the C source file
 -- Should be the first function called in a test generator
 function test.preamble(decls)
@@ -129,6 +196,10 @@ function test.preamble(decls)
 #include <stdplus/stdplus.h>
 #include <fahrenheit/fahrenheit.h>
 
+#ifndef TEST_BACKEND
+#define TEST_BACKEND FBackendLLVM
+#endif
+
 ]].. decls ..[[
 
 static int usedmem = 0;
@@ -174,9 +245,16 @@ local function setup_test(decls)
     int bb[100] = {0};
     FValue v[100] = {{0}};
     FBuilder b;
+#ifdef TEST_INTERP
+    FInterp interp;
+#endif
     ]].. decls ..[[
     f_init_module(&module);
     f_init_engine(&engine);
+    engine.backend = TEST_BACKEND;
+#ifdef TEST_INTERP
+    f_init_interp(&interp, &module);
+#endif
     (void)f;
     (void)bb;
     (void)v;
@@ -187,6 +265,9 @@ end
 -- End a test case (must be called after setup)
 local function teardown_test()
     print([[
+#ifdef TEST_INTERP
+    f_close_interp(&interp);
+#endif
     f_close_module(&module);
     f_close_engine(&engine);
     test(usedmem == 0);
@@ -271,13 +352,41 @@ local function print_format(type)
     })[type]
 end
 
+-- Run a function with the interpreter
+-- Receive the list of arguments, which are casted to the C types
+local function interp_function(f, ftype, arglist)
+    local args = {}
+    for i, arg in ipairs(arglist) do
+        if arg ~= '' then
+            args[i] = ('(%s)(%s)'):format(test.convert_type(ftype[i + 1]), arg)
+        end
+    end
+    local call = ('f_interp_call(%s)'):format(
+        table.concat({'&interp', tostring(f), table.unpack(args)}, ', '))
+    if ftype[1] == 'FPointer' then
+        print(('printf("%%d\\n", %s.p == &module);\n'):format(call))
+    elseif ftype[1] == 'FInt64' then
+        print(('printf("%%lu\\n", %s.i);\n'):format(call))
+    elseif test.is_float(ftype[1]) then
+        local field = ftype[1] == 'FFloat' and 'f' or 'd'
+        print(('printf("%%g\\n", %s.%s);\n'):format(call, field))
+    elseif ftype[1] ~= 'FVoid' then
+        print(('printf("%%u\\n", (unsigned)%s.i);\n'):format(call))
+    else
+        print(call .. ';\n')
+    end
+end
+
 -- Run a function
-local function run_function(f, ftype, args)
+local function run_function(f, ftype, args, arglist)
     local fret = test.convert_type(ftype[1])
     local fargs = map(test.convert_type, table.pack(table.unpack(ftype, 2)))
     local fargs_str = table.concat(fargs, ', ')
     if fargs_str == '' then fargs_str = 'void' end
     print('printf("running function @'.. f + 1 ..' with '.. args ..'\\n");\n')
+    print('#ifdef TEST_INTERP')
+    interp_function(f, ftype, arglist)
+    print('#else')
     if ftype[1] == 'FPointer' then
         print(('printf("%%d\\n", ' ..
                'f_get_fpointer(&engine, %d, %s, (%s))(%s) == &module);\n')
@@ -289,6 +398,7 @@ local function run_function(f, ftype, args)
         print(('f_get_fpointer(&engine, %d, %s, (%s))(%s);\n')
             :format(f, fret, fargs_str, args))
     end
+    print('#endif')
 end
 
 -- Create a test case
@@ -325,7 +435,7 @@ function test.case(t)
             if f.args then
                 local args = table.concat(f.args, ', ')
                 compile()
-                run_function(i - 1, f.type, args)
+                run_function(i - 1, f.type, args, f.args)
             end
         end
         if t.after then print(t.after) end
@@ -0,0 +1,104 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test compilations from several threads
+
+local test = require 'test'
+
+local decls = test.lockedmem .. [[
+
+#define NTHREADS 2
+#define NCOMPILES 10
+
+typedef struct Worker {
+  pthread_t thread;
+  ui32 k;
+  ui32 results[NCOMPILES];
+  int status;
+} Worker;
+
+/* Build, compile and run a module that computes x * k + 1 */
+static void *work(void *data) {
+  Worker *w = data;
+  int i;
+  for (i = 0; i < NCOMPILES; ++i) {
+    FModule m;
+    FEngine e;
+    FBuilder b;
+    FValue x;
+    int f;
+    f_init_module(&m);
+    f = f_add_function(&m, f_ftype(&m, FInt32, 1, FInt32));
+    b = f_builder(&m, f, f_add_bblock(&m, f));
+    x = f_binop(b, FMul, f_getarg(b, 0), f_consti(b, w->k, FInt32));
+    f_ret(b, f_binop(b, FAdd, x, f_consti(b, 1, FInt32)));
+    f_init_engine(&e);
+    e.backend = TEST_BACKEND;
+    w->status |= f_compile(&e, &m);
+    if (!w->status)
+      w->results[i] = f_get_fpointer(&e, f, ui32, (ui32))(10);
+    f_close_engine(&e);
+    f_close_module(&m);
+  }
+  return NULL;
+}
+]]
+
+test.preamble(decls)
+
+-- Each thread compiles and runs its own modules
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            f_ret(b, f_getarg(b, 0));
+        ]]
+    },
+    },
+    after = [[
+    {
+      Worker workers[NTHREADS];
+      int i, j;
+      mem_alloc = lockedmem;
+      for (i = 0; i < NTHREADS; ++i) {
+        workers[i].k = i + 2;
+        workers[i].status = 0;
+        test(pthread_create(&workers[i].thread, NULL, work, &workers[i]) == 0);
+      }
+      for (i = 0; i < NTHREADS; ++i)
+        test(pthread_join(workers[i].thread, NULL) == 0);
+      mem_alloc = checkmem;
+      test(threadmem == 0);
+      for (i = 0; i < NTHREADS; ++i) {
+        test(workers[i].status == 0);
+        printf("thread %d:", i);
+        for (j = 0; j < NCOMPILES; ++j)
+          printf(" %u", workers[i].results[j]);
+        printf("\n");
+      }
+    }
+]]
+}
+
+test.epilog()
@@ -0,0 +1,246 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the tiered engine
+
+local test = require 'test'
+
+test.preamble()
+
+-- Promote the functions after a few calls
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_call(b, f[0], 1, v[0]);
+            v[2] = f_binop(b, FMul, v[1], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FEngine tiered;
+      FTierOptions tier;
+      FTierStats stats;
+      FTierFunctionStats fstats;
+      int i;
+      f_init_engine(&tiered);
+      f_init_tier_options(&tier);
+      tier.call_threshold = 3;
+      tier.background = 0;
+      test(f_compile_tiered(&tiered, &module, NULL, &tier) == 0);
+      for (i = 0; i < 2; ++i)
+        printf("%u\n", f_get_fpointer(&tiered, f[1], ui32, (ui32))(i));
+      printf("%d\n", f_tier_update(&tiered));
+      printf("%u\n", f_get_fpointer(&tiered, f[1], ui32, (ui32))(2));
+      printf("%d\n", f_tier_update(&tiered));
+      f_get_tier_function_stats(&tiered, f[0], &fstats);
+      printf("%lu %lu %d\n", fstats.calls, fstats.loops, fstats.tier);
+      f_get_tier_function_stats(&tiered, f[1], &fstats);
+      printf("%lu %lu %d\n", fstats.calls, fstats.loops, fstats.tier);
+      printf("%u\n", f_get_fpointer(&tiered, f[1], ui32, (ui32))(3));
+      f_get_tier_stats(&tiered, &stats);
+      printf("%lu %lu %lu %lu\n", stats.checks, stats.compilations,
+          stats.promotions, stats.failures);
+      f_close_engine(&tiered);
+    }
+]]
+}
+
+-- Recompile an optimized caller when its callee is promoted, so the calls
+-- stop reaching the counters of the baseline callee
+test.case {
+    success = true,
+    functions = {
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 1, FInt32);
+            v[2] = f_binop(b, FAdd, v[0], v[1]);
+            f_ret(b, v[2]);
+        ]]
+    },
+    {
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[1]);
+            bb[2] = f_add_bblock(&module, f[1]);
+            v[0] = f_getarg(b, 0);
+            v[1] = f_intcmp(b, FIntSGt, v[0], f_consti(b, 10, FInt32));
+            f_jmpif(b, v[1], bb[1], bb[2]);
+
+            b = f_builder(&module, f[1], bb[1]);
+            v[2] = f_call(b, f[0], 1, v[0]);
+            f_ret(b, v[2]);
+
+            b = f_builder(&module, f[1], bb[2]);
+            f_ret(b, v[0]);
+        ]]
+    },
+    },
+    after = [[
+    {
+      FEngine tiered;
+      FTierOptions tier;
+      FTierStats stats;
+      FTierFunctionStats fstats;
+      int i;
+      f_init_engine(&tiered);
+      f_init_tier_options(&tier);
+      tier.call_threshold = 3;
+      tier.background = 0;
+      test(f_compile_tiered(&tiered, &module, NULL, &tier) == 0);
+      for (i = 0; i < 3; ++i)
+        f_get_fpointer(&tiered, f[1], ui32, (ui32))(i);
+      printf("%d\n", f_tier_update(&tiered));
+      for (i = 0; i < 3; ++i)
+        f_get_fpointer(&tiered, f[1], ui32, (ui32))(20 + i);
+      printf("%d\n", f_tier_update(&tiered));
+      for (i = 0; i < 3; ++i)
+        printf("%u\n", f_get_fpointer(&tiered, f[1], ui32, (ui32))(30 + i));
+      f_get_tier_function_stats(&tiered, f[0], &fstats);
+      printf("%lu %lu %d\n", fstats.calls, fstats.loops, fstats.tier);
+      f_get_tier_stats(&tiered, &stats);
+      printf("%lu %lu %lu %lu\n", stats.checks, stats.compilations,
+          stats.promotions, stats.failures);
+      f_close_engine(&tiered);
+    }
+]]
+}
+
+-- Promote a function with a hot loop
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+            bb[3] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_consti(b, 0, FInt32);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            v[2] = f_phi(b, FInt32);
+            v[3] = f_phi(b, FInt32);
+            v[4] = f_intcmp(b, FIntSLt, v[2], v[0]);
+            f_jmpif(b, v[4], bb[2], bb[3]);
+
+            b = f_builder(&module, f[0], bb[2]);
+            v[5] = f_binop(b, FAdd, v[3], v[2]);
+            v[6] = f_binop(b, FAdd, v[2], f_consti(b, 1, FInt32));
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[3]);
+            f_ret(b, v[3]);
+
+            f_add_incoming(b, v[2], bb[0], v[1]);
+            f_add_incoming(b, v[2], bb[2], v[6]);
+            f_add_incoming(b, v[3], bb[0], v[1]);
+            f_add_incoming(b, v[3], bb[2], v[5]);
+        ]]
+    }},
+    after = [[
+    {
+      FEngine tiered;
+      FTierOptions tier;
+      FTierFunctionStats fstats;
+      f_init_engine(&tiered);
+      f_init_tier_options(&tier);
+      tier.loop_threshold = 50;
+      tier.background = 0;
+      test(f_compile_tiered(&tiered, &module, NULL, &tier) == 0);
+      printf("%u\n", f_get_fpointer(&tiered, f[0], ui32, (ui32))(100));
+      printf("%d\n", f_tier_update(&tiered));
+      f_get_tier_function_stats(&tiered, f[0], &fstats);
+      printf("%lu %lu %d\n", fstats.calls, fstats.loops, fstats.tier);
+      printf("%u\n", f_get_fpointer(&tiered, f[0], ui32, (ui32))(100));
+      f_close_engine(&tiered);
+    }
+]]
+}
+
+-- Don't count forward jumps to blocks added before as loops
+test.case {
+    success = true,
+    functions = {{
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            bb[1] = f_add_bblock(&module, f[0]);
+            bb[2] = f_add_bblock(&module, f[0]);
+            bb[3] = f_add_bblock(&module, f[0]);
+
+            v[0] = f_getarg(b, 0);
+            v[1] = f_intcmp(b, FIntSLt, v[0], f_consti(b, 10, FInt32));
+            f_jmpif(b, v[1], bb[2], bb[3]);
+
+            b = f_builder(&module, f[0], bb[2]);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[3]);
+            f_jmp(b, bb[1]);
+
+            b = f_builder(&module, f[0], bb[1]);
+            v[2] = f_phi(b, FInt32);
+            f_add_incoming(b, v[2], bb[2], f_consti(b, 1, FInt32));
+            f_add_incoming(b, v[2], bb[3], f_consti(b, 2, FInt32));
+            f_ret(b, v[2]);
+        ]]
+    }},
+    after = [[
+    {
+      FEngine tiered;
+      FTierOptions tier;
+      FTierFunctionStats fstats;
+      int i;
+      f_init_engine(&tiered);
+      f_init_tier_options(&tier);
+      tier.loop_threshold = 3;
+      tier.background = 0;
+      test(f_compile_tiered(&tiered, &module, NULL, &tier) == 0);
+      for (i = 0; i < 5; ++i)
+        printf("%u\n", f_get_fpointer(&tiered, f[0], ui32, (ui32))(i * 5));
+      printf("%d\n", f_tier_update(&tiered));
+      f_get_tier_function_stats(&tiered, f[0], &fstats);
+      printf("%lu %lu %d\n", fstats.calls, fstats.loops, fstats.tier);
+      f_close_engine(&tiered);
+    }
+]]
+}
+
+test.epilog()
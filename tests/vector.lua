@@ -0,0 +1,261 @@
+-- MIT License
+-- 
+-- Copyright (c) 2017 Gabriel de Quadros Ligneul
+-- 
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+-- 
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+-- 
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+
+-- Test the vector instructions
+
+local test = require 'test'
+
+local decls = [[
+static i32 ints[] = {1, 2, 3, 4, 5, 6, 7, 8};
+static float floats[] = {1.5, -2, 3, -4};
+static i32 out[4];
+]]
+
+test.preamble(decls)
+
+-- Load and reduce
+test.case {
+    success = true,
+    functions = {{
+        args = {'ints'},
+        type = {'FInt32', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_reduce(b, FAdd, v[1]);
+            f_ret(b, v[2]);]]
+    }}
+}
+
+-- Splat, binop and extract
+test.case {
+    success = true,
+    functions = {{
+        args = {'5'},
+        type = {'FInt32', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_splat(b, v[0], 4);
+            v[2] = f_load(b, f_constp(b, ints), f_vec(FInt32, 4));
+            v[3] = f_binop(b, FMul, v[1], v[2]);
+            v[4] = f_extract(b, v[3], 2);
+            f_ret(b, v[4]);]]
+    }}
+}
+
+-- Shuffle and insert (the second load is unaligned)
+test.case {
+    success = true,
+    decls = 'int mask[] = {0, 4, 1, 5}, mask2[] = {7, 0};',
+    functions = {{
+        args = {'ints'},
+        type = {'FInt32', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_offset(b, v[0], f_consti(b, 12, FInt32), 0);
+            v[3] = f_load(b, v[2], f_vec(FInt32, 4));
+            v[4] = f_shuffle(b, v[1], v[3], 4, mask);
+            v[5] = f_insert(b, v[4], f_consti(b, 100, FInt32), 3);
+            v[6] = f_reduce(b, FAdd, v[5]);
+            f_ret(b, v[6]);]]
+    }, {
+        args = {'ints'},
+        type = {'FInt64', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_offset(b, v[0], f_consti(b, 16, FInt32), 0);
+            v[3] = f_load(b, v[2], f_vec(FInt32, 4));
+            v[4] = f_shuffle(b, v[1], v[3], 2, mask2);
+            v[5] = f_reduce(b, FMul, v[4]);
+            v[6] = f_cast(b, FUIntCast, v[5], FInt64);
+            f_ret(b, v[6]);]]
+    }}
+}
+
+-- Compare and select
+test.case {
+    success = true,
+    functions = {{
+        args = {'floats'},
+        type = {'FFloat', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FFloat, 4));
+            v[2] = f_splat(b, f_constf(b, 0, FFloat), 4);
+            v[3] = f_fpcmp(b, FFpOGt, v[1], v[2]);
+            v[4] = f_select(b, v[3], v[1], v[2]);
+            v[5] = f_reduce(b, FAdd, v[4]);
+            f_ret(b, v[5]);]]
+    }, {
+        args = {'ints'},
+        type = {'FInt8', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 8));
+            v[2] = f_splat(b, f_consti(b, 6, FInt32), 8);
+            v[3] = f_intcmp(b, FIntSLt, v[1], v[2]);
+            v[4] = f_splat(b, f_consti(b, 1, FInt8), 8);
+            v[5] = f_splat(b, f_consti(b, 0, FInt8), 8);
+            v[6] = f_select(b, v[3], v[4], v[5]);
+            v[7] = f_reduce(b, FAdd, v[6]);
+            f_ret(b, v[7]);]]
+    }}
+}
+
+-- Store
+test.case {
+    success = true,
+    functions = {{
+        args = {'out'},
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, f_constp(b, ints), f_vec(FInt32, 4));
+            v[2] = f_splat(b, f_consti(b, 1, FInt32), 4);
+            v[3] = f_binop(b, FShl, v[1], v[2]);
+            f_store(b, v[0], v[3]);
+            f_ret_void(b);]]
+    }},
+    after = [[
+    printf("%d %d %d %d\n", out[0], out[1], out[2], out[3]);
+]]
+}
+
+-- Code generated for the generic CPU
+test.case {
+    success = true,
+    functions = {{
+        args = {'ints'},
+        type = {'FInt32', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 8));
+            v[2] = f_reduce(b, FAdd, v[1]);
+            f_ret(b, v[2]);]]
+    }},
+    after = [[
+    {
+      FCompileOptions opts;
+      f_init_compile_options(&opts, 2);
+      opts.cpu = "";
+      opts.features = "";
+      test(f_compile_ex(&engine, &module, &opts) == 0);
+      printf("%d\n", f_get_fpointer(&engine, f[0], i32, (i32 *))(ints));
+    }
+]]
+}
+
+-- Binop between a vector and a scalar
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_binop(b, FAdd, v[1], f_consti(b, 1, FInt32));
+            f_ret_void(b);]]
+    }}
+}
+
+-- Invalid number of lanes
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FInt32'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_splat(b, v[0], 3);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Vector of pointers
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_splat(b, v[0], 2);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Extract an invalid lane
+test.case {
+    success = false,
+    functions = {{
+        type = {'FInt32', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_extract(b, v[1], 4);
+            f_ret(b, v[2]);]]
+    }}
+}
+
+-- Shuffle with an invalid lane
+test.case {
+    success = false,
+    decls = 'int mask[] = {0, 8};',
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_shuffle(b, v[1], v[1], 2, mask);
+            f_ret_void(b);]]
+    }}
+}
+
+-- Reduce with an invalid operation
+test.case {
+    success = false,
+    functions = {{
+        type = {'FFloat', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FFloat, 4));
+            v[2] = f_reduce(b, FAnd, v[1]);
+            f_ret(b, v[2]);]]
+    }}
+}
+
+-- Select with a condition of different lanes
+test.case {
+    success = false,
+    functions = {{
+        type = {'FVoid', 'FPointer'},
+        code = [[
+            v[0] = f_getarg(b, 0);
+            v[1] = f_load(b, v[0], f_vec(FInt32, 4));
+            v[2] = f_load(b, v[0], f_vec(FInt32, 8));
+            v[3] = f_intcmp(b, FIntEq, v[2], v[2]);
+            v[4] = f_select(b, v[3], v[1], v[1]);
+            f_ret_void(b);]]
+    }}
+}
+
+test.epilog()